@@ -60,7 +60,6 @@
 #include <errno.h>
 #include <histedit.h>
 #include <limits.h>
-#include <search.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <string.h>
@@ -90,6 +89,7 @@ int			sargc;
 char			**sargv;
 char			*filename;
 char			*cmdexpr;
+bool			in_process = false;
 
 static void		grow(void);
 static ssize_t		cs(const char *);
@@ -97,16 +97,30 @@ static ssize_t		as(const char *);
 static ssize_t		node(ssize_t, ...);
 static void		emit(ssize_t, int);
 static void		emit_macro(int, ssize_t);
+static void		output(const char *);
+static void		flush_output(void);
 static void		free_tree(void);
 static ssize_t		numnode(int);
+static ssize_t		new_macro(bool);
+static bool		in_parallel(void);
+static char		*par_name(const char *, const char *);
+static void		par_store(char *);
+static void		par_end(const char *, const char *);
+static struct symbol	*symtab_slot(struct symbol *, size_t, const char *);
+static void		symtab_grow(void);
 static ssize_t		lookup(char *, size_t, char);
 static ssize_t		letter_node(char *);
 static ssize_t		array_node(char *);
 static ssize_t		function_node(char *);
+static const char	*library_opcode(const char *);
+static bool		binary_node(ssize_t, const char *, ssize_t *,
+			    ssize_t *);
+static ssize_t		remainder_node(ssize_t, ssize_t);
 
 static void		add_par(ssize_t);
 static void		add_local(ssize_t);
 static void		warning(const char *);
+static void		print_error(const char *);
 static void		init(void);
 static void		usage(void);
 static char		*escape(const char *);
@@ -118,18 +132,58 @@ static int		macro_char = '0';
 static int		reset_macro_char = '0';
 static int		nesting = 0;
 static int		breakstack[16];
+static bool		breakpar[16];	/* the loop is a parallel for */
 static int		breaksp = 0;
+/* Variables written in the bodies of the parallel fors being compiled */
+static struct par_store {
+	char		*name;
+	int		level;		/* in breakstack, of the loop */
+}			*par_stores;
+static size_t		par_nstores;
 static ssize_t		prologue;
 static ssize_t		epilogue;
 static bool		st_has_continue;
 static char		str_table[UCHAR_MAX][2];
 static bool		do_fork = true;
+static char		*outbuf;
+static size_t		outbuf_len;
+static size_t		outbuf_sz;
 static u_short		var_count;
+/* Names of the variables, arrays and functions, and their registers */
+static struct symbol {
+	char		*name;
+	char		*reg;
+}			*symtab;
+static size_t		symtab_sz;
 static pid_t		dc;
+static bool		own_dc;
+static bool		native_lib = false;
+/* -b: each input item on stdin is a job run from the state before it */
+static bool		batch = false;
+static bool		batch_started;
+/* -j: threads for batch jobs, and dc's worker machines for parallel for */
+static long		threads = 0;
+/* -a: the largest array index, -1 for dc's default */
+static long		array_max = -1;
+static const char	*native_op;
+
+/* The functions of the math library dc has built in */
+static const struct {
+	const char	*name;
+	const char	*opcode;
+} library[] = {
+	{ "e",	"H" },
+	{ "l",	"T" },
+	{ "s",	"U" },
+	{ "c",	"V" },
+	{ "a",	"W" },
+	{ "j",	"Y" }
+};
 
 extern char *__progname;
 
 #define BREAKSTACK_SZ	(sizeof(breakstack)/sizeof(breakstack[0]))
+#define LIBRARY_SZ	(sizeof(library)/sizeof(library[0]))
 
 /* These values are 4.4BSD bc compatible */
 #define FUNC_CHAR	0x01
@@ -139,6 +193,7 @@ extern char *__progname;
 #define ENCODE(c)	((c) < '[' ? (c) : (c) + 3);
 #define VAR_BASE	(256-4)
 #define MAX_VARIABLES	(VAR_BASE * VAR_BASE)
+#define SYMTAB_MIN	64	/* grown by doubling when half full */
 
 #ifdef YYSTYPE
 #undef  YYSTYPE_IS_DECLARED
@@ -146,7 +201,7 @@ extern char *__progname;
 #endif
 #ifndef YYSTYPE_IS_DECLARED
 #define YYSTYPE_IS_DECLARED 1
-#line 125 "bc.y"
+#line 180 "bc.y"
 typedef union YYSTYPE {
 	ssize_t		node;
 	struct lvalue	lvalue;
@@ -154,7 +209,7 @@ typedef union YYSTYPE {
 	char		*astr;
 } YYSTYPE;
 #endif /* !YYSTYPE_IS_DECLARED */
-#line 158 "bc.c"
+#line 213 "bc.c"
 
 /* compatibility with bison */
 #ifdef YYPARSE_PARAM
@@ -242,125 +297,139 @@ extern int YYPARSE_DECL();
 #define YYERRCODE 256
 typedef int YYINT;
 static const YYINT yylhs[] = {                           -1,
-    0,    0,    7,    7,    7,    7,   16,   16,   16,   16,
-   18,   18,   18,   18,   18,   18,   11,   11,   17,   17,
-   17,   17,   17,   17,   17,   17,   17,   17,   17,   17,
-   17,    3,   19,    5,    6,   21,   21,   20,   20,   23,
-   23,   23,   23,   22,   22,   22,   24,   24,   24,   24,
-    8,    8,    2,    2,    2,   10,   10,   14,   14,   14,
-   14,   14,   14,   14,   15,   15,   15,    9,    9,    4,
-    4,    4,    4,    4,    4,    4,    4,    4,    4,    4,
-    4,    4,    4,    4,    4,    4,    4,    4,    4,    4,
-    4,    4,    4,    4,    4,    4,    4,    4,    1,    1,
-    1,    1,    1,   13,   13,   12,   12,
+    0,    0,    8,    8,    8,    8,   20,   20,   20,   20,
+   22,   22,   22,   22,   22,   22,   12,   12,   21,   21,
+   21,   21,   21,   21,   21,   21,   21,   21,   21,   21,
+   21,   21,    3,    4,   13,   13,   13,   14,   14,   15,
+   15,   23,    6,    7,   25,   25,   24,   24,   27,   27,
+   27,   27,   26,   26,   26,   28,   28,   28,   28,    9,
+    9,    2,    2,    2,   11,   11,   18,   18,   18,   18,
+   18,   18,   18,   19,   19,   19,   10,   10,    5,    5,
+    5,    5,    5,    5,    5,    5,    5,    5,    5,    5,
+    5,    5,    5,    5,    5,    5,    5,    5,    5,    5,
+    5,    5,    5,    5,    5,    5,    5,    1,    1,    1,
+    1,    1,   17,   17,   16,   16,
 };
 static const YYINT yylen[] = {                            2,
     0,    2,    2,    1,    2,    2,    0,    1,    3,    2,
     0,    1,    2,    3,    2,    3,    0,    1,    1,    3,
-    1,    1,    1,    1,    2,   11,    7,   11,    7,    3,
-    2,    0,    0,    9,    3,    0,    1,    0,    1,    1,
-    3,    3,    5,    0,    3,    3,    1,    3,    3,    5,
-    0,    1,    1,    3,    5,    0,    1,    3,    3,    3,
-    3,    3,    3,    1,    0,    1,    2,    0,    1,    1,
-    1,    1,    3,    4,    2,    3,    3,    3,    3,    3,
-    3,    2,    2,    2,    2,    3,    4,    4,    4,    2,
-    5,    5,    3,    3,    3,    3,    3,    3,    1,    4,
-    1,    1,    1,    1,    3,    1,    1,
+    1,    1,    1,    1,    2,   11,   20,    7,   11,    7,
+    3,    2,    0,    0,    1,    1,    1,    1,    1,    2,
+    2,    0,    9,    3,    0,    1,    0,    1,    1,    3,
+    3,    5,    0,    3,    3,    1,    3,    3,    5,    0,
+    1,    1,    3,    5,    0,    1,    3,    3,    3,    3,
+    3,    3,    1,    0,    1,    2,    0,    1,    1,    1,
+    1,    3,    4,    2,    3,    3,    3,    3,    3,    3,
+    2,    2,    2,    2,    3,    4,    4,    4,    2,    5,
+    5,    3,    3,    3,    3,    3,    3,    1,    4,    1,
+    1,    1,    1,    3,    1,    1,
 };
 static const YYINT yydefred[] = {                         1,
-    0,    0,    0,    0,   71,    0,   72,   21,    0,   22,
-   24,    0,    0,    0,    0,    0,    0,    0,  102,  103,
+    0,    0,    0,    0,   80,    0,   81,   21,    0,   22,
+   24,    0,    0,    0,    0,    0,    0,    0,  111,  112,
    23,    0,    0,    0,    0,    0,    0,    0,    4,    0,
-    2,    0,    8,    5,    6,    0,    0,   12,    0,    0,
-    0,    0,    0,    0,    0,   25,   32,   32,   32,    0,
-    0,  107,    0,  104,    0,    0,   75,    0,  101,   82,
-   83,    0,   84,   85,   32,   32,    0,    0,    0,    0,
+    2,    0,    8,    5,    6,    0,    0,    0,   12,    0,
+    0,    0,    0,    0,    0,    0,   25,   33,   33,   33,
+    0,    0,  116,    0,  113,    0,    0,   84,    0,  110,
+   91,   92,    0,   93,   94,   33,   33,    0,    0,    0,
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+    0,    0,    0,    3,    0,    0,   82,    0,   31,    0,
+    0,   35,   36,    0,    0,    0,    0,    0,   44,    0,
+   76,    0,   42,    0,    0,    0,    0,    0,   42,   42,
     0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-    0,    0,    3,    0,   73,    0,   30,    0,    0,    0,
-    0,    0,   35,    0,   67,    0,   33,    0,    0,    0,
-    0,    0,   33,   33,    0,    0,    0,    0,    0,    0,
-    0,    0,    0,    0,    0,    0,    0,    0,    0,    9,
-    0,   16,   14,    0,   74,  100,   87,    0,    0,    0,
-    0,    0,   88,   89,  105,    0,    0,   41,   37,    0,
+    0,    0,    0,    0,    0,    9,    0,   16,   14,    0,
+   83,    0,  109,   96,    0,    0,    0,    0,    0,   97,
+   98,  114,    0,    0,   50,   46,    0,    0,    0,    0,
     0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-    0,    0,    0,    0,    0,    0,    0,    0,   57,    0,
-    0,    0,    0,    0,    0,    0,   33,   18,    0,   43,
-   55,    0,    0,   29,    0,    0,    0,   32,    0,    0,
-    0,    0,   33,    0,    0,   46,   45,   34,   33,    0,
-   48,    0,   26,   28,    0,   50,
+    0,    0,    0,    0,    0,    0,    0,   66,    0,    0,
+    0,    0,    0,    0,    0,   42,   18,    0,   52,   64,
+   34,    0,    0,   30,    0,    0,    0,    0,   33,    0,
+    0,    0,    0,    0,   42,    0,    0,   55,   54,   43,
+    0,   42,    0,   57,    0,    0,   26,   29,    0,    0,
+   59,    0,   39,   38,    0,    0,    0,    0,    0,    0,
+   40,   41,    0,   42,   27,
 };
 #if defined(YYDESTRUCT_CALL) || defined(YYSTYPE_TOSTRING)
 static const YYINT yystos[] = {                           0,
   306,  256,  259,  261,  265,  267,  268,  269,  270,  271,
   272,  273,  274,  275,  276,  277,  278,  279,  280,  281,
-  283,  285,  288,  297,  303,  304,  307,  310,  311,  312,
-  313,  322,  323,  266,  272,  307,  310,  323,  324,  259,
-  263,  267,  259,  259,  310,  321,  259,  259,  259,  259,
-  259,  269,  310,  318,  319,  310,  310,  267,  279,  307,
-  307,  295,  303,  304,  286,  287,  289,  290,  291,  292,
-  293,  294,  296,  297,  298,  299,  300,  301,  267,  326,
-  329,  258,  266,  295,  260,  258,  262,  266,  308,  310,
-  314,  310,  259,  310,  260,  309,  309,  309,  310,  310,
-  257,  310,  309,  309,  310,  310,  310,  310,  310,  310,
-  310,  310,  310,  310,  310,  310,  263,  260,  257,  323,
-  310,  323,  323,  257,  260,  264,  260,  310,  315,  325,
-  310,  320,  260,  260,  318,  325,  325,  264,  266,  327,
-  267,  267,  310,  258,  320,  289,  290,  291,  292,  293,
-  294,  260,  310,  310,  261,  263,  263,  316,  320,  260,
-  310,  310,  310,  310,  310,  310,  317,  323,  266,  264,
-  264,  258,  317,  325,  282,  328,  315,  284,  267,  330,
-  324,  260,  309,  263,  257,  258,  266,  262,  317,  325,
-  264,  267,  325,  317,  263,  264,
+  283,  285,  288,  297,  303,  304,  307,  311,  312,  313,
+  314,  326,  327,  266,  272,  267,  307,  311,  327,  328,
+  259,  263,  267,  259,  259,  311,  325,  259,  259,  259,
+  259,  259,  269,  311,  322,  323,  311,  311,  267,  279,
+  307,  307,  295,  303,  304,  286,  287,  289,  290,  291,
+  292,  293,  294,  296,  297,  298,  299,  300,  301,  267,
+  330,  333,  258,  266,  259,  295,  260,  258,  262,  266,
+  267,  296,  298,  308,  311,  315,  319,  311,  259,  311,
+  260,  309,  309,  309,  311,  311,  257,  311,  309,  309,
+  311,  311,  311,  311,  311,  311,  311,  311,  311,  311,
+  311,  311,  263,  260,  257,  327,  311,  327,  327,  257,
+  260,  267,  264,  260,  311,  316,  329,  311,  324,  260,
+  260,  322,  329,  329,  264,  266,  331,  267,  267,  311,
+  260,  258,  324,  289,  290,  291,  292,  293,  294,  260,
+  311,  311,  261,  263,  263,  275,  317,  324,  260,  311,
+  311,  311,  311,  311,  311,  318,  327,  266,  264,  264,
+  259,  258,  318,  329,  282,  332,  310,  316,  284,  267,
+  334,  328,  267,  260,  309,  263,  257,  258,  266,  262,
+  295,  318,  329,  264,  267,  311,  329,  318,  263,  258,
+  264,  267,  290,  293,  320,  311,  258,  267,  303,  321,
+  303,  267,  260,  318,  329,
 };
 #endif /* YYDESTRUCT_CALL || YYSTYPE_TOSTRING */
 static const YYINT yydgoto[] = {                          1,
-   36,   89,   96,   28,   29,   30,   31,   91,  129,  158,
-  167,   54,   55,  132,   46,   32,  168,   39,  130,   80,
-  140,  176,   81,  180,
+   37,   94,  102,  187,   28,   29,   30,   31,   96,  136,
+  167,  176,   97,  215,  220,   55,   56,  139,   47,   32,
+  177,   40,  137,   81,  147,  186,   82,  191,
 };
 static const YYINT yysindex[] = {                         0,
-  -77, -188,  196,   88,    0, -257,    0,    0, -260,    0,
-    0, -236,  223, -225, -109, -107, -103, -102,    0,    0,
-    0,  115,  196,  196, -227, -227, -291,  -17,    0, -237,
-    0, -202,    0,    0,    0, -166,  479,    0,  -89,  196,
-  196,  -87,  196,  142,  -17,    0,    0,    0,    0,  196,
-  196,    0,  -17,    0, -195,  815,    0, -170,    0,    0,
-    0,  196,    0,    0,    0,    0,  196,  196,  196,  196,
-  196,  196,  196,  196,  196,  196,  196,  196,  -85, -157,
-  -81,   88,    0,  196,    0,   88,    0,   88,  -72,  -17,
-  -73,  607,    0,  496,    0,  196,    0,  196,  514,  531,
-  115,  291,    0,    0,  291,  291,  291,  291,  291,  291,
-  126,  126,  -71,  -71,  -71,  -71,  -33,  -37,  -32,    0,
-  291,    0,    0,  250,    0,    0,    0,  -17,  -21,  196,
-  787,  -20,    0,    0,    0,  196,  196,    0,    0,   -7,
-   -6, -216,  -17,  196,    6,  196,  196,  196,  196,  196,
-  196,   88,  802,  815,   -4,    7,  169,   20,    0,   88,
-  291,  291,  291,  291,  291,  291,    0,    0,   21,    0,
-    0,  196,    5,    0,   41,   88,   51,    0,   49, -207,
-  -45,   88,    0,   54,   65,    0,    0,    0,    0,   88,
-    0,   74,    0,    0,   76,    0,
+  -44, -260,  303,  195,    0, -147,    0,    0, -251,    0,
+    0, -218,  330, -212, -211, -200, -195, -194,    0,    0,
+    0,  222,  303,  303, -235, -235, -290,  900,    0, -237,
+    0, -152,    0,    0,    0, -146, -131,  623,    0,  -80,
+ -158,  303, -179,  303,  249,  900,    0,    0,    0,    0,
+  303,  303,    0,  900,    0, -204,  949,    0, -182,    0,
+    0,    0,  303,    0,    0,    0,    0,  303,  303,  303,
+  303,  303,  303,  303,  303,  303,  303,  303,  303, -120,
+ -123, -110,  195,    0,  303,  303,    0,  195,    0,  195,
+ -146,    0,    0,  -92,  900,  -84,  -76,  751,    0,  640,
+    0,  303,    0,  303,  658,  675,  222,  398,    0,    0,
+  398,  398,  398,  398,  398,  398,   61,   61, -106, -106,
+ -106, -106,  -64,  -61,  -49,    0,  398,    0,    0,  357,
+    0,  -41,    0,    0,  900,  -38,  303,  921,  -14,    0,
+    0,    0,  303,  303,    0,    0,   -4,    1, -132,  900,
+   12,  303,   13,  303,  303,  303,  303,  303,  303,  195,
+  936,  949,   37,   42,  276,   56,   55,    0,  195,  398,
+  398,  398,  398,  398,  398,    0,    0,   57,    0,    0,
+    0,  303,   32,    0,   75,  195,   89,  103,    0,  117,
+ -163,  -10,   71,  195,    0,  121,  122,    0,    0,    0,
+  303,    0,  195,    0,  132,  588,    0,    0,  124,  142,
+    0, -164,    0,    0,  303,  605, -265,  111,  150,  158,
+    0,    0,  195,    0,    0,
 };
 static const YYINT yyrindex[] = {                         0,
- -175,    0,    0,  -43,    0,  -48,    0,    0,    0,    0,
-    0,    0,    2,    0,    0,    0,    0,    1,    0,    0,
-    0,    0,    0,    0,    0,    0,  461,  221,    0,   81,
-    0,    0,    0,    0,    0,  275,    0,    0,    0,   82,
-    0,    0,    0,    0,  384,    0,    0,    0,    0,    0,
-    0,    0,  286,    0,  445, -229,    0,  320,    0,    0,
+ -122,    0,    0,   36,    0,  149,    0,    0,    0,    0,
+    0,    0, -100,    0,    0,    0,    0,  -15,    0,    0,
+    0,    0,    0,    0,    0,    0,  568,   34,    0,  159,
+    0,    0,    0,    0,    0,   33,  382,    0,    0,    0,
+  161,    0,    0,    0,    0,  193,    0,    0,    0,    0,
+    0,    0,    0, -206,    0,  328, -229,    0,  427,    0,
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+    0,    0,    0,    0,    0,    0,    0,    0,    0, -109,
+    0,  163,   -8,    0,  161,    0,    0,   43,    0,   46,
+   54,    0,    0,  164,  -90,    0,    0,    0,    0,    0,
+    0,  167,    0,    0,    0,    0,    0,  795,    0,    0,
+  301,  806,  837,  847,  878,  888,  720,  734,  446,  490,
+  507,  551,    0,  165,    0,    0,  -83,    0,    0,    0,
+    0,    0,    0,    0, -243,    0,    0, -161,    0,    0,
+    0,    0,    0,    0,    0,    0,    0,    8,   78,   50,
+    0,  169,    0,    0,    0,    0,    0,    0,    0,  393,
+  -70,  919,    0,    0,    0,    0,    0,    0,  393, -224,
+ -168, -162, -126,  -89,  -20,    0,    0,  125,    0,    0,
+    0,  170,  154,    0,    0,   36,    0,    0,    0,   -3,
+    0,    0,    0,  393,    0,    0,    0,    0,    0,    0,
+    0,    0,  393,    0,    4,    0,    0,    0,    0,    0,
     0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-    0,    0,    0,    0,    0,    0,    0,    0, -152,    0,
-   84, -133,    0,    0,    0,  -34,    0,   72,   86,  -86,
-    0,    0,    0,    0,    0,   90,    0,    0,    0,    0,
-    0, -126,    0,    0,  194,  663,  694,  704,  735,  745,
-  576,  590,  339,  383,  400,  444,    0,   89,    0,    0,
-  652,    0,    0,    0,    0,    0,    0, -197,    0,    0,
- -117,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-  -74, -180,  -35,   96,    0,    0,    0,    0,    0,    0,
-    0,  577,  786,  776,    0,    0,    0,    0,    0,  577,
- -241, -160, -156,  -53,  112,  119,    0,    0,   48,    0,
-    0,   98,   77,    0,    0,  -43,    0,    0, -169,    0,
-    0,  577,    0,    0,    0,    0,    0,    0,    0,  577,
-    0, -104,    0,    0,    0,    0,
+    0,    0,  393,    0,    0,
 };
 #if YYBTYACC
 static const YYINT yycindex[] = {                         0,
@@ -383,242 +452,271 @@ static const YYINT yycindex[] = {                         0,
     0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
     0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
     0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-    0,    0,    0,    0,    0,    0,
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+    0,    0,    0,    0,    0,
 };
 #endif
 static const YYINT yygindex[] = {                         0,
-   -1,    0,  -39,   -2,    0,    0,    0,    0,  203,    0,
- -146,  277,    0, -112,    0,    0,    4,  205,  -88,    0,
-    0,    0,    0,    0,
+   -1,    0,  -40,    0,   -2,    0,    0,    0,    0,  250,
+    0, -115,    0,    0,    0,  324,    0, -129,    0,    0,
+    3,  248,  -91,    0,    0,    0,    0,    0,
 };
-#define YYTABLESIZE 1116
+#define YYTABLESIZE 1250
 static const YYINT yytable[] = {                         27,
-   37,   40,   27,   62,   33,   41,   42,   38,   97,   98,
-   45,   63,   64,  173,  136,  137,   58,  145,   58,   53,
-   56,   57,   43,   60,   61,  103,  104,   90,   90,   79,
-   90,  159,   90,   47,   90,  189,   90,   90,   92,   58,
-   94,   37,   40,  194,   93,   93,  157,   99,  100,  185,
-  186,   59,   19,   20,   90,   82,   90,   90,  187,  102,
-   69,  101,   69,   83,  105,  106,  107,  108,  109,  110,
-  111,  112,  113,  114,  115,  116,   99,   34,  174,   99,
-   27,  121,    7,   35,   27,  120,   27,   47,   47,  122,
-    7,  123,   41,  128,  190,  131,   47,   61,   53,   61,
-  193,   63,  118,   63,   40,   99,   99,   40,   99,   99,
-   99,   99,   99,   99,   99,   99,   99,   99,   99,   99,
-   99,  143,   99,   99,   10,   96,   96,  131,   84,   98,
-   98,   20,   10,  153,  154,   20,   63,   64,  183,   20,
-   64,  131,   64,  161,  162,  163,  164,  165,  166,   48,
-   27,   49,   49,   49,   92,   50,   51,   20,   27,   86,
-   86,   49,   86,   86,   86,   86,   86,   86,   86,  128,
-   53,   93,   87,   53,   27,  119,   88,  117,    2,   38,
-   27,    3,   42,    4,  124,   42,  125,    5,   27,    6,
-    7,    8,    9,   10,   11,   12,   13,   14,   15,   16,
-   17,   18,   19,   20,   59,   21,   59,   22,   99,   99,
-   23,   99,   86,   99,   11,   99,  188,   99,   11,   24,
-   88,   54,   11,   15,   54,   25,   26,   15,  139,   78,
-  138,   15,   94,   94,  141,   99,  144,   99,   99,  152,
-   99,   99,   99,   99,   99,   99,   99,   99,   99,   99,
-   99,   99,   99,  155,   99,   99,  156,  101,  101,   65,
-  101,  169,  101,   65,  101,  160,  101,   65,   65,   66,
-  170,   67,   68,   69,   70,   71,   72,  172,   73,   74,
-   75,   76,   77,   78,  101,   65,  101,  101,  178,  101,
-  101,  101,  101,  101,  101,  101,  101,  101,  101,  101,
-  101,  101,  175,  101,  101,   44,   44,  179,   44,   44,
-  182,  184,   44,   44,   44,   44,   44,  191,   44,   44,
-   44,   44,   44,   44,   44,   44,   44,   44,   44,   13,
-   44,  192,   44,   13,   27,   44,  195,   13,   27,  196,
-   38,   51,   27,   39,   44,   52,    3,   68,    4,   36,
-   44,   44,    5,   56,    6,    7,    8,   68,   10,   11,
-   12,   13,   14,   15,   16,   17,   18,   19,   20,   60,
-   21,   60,   22,    3,  177,   23,   62,  135,   62,    5,
-  181,    6,    7,   52,   24,    0,    0,   12,    0,    0,
-   25,   26,   17,   18,   19,   20,    0,   95,   95,    0,
-    3,   95,   23,    0,   97,   97,    5,    0,    6,    7,
-    0,   24,    0,    0,   12,    0,    0,   25,   26,   17,
-   18,   19,   20,   75,   76,   77,   78,    3,    0,   23,
-    0,    0,  171,    5,    0,    6,    7,    0,   24,    0,
+   38,  218,   27,   33,   63,   34,   39,  153,  103,  104,
+   46,   35,   64,   65,   78,   43,   78,  143,  144,   54,
+   57,   58,  168,   61,   62,  109,  110,   99,   99,   80,
+   99,   59,   99,   67,   99,   67,   99,  219,   95,   98,
+   44,  100,   38,   60,   19,   20,   48,   49,  105,  106,
+  115,  115,  107,  183,   99,  115,   99,   99,   50,  115,
+  108,  102,  102,   51,   52,  111,  112,  113,  114,  115,
+  116,  117,  118,  119,  120,  121,  122,  115,  202,   99,
+   42,   27,   95,  127,  184,  126,   27,  208,   27,   70,
+  128,   70,  129,  197,  198,   72,   73,   72,   73,  135,
+    3,  138,  199,  203,   54,   83,    5,  224,   91,    7,
+  207,   41,   85,   84,   12,   42,   42,  105,  105,   17,
+   18,   19,   20,  107,  107,  213,   85,  150,  214,   23,
+  165,   68,  225,   68,  138,    7,  124,   92,   24,   93,
+  161,  162,  123,    7,   25,   26,  125,   49,  195,  138,
+   49,  170,  171,  172,  173,  174,  175,   74,   27,  103,
+  103,   74,   98,   86,  130,   74,   62,   27,   69,   62,
+   69,   64,   65,   95,   95,  131,   95,   88,   95,  135,
+   95,   89,   95,   74,   27,   90,  101,  101,   39,  101,
+  132,  101,   27,  101,   79,  101,  104,  104,  206,  145,
+   95,   27,   95,   95,  146,   95,   95,   95,   95,   95,
+   95,    2,  216,  101,    3,  101,    4,  148,  151,  152,
+    5,   27,    6,    7,    8,    9,   10,   11,   12,   13,
+   14,   15,   16,   17,   18,   19,   20,   71,   21,   71,
+   22,  110,  110,   23,  110,  160,  110,   88,  110,   10,
+  110,  200,   24,   56,   56,   90,  163,   10,   25,   26,
+   58,   58,   56,  164,   51,  106,  106,   51,  110,   58,
+  110,  110,  169,  110,  110,  110,  110,  110,  110,  110,
+  110,  110,  110,  110,  110,  110,  166,  110,  110,  108,
+  108,   19,  108,   11,  108,   19,  108,   11,  108,   19,
+   15,   11,  178,   13,   15,  179,   63,   13,   15,   63,
+  108,   13,  182,  108,  181,  189,  108,   19,  108,  108,
+   37,  108,  108,  108,  108,  108,  108,  108,  108,  108,
+  108,  108,  108,  108,  108,  108,  108,  108,  185,  108,
+  108,  190,  108,  108,  108,  108,  108,  108,  108,  108,
+  108,  108,  108,  108,  108,  193,  108,  108,   76,   77,
+   78,   79,  194,  108,  108,  201,  108,  108,  108,  108,
+  108,  108,  108,  108,  108,  108,  108,  108,  108,  196,
+  108,  108,   53,   53,  204,   53,   53,  211,  205,   53,
+   53,   53,   53,   53,  209,   53,   53,   53,   53,   53,
+   53,   53,   53,   53,   53,   53,  108,   53,  212,   53,
+  108,   28,   53,  221,  108,   28,  222,  223,   47,   28,
+   60,   53,   48,   61,   77,   45,   65,   53,   53,   77,
+  142,  188,  108,  192,  108,  108,    0,  108,  108,  108,
+  108,  108,  108,  108,  108,  108,  108,  108,  108,  108,
+   75,  108,  108,    3,   75,    4,    0,    0,   75,    5,
+    0,    6,    7,    8,    0,   10,   11,   12,   13,   14,
+   15,   16,   17,   18,   19,   20,   75,   21,    0,   22,
+    3,    0,   23,    0,    0,    0,    5,    0,   36,    7,
+   53,   24,    0,    0,   12,    0,    0,   25,   26,   17,
+   18,   19,   20,    0,    0,    0,    0,    3,  101,   23,
+    0,    0,    0,    5,    0,   36,    7,    0,   24,    0,
     0,   12,    0,    0,   25,   26,   17,   18,   19,   20,
-   93,   93,    0,   93,    3,   93,   23,   93,    0,   93,
-    5,    0,    6,    7,    0,   24,    0,    0,   12,    0,
-    0,   25,   26,   17,   18,   19,   20,   93,   19,   93,
-   93,   44,   19,   23,    0,    0,   19,    5,    0,    6,
+    0,    0,    0,    0,    3,    0,   23,    0,    0,  180,
+    5,    0,   36,    7,    0,   24,    0,    0,   12,    0,
+    0,   25,   26,   17,   18,   19,   20,  102,  102,    0,
+  102,    3,  102,   23,  102,    0,  102,    5,    0,   36,
     7,    0,   24,    0,    0,   12,    0,    0,   25,   26,
-   17,   18,   19,   20,   19,    0,    0,    0,    3,    0,
-   23,    0,    0,    0,    5,    0,  142,    7,    0,   24,
+   17,   18,   19,   20,  102,   32,  102,  102,   45,   32,
+   23,    0,    0,   32,    5,    0,   36,    7,    0,   24,
     0,    0,   12,    0,    0,   25,   26,   17,   18,   19,
-   20,   70,   70,    0,   70,    0,   70,   23,   70,    0,
-   70,    0,  106,  106,    0,    0,   24,  106,    0,    0,
-    0,  106,   25,   26,    0,    0,    0,    0,   70,    0,
-   70,   70,    0,   70,   70,   70,   70,   70,   70,  106,
-   70,   70,   70,   70,   70,   70,   99,   99,    0,   99,
-    0,   99,    0,   99,    0,   99,   73,   74,   75,   76,
-   77,   78,    0,    0,    0,   78,   78,    0,   78,    0,
-   78,    0,   78,   99,   78,   99,   99,    0,   99,   99,
-   99,   99,   99,   99,    0,   99,   99,   99,   99,   99,
-   99,    0,   78,    0,   78,   78,    0,   78,   78,   78,
-   78,   78,   78,    0,   78,   78,   78,   78,   78,   79,
-   79,   66,   79,    0,   79,   66,   79,    0,   79,   66,
-    0,    0,    0,    0,    0,    0,   80,   80,    0,   80,
-    0,   80,    0,   80,    0,   80,   79,   66,   79,   79,
-    0,   79,   79,   79,   79,   79,   79,    0,   79,   79,
-   79,   79,   79,   80,    0,   80,   80,    0,   80,   80,
-   80,   80,   80,   80,    0,   80,   80,   80,   80,   80,
-   81,   81,   31,   81,    0,   81,   31,   81,    0,   81,
-   31,    0,    0,    0,    0,    0,    0,    0,   70,    0,
-    0,    0,   70,    0,    0,    0,   70,   81,   31,   81,
-   81,    0,   81,   81,   81,   81,   81,   81,   85,   81,
-   81,   81,   81,   81,   70,    0,   70,   70,    0,   70,
-   70,   70,   70,   70,   70,  127,   70,   70,   70,   70,
-   70,   70,    0,    0,   65,   66,    0,   67,   68,   69,
-   70,   71,   72,  133,   73,   74,   75,   76,   77,   78,
-    0,   65,   66,    0,   67,   68,   69,   70,   71,   72,
-  134,   73,   74,   75,   76,   77,   78,    0,    0,   65,
-   66,    0,   67,   68,   69,   70,   71,   72,    0,   73,
-   74,   75,   76,   77,   78,    0,   65,   66,    0,   67,
-   68,   69,   70,   71,   72,    0,   73,   74,   75,   76,
-   77,   78,   76,   76,   17,   76,    0,   76,   17,   76,
-    0,   76,   17,    0,    0,    0,   77,   77,    0,   77,
-    0,   77,    0,   77,    0,   77,    0,    0,    0,   76,
-   17,   76,   76,    0,   76,   76,   76,   76,   76,   76,
-  126,   76,   76,   77,    0,   77,   77,    0,   77,   77,
-   77,   77,   77,   77,    0,   77,   77,    0,    0,    0,
-    0,    0,   65,   66,    0,   67,   68,   69,   70,   71,
-   72,    0,   73,   74,   75,   76,   77,   78,   86,   86,
-    0,   86,    0,   86,    0,   86,    0,   86,    0,   96,
-   96,    0,   96,    0,   96,    0,   96,    0,   96,    0,
-    0,    0,    0,    0,    0,   86,    0,   86,   86,    0,
-   86,   86,   86,   86,   86,   86,   96,    0,   96,   96,
-   98,   98,    0,   98,    0,   98,    0,   98,    0,   98,
-   94,   94,    0,   94,    0,   94,    0,   94,    0,   94,
-    0,    0,    0,    0,    0,    0,    0,   98,    0,   98,
-   98,    0,    0,    0,    0,    0,    0,   94,    0,   94,
-   94,   95,   95,    0,   95,    0,   95,    0,   95,    0,
-   95,   97,   97,    0,   97,    0,   97,    0,   97,    0,
-   97,    0,    0,    0,    0,    0,    0,    0,   95,    0,
-   95,   95,    0,    0,    0,    0,    0,    0,   97,    0,
-   97,   97,   91,   91,    0,   91,    0,   91,    0,   91,
-    0,   91,   92,   92,    0,   92,    0,   92,    0,   92,
-    0,   92,    0,    0,    0,    0,    0,    0,    0,   91,
-    0,   91,   91,    0,    0,    0,    0,    0,    0,   92,
-    0,   92,   65,   66,    0,  146,  147,  148,  149,  150,
-  151,    0,   73,   74,   75,   76,   77,   78,   66,    0,
-   67,   68,   69,   70,   71,   72,    0,   73,   74,   75,
-   76,   77,   78,   67,   68,   69,   70,   71,   72,    0,
-   73,   74,   75,   76,   77,   78,
+   20,   32,    0,    0,    0,    3,    0,   23,    0,    0,
+    0,    5,    0,  149,    7,    0,   24,    0,    0,   12,
+    0,    0,   25,   26,   17,   18,   19,   20,   79,   79,
+    0,   79,    0,   79,   23,   79,    0,   79,    0,    0,
+   17,    0,    0,   24,   17,    0,    0,    0,   17,   25,
+   26,    0,    0,    0,    0,   79,    0,   79,   79,    0,
+   79,   79,   79,   79,   79,   79,   17,   79,   79,   79,
+   79,   79,   79,  108,  108,    0,  108,    0,  108,    0,
+  108,    0,  108,   74,   75,   76,   77,   78,   79,    0,
+    0,    0,   87,   87,    0,   87,    0,   87,    0,   87,
+  108,   87,  108,  108,    0,  108,  108,  108,  108,  108,
+  108,    0,  108,  108,  108,  108,  108,  108,    0,   87,
+    0,   87,   87,    0,   87,   87,   87,   87,   87,   87,
+    0,   87,   87,   87,   87,   87,   88,   88,    0,   88,
+    0,   88,    0,   88,    0,   88,    0,    0,    0,    0,
+    0,    0,    0,   89,   89,    0,   89,    0,   89,    0,
+   89,    0,   89,   88,    0,   88,   88,    0,   88,   88,
+   88,   88,   88,   88,    0,   88,   88,   88,   88,   88,
+   89,    0,   89,   89,    0,   89,   89,   89,   89,   89,
+   89,    0,   89,   89,   89,   89,   89,   90,   90,    0,
+   90,    0,   90,    0,   90,    0,   90,    0,    0,    0,
+    0,    0,    0,    0,    0,   79,    0,    0,    0,   79,
+    0,    0,    0,   79,   90,    0,   90,   90,    0,   90,
+   90,   90,   90,   90,   90,  210,   90,   90,   90,   90,
+   90,   79,    0,   79,   79,    0,   79,   79,   79,   79,
+   79,   79,  217,   79,   79,   79,   79,   79,   79,    0,
+    0,    0,    0,   66,   67,    0,   68,   69,   70,   71,
+   72,   73,   87,   74,   75,   76,   77,   78,   79,    0,
+   66,   67,    0,   68,   69,   70,   71,   72,   73,  134,
+   74,   75,   76,   77,   78,   79,    0,    0,   66,   67,
+    0,   68,   69,   70,   71,   72,   73,  140,   74,   75,
+   76,   77,   78,   79,    0,   66,   67,    0,   68,   69,
+   70,   71,   72,   73,  141,   74,   75,   76,   77,   78,
+   79,    0,    0,   66,   67,    0,   68,   69,   70,   71,
+   72,   73,    0,   74,   75,   76,   77,   78,   79,    0,
+   66,   67,    0,   68,   69,   70,   71,   72,   73,    0,
+   74,   75,   76,   77,   78,   79,   85,   85,    0,   85,
+    0,   85,    0,   85,    0,   85,    0,    0,    0,    0,
+   86,   86,    0,   86,    0,   86,    0,   86,    0,   86,
+    0,    0,    0,   85,    0,   85,   85,    0,   85,   85,
+   85,   85,   85,   85,  133,   85,   85,   86,    0,   86,
+   86,    0,   86,   86,   86,   86,   86,   86,    0,   86,
+   86,    0,    0,    0,    0,    0,   66,   67,    0,   68,
+   69,   70,   71,   72,   73,    0,   74,   75,   76,   77,
+   78,   79,   20,    0,    0,    0,   20,    0,    0,    0,
+   20,    0,  105,  105,    0,  105,    0,  105,    0,  105,
+    0,  105,    0,    0,    0,    0,    0,    0,   20,    0,
+   95,   95,    0,   95,   95,   95,   95,   95,   95,  105,
+    0,  105,  105,  107,  107,    0,  107,    0,  107,    0,
+  107,    0,  107,  103,  103,    0,  103,    0,  103,    0,
+  103,    0,  103,    0,    0,    0,    0,    0,    0,    0,
+  107,    0,  107,  107,    0,    0,    0,    0,    0,    0,
+  103,    0,  103,  103,  104,  104,    0,  104,    0,  104,
+    0,  104,    0,  104,  106,  106,    0,  106,    0,  106,
+    0,  106,    0,  106,    0,    0,    0,    0,    0,    0,
+    0,  104,    0,  104,  104,    0,    0,    0,    0,    0,
+    0,  106,    0,  106,  106,  100,  100,    0,  100,    0,
+  100,    0,  100,    0,  100,   66,   67,    0,   68,   69,
+   70,   71,   72,   73,    0,   74,   75,   76,   77,   78,
+   79,    0,  100,    0,  100,  100,   66,   67,    0,  154,
+  155,  156,  157,  158,  159,    0,   74,   75,   76,   77,
+   78,   79,   67,    0,   68,   69,   70,   71,   72,   73,
+    0,   74,   75,   76,   77,   78,   79,   68,   69,   70,
+   71,   72,   73,    0,   74,   75,   76,   77,   78,   79,
 };
 static const YYINT yycheck[] = {                          1,
-    3,  259,    4,  295,    1,  263,  267,    4,   48,   49,
-   13,  303,  304,  160,  103,  104,  258,  130,  260,   22,
-   23,   24,  259,   25,   26,   65,   66,  257,  258,  267,
-  260,  144,  262,  259,  264,  182,  266,   40,   41,  267,
-   43,   44,  259,  190,  286,  287,  263,   50,   51,  257,
-  258,  279,  280,  281,  284,  258,  286,  287,  266,   62,
-  258,  257,  260,  266,   67,   68,   69,   70,   71,   72,
-   73,   74,   75,   76,   77,   78,  257,  266,  167,  260,
-   82,   84,  258,  272,   86,   82,   88,  257,  258,   86,
-  266,   88,  263,   96,  183,   98,  266,  258,  101,  260,
-  189,  258,  260,  260,  257,  286,  287,  260,  289,  290,
-  291,  292,  293,  294,  295,  296,  297,  298,  299,  300,
-  301,  124,  303,  304,  258,  286,  287,  130,  295,  286,
-  287,  258,  266,  136,  137,  262,  303,  304,  178,  266,
-  258,  144,  260,  146,  147,  148,  149,  150,  151,  259,
-  152,  259,  257,  258,  157,  259,  259,  284,  160,  286,
-  287,  266,  289,  290,  291,  292,  293,  294,  258,  172,
-  257,  259,  262,  260,  176,  257,  266,  263,  256,  176,
-  182,  259,  257,  261,  257,  260,  260,  265,  190,  267,
-  268,  269,  270,  271,  272,  273,  274,  275,  276,  277,
-  278,  279,  280,  281,  258,  283,  260,  285,  257,  258,
-  288,  260,  258,  262,  258,  264,  262,  266,  262,  297,
-  266,  257,  266,  258,  260,  303,  304,  262,  266,  301,
-  264,  266,  286,  287,  267,  284,  258,  286,  287,  260,
-  289,  290,  291,  292,  293,  294,  295,  296,  297,  298,
-  299,  300,  301,  261,  303,  304,  263,  257,  258,  258,
-  260,  266,  262,  262,  264,  260,  266,  266,  286,  287,
-  264,  289,  290,  291,  292,  293,  294,  258,  296,  297,
-  298,  299,  300,  301,  284,  284,  286,  287,  284,  289,
-  290,  291,  292,  293,  294,  295,  296,  297,  298,  299,
-  300,  301,  282,  303,  304,  258,  259,  267,  261,  262,
-  260,  263,  265,  266,  267,  268,  269,  264,  271,  272,
-  273,  274,  275,  276,  277,  278,  279,  280,  281,  258,
-  283,  267,  285,  262,  258,  288,  263,  266,  262,  264,
-  260,  260,  266,  260,  297,  260,  259,  258,  261,  261,
-  303,  304,  265,  258,  267,  268,  269,  260,  271,  272,
-  273,  274,  275,  276,  277,  278,  279,  280,  281,  258,
-  283,  260,  285,  259,  172,  288,  258,  101,  260,  265,
-  176,  267,  268,  269,  297,   -1,   -1,  273,   -1,   -1,
-  303,  304,  278,  279,  280,  281,   -1,  286,  287,   -1,
-  259,  260,  288,   -1,  286,  287,  265,   -1,  267,  268,
-   -1,  297,   -1,   -1,  273,   -1,   -1,  303,  304,  278,
-  279,  280,  281,  298,  299,  300,  301,  259,   -1,  288,
-   -1,   -1,  264,  265,   -1,  267,  268,   -1,  297,   -1,
+    3,  267,    4,    1,  295,  266,    4,  137,   49,   50,
+   13,  272,  303,  304,  258,  267,  260,  109,  110,   22,
+   23,   24,  152,   25,   26,   66,   67,  257,  258,  267,
+  260,  267,  262,  258,  264,  260,  266,  303,   41,   42,
+  259,   44,   45,  279,  280,  281,  259,  259,   51,   52,
+  257,  258,  257,  169,  284,  262,  286,  287,  259,  266,
+   63,  286,  287,  259,  259,   68,   69,   70,   71,   72,
+   73,   74,   75,   76,   77,   78,   79,  284,  194,  259,
+  263,   83,   85,   86,  176,   83,   88,  203,   90,  258,
+   88,  260,   90,  257,  258,  258,  258,  260,  260,  102,
+  259,  104,  266,  195,  107,  258,  265,  223,  267,  268,
+  202,  259,  259,  266,  273,  263,  263,  286,  287,  278,
+  279,  280,  281,  286,  287,  290,  259,  130,  293,  288,
+  263,  258,  224,  260,  137,  258,  260,  296,  297,  298,
+  143,  144,  263,  266,  303,  304,  257,  257,  189,  152,
+  260,  154,  155,  156,  157,  158,  159,  258,  160,  286,
+  287,  262,  165,  295,  257,  266,  257,  169,  258,  260,
+  260,  303,  304,  257,  258,  260,  260,  258,  262,  182,
+  264,  262,  266,  284,  186,  266,  257,  258,  186,  260,
+  267,  262,  194,  264,  301,  266,  286,  287,  201,  264,
+  284,  203,  286,  287,  266,  289,  290,  291,  292,  293,
+  294,  256,  215,  284,  259,  286,  261,  267,  260,  258,
+  265,  223,  267,  268,  269,  270,  271,  272,  273,  274,
+  275,  276,  277,  278,  279,  280,  281,  258,  283,  260,
+  285,  257,  258,  288,  260,  260,  262,  258,  264,  258,
+  266,  262,  297,  257,  258,  266,  261,  266,  303,  304,
+  257,  258,  266,  263,  257,  286,  287,  260,  284,  266,
+  286,  287,  260,  289,  290,  291,  292,  293,  294,  295,
+  296,  297,  298,  299,  300,  301,  275,  303,  304,  257,
+  258,  258,  260,  258,  262,  262,  264,  262,  266,  266,
+  258,  266,  266,  258,  262,  264,  257,  262,  266,  260,
+  257,  266,  258,  260,  259,  284,  284,  284,  286,  287,
+  267,  289,  290,  291,  292,  293,  294,  295,  296,  297,
+  298,  299,  300,  301,  257,  303,  304,  260,  282,  286,
+  287,  267,  289,  290,  291,  292,  293,  294,  295,  296,
+  297,  298,  299,  300,  301,  267,  303,  304,  298,  299,
+  300,  301,  260,  286,  287,  295,  289,  290,  291,  292,
+  293,  294,  295,  296,  297,  298,  299,  300,  301,  263,
+  303,  304,  258,  259,  264,  261,  262,  264,  267,  265,
+  266,  267,  268,  269,  263,  271,  272,  273,  274,  275,
+  276,  277,  278,  279,  280,  281,  258,  283,  267,  285,
+  262,  258,  288,  303,  266,  262,  267,  260,  260,  266,
+  260,  297,  260,  260,  258,  261,  258,  303,  304,  260,
+  107,  182,  284,  186,  286,  287,   -1,  289,  290,  291,
+  292,  293,  294,  295,  296,  297,  298,  299,  300,  301,
+  258,  303,  304,  259,  262,  261,   -1,   -1,  266,  265,
+   -1,  267,  268,  269,   -1,  271,  272,  273,  274,  275,
+  276,  277,  278,  279,  280,  281,  284,  283,   -1,  285,
+  259,   -1,  288,   -1,   -1,   -1,  265,   -1,  267,  268,
+  269,  297,   -1,   -1,  273,   -1,   -1,  303,  304,  278,
+  279,  280,  281,   -1,   -1,   -1,   -1,  259,  260,  288,
+   -1,   -1,   -1,  265,   -1,  267,  268,   -1,  297,   -1,
    -1,  273,   -1,   -1,  303,  304,  278,  279,  280,  281,
-  257,  258,   -1,  260,  259,  262,  288,  264,   -1,  266,
+   -1,   -1,   -1,   -1,  259,   -1,  288,   -1,   -1,  264,
   265,   -1,  267,  268,   -1,  297,   -1,   -1,  273,   -1,
-   -1,  303,  304,  278,  279,  280,  281,  284,  258,  286,
-  287,  259,  262,  288,   -1,   -1,  266,  265,   -1,  267,
+   -1,  303,  304,  278,  279,  280,  281,  257,  258,   -1,
+  260,  259,  262,  288,  264,   -1,  266,  265,   -1,  267,
   268,   -1,  297,   -1,   -1,  273,   -1,   -1,  303,  304,
-  278,  279,  280,  281,  284,   -1,   -1,   -1,  259,   -1,
-  288,   -1,   -1,   -1,  265,   -1,  267,  268,   -1,  297,
+  278,  279,  280,  281,  284,  258,  286,  287,  259,  262,
+  288,   -1,   -1,  266,  265,   -1,  267,  268,   -1,  297,
    -1,   -1,  273,   -1,   -1,  303,  304,  278,  279,  280,
-  281,  257,  258,   -1,  260,   -1,  262,  288,  264,   -1,
-  266,   -1,  257,  258,   -1,   -1,  297,  262,   -1,   -1,
-   -1,  266,  303,  304,   -1,   -1,   -1,   -1,  284,   -1,
-  286,  287,   -1,  289,  290,  291,  292,  293,  294,  284,
-  296,  297,  298,  299,  300,  301,  257,  258,   -1,  260,
-   -1,  262,   -1,  264,   -1,  266,  296,  297,  298,  299,
-  300,  301,   -1,   -1,   -1,  257,  258,   -1,  260,   -1,
-  262,   -1,  264,  284,  266,  286,  287,   -1,  289,  290,
-  291,  292,  293,  294,   -1,  296,  297,  298,  299,  300,
-  301,   -1,  284,   -1,  286,  287,   -1,  289,  290,  291,
-  292,  293,  294,   -1,  296,  297,  298,  299,  300,  257,
-  258,  258,  260,   -1,  262,  262,  264,   -1,  266,  266,
-   -1,   -1,   -1,   -1,   -1,   -1,  257,  258,   -1,  260,
-   -1,  262,   -1,  264,   -1,  266,  284,  284,  286,  287,
-   -1,  289,  290,  291,  292,  293,  294,   -1,  296,  297,
-  298,  299,  300,  284,   -1,  286,  287,   -1,  289,  290,
-  291,  292,  293,  294,   -1,  296,  297,  298,  299,  300,
-  257,  258,  258,  260,   -1,  262,  262,  264,   -1,  266,
-  266,   -1,   -1,   -1,   -1,   -1,   -1,   -1,  258,   -1,
-   -1,   -1,  262,   -1,   -1,   -1,  266,  284,  284,  286,
-  287,   -1,  289,  290,  291,  292,  293,  294,  260,  296,
-  297,  298,  299,  300,  284,   -1,  286,  287,   -1,  289,
-  290,  291,  292,  293,  294,  260,  296,  297,  298,  299,
-  300,  301,   -1,   -1,  286,  287,   -1,  289,  290,  291,
-  292,  293,  294,  260,  296,  297,  298,  299,  300,  301,
+  281,  284,   -1,   -1,   -1,  259,   -1,  288,   -1,   -1,
+   -1,  265,   -1,  267,  268,   -1,  297,   -1,   -1,  273,
+   -1,   -1,  303,  304,  278,  279,  280,  281,  257,  258,
+   -1,  260,   -1,  262,  288,  264,   -1,  266,   -1,   -1,
+  258,   -1,   -1,  297,  262,   -1,   -1,   -1,  266,  303,
+  304,   -1,   -1,   -1,   -1,  284,   -1,  286,  287,   -1,
+  289,  290,  291,  292,  293,  294,  284,  296,  297,  298,
+  299,  300,  301,  257,  258,   -1,  260,   -1,  262,   -1,
+  264,   -1,  266,  296,  297,  298,  299,  300,  301,   -1,
+   -1,   -1,  257,  258,   -1,  260,   -1,  262,   -1,  264,
+  284,  266,  286,  287,   -1,  289,  290,  291,  292,  293,
+  294,   -1,  296,  297,  298,  299,  300,  301,   -1,  284,
    -1,  286,  287,   -1,  289,  290,  291,  292,  293,  294,
-  260,  296,  297,  298,  299,  300,  301,   -1,   -1,  286,
+   -1,  296,  297,  298,  299,  300,  257,  258,   -1,  260,
+   -1,  262,   -1,  264,   -1,  266,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,  257,  258,   -1,  260,   -1,  262,   -1,
+  264,   -1,  266,  284,   -1,  286,  287,   -1,  289,  290,
+  291,  292,  293,  294,   -1,  296,  297,  298,  299,  300,
+  284,   -1,  286,  287,   -1,  289,  290,  291,  292,  293,
+  294,   -1,  296,  297,  298,  299,  300,  257,  258,   -1,
+  260,   -1,  262,   -1,  264,   -1,  266,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,  258,   -1,   -1,   -1,  262,
+   -1,   -1,   -1,  266,  284,   -1,  286,  287,   -1,  289,
+  290,  291,  292,  293,  294,  258,  296,  297,  298,  299,
+  300,  284,   -1,  286,  287,   -1,  289,  290,  291,  292,
+  293,  294,  258,  296,  297,  298,  299,  300,  301,   -1,
+   -1,   -1,   -1,  286,  287,   -1,  289,  290,  291,  292,
+  293,  294,  260,  296,  297,  298,  299,  300,  301,   -1,
+  286,  287,   -1,  289,  290,  291,  292,  293,  294,  260,
+  296,  297,  298,  299,  300,  301,   -1,   -1,  286,  287,
+   -1,  289,  290,  291,  292,  293,  294,  260,  296,  297,
+  298,  299,  300,  301,   -1,  286,  287,   -1,  289,  290,
+  291,  292,  293,  294,  260,  296,  297,  298,  299,  300,
+  301,   -1,   -1,  286,  287,   -1,  289,  290,  291,  292,
+  293,  294,   -1,  296,  297,  298,  299,  300,  301,   -1,
+  286,  287,   -1,  289,  290,  291,  292,  293,  294,   -1,
+  296,  297,  298,  299,  300,  301,  257,  258,   -1,  260,
+   -1,  262,   -1,  264,   -1,  266,   -1,   -1,   -1,   -1,
+  257,  258,   -1,  260,   -1,  262,   -1,  264,   -1,  266,
+   -1,   -1,   -1,  284,   -1,  286,  287,   -1,  289,  290,
+  291,  292,  293,  294,  264,  296,  297,  284,   -1,  286,
   287,   -1,  289,  290,  291,  292,  293,  294,   -1,  296,
-  297,  298,  299,  300,  301,   -1,  286,  287,   -1,  289,
+  297,   -1,   -1,   -1,   -1,   -1,  286,  287,   -1,  289,
   290,  291,  292,  293,  294,   -1,  296,  297,  298,  299,
-  300,  301,  257,  258,  258,  260,   -1,  262,  262,  264,
-   -1,  266,  266,   -1,   -1,   -1,  257,  258,   -1,  260,
-   -1,  262,   -1,  264,   -1,  266,   -1,   -1,   -1,  284,
-  284,  286,  287,   -1,  289,  290,  291,  292,  293,  294,
-  264,  296,  297,  284,   -1,  286,  287,   -1,  289,  290,
-  291,  292,  293,  294,   -1,  296,  297,   -1,   -1,   -1,
-   -1,   -1,  286,  287,   -1,  289,  290,  291,  292,  293,
-  294,   -1,  296,  297,  298,  299,  300,  301,  257,  258,
-   -1,  260,   -1,  262,   -1,  264,   -1,  266,   -1,  257,
-  258,   -1,  260,   -1,  262,   -1,  264,   -1,  266,   -1,
-   -1,   -1,   -1,   -1,   -1,  284,   -1,  286,  287,   -1,
-  289,  290,  291,  292,  293,  294,  284,   -1,  286,  287,
-  257,  258,   -1,  260,   -1,  262,   -1,  264,   -1,  266,
-  257,  258,   -1,  260,   -1,  262,   -1,  264,   -1,  266,
-   -1,   -1,   -1,   -1,   -1,   -1,   -1,  284,   -1,  286,
-  287,   -1,   -1,   -1,   -1,   -1,   -1,  284,   -1,  286,
-  287,  257,  258,   -1,  260,   -1,  262,   -1,  264,   -1,
-  266,  257,  258,   -1,  260,   -1,  262,   -1,  264,   -1,
-  266,   -1,   -1,   -1,   -1,   -1,   -1,   -1,  284,   -1,
-  286,  287,   -1,   -1,   -1,   -1,   -1,   -1,  284,   -1,
-  286,  287,  257,  258,   -1,  260,   -1,  262,   -1,  264,
-   -1,  266,  257,  258,   -1,  260,   -1,  262,   -1,  264,
-   -1,  266,   -1,   -1,   -1,   -1,   -1,   -1,   -1,  284,
-   -1,  286,  287,   -1,   -1,   -1,   -1,   -1,   -1,  284,
-   -1,  286,  286,  287,   -1,  289,  290,  291,  292,  293,
-  294,   -1,  296,  297,  298,  299,  300,  301,  287,   -1,
-  289,  290,  291,  292,  293,  294,   -1,  296,  297,  298,
-  299,  300,  301,  289,  290,  291,  292,  293,  294,   -1,
-  296,  297,  298,  299,  300,  301,
+  300,  301,  258,   -1,   -1,   -1,  262,   -1,   -1,   -1,
+  266,   -1,  257,  258,   -1,  260,   -1,  262,   -1,  264,
+   -1,  266,   -1,   -1,   -1,   -1,   -1,   -1,  284,   -1,
+  286,  287,   -1,  289,  290,  291,  292,  293,  294,  284,
+   -1,  286,  287,  257,  258,   -1,  260,   -1,  262,   -1,
+  264,   -1,  266,  257,  258,   -1,  260,   -1,  262,   -1,
+  264,   -1,  266,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+  284,   -1,  286,  287,   -1,   -1,   -1,   -1,   -1,   -1,
+  284,   -1,  286,  287,  257,  258,   -1,  260,   -1,  262,
+   -1,  264,   -1,  266,  257,  258,   -1,  260,   -1,  262,
+   -1,  264,   -1,  266,   -1,   -1,   -1,   -1,   -1,   -1,
+   -1,  284,   -1,  286,  287,   -1,   -1,   -1,   -1,   -1,
+   -1,  284,   -1,  286,  287,  257,  258,   -1,  260,   -1,
+  262,   -1,  264,   -1,  266,  286,  287,   -1,  289,  290,
+  291,  292,  293,  294,   -1,  296,  297,  298,  299,  300,
+  301,   -1,  284,   -1,  286,  287,  286,  287,   -1,  289,
+  290,  291,  292,  293,  294,   -1,  296,  297,  298,  299,
+  300,  301,  287,   -1,  289,  290,  291,  292,  293,  294,
+   -1,  296,  297,  298,  299,  300,  301,  289,  290,  291,
+  292,  293,  294,   -1,  296,  297,  298,  299,  300,  301,
 };
 #if YYBTYACC
 static const YYINT yyctable[] = {                        -1,
@@ -733,7 +831,20 @@ static const YYINT yyctable[] = {                        -1,
    -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
    -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
    -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
-   -1,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
+   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,
 };
 #endif
 #define YYFINAL 1
@@ -741,7 +852,7 @@ static const YYINT yyctable[] = {                        -1,
 #define YYDEBUG 0
 #endif
 #define YYMAXTOKEN 304
-#define YYUNDFTOKEN 331
+#define YYUNDFTOKEN 335
 #define YYTRANSLATE(a) ((a) > YYMAXTOKEN ? YYUNDFTOKEN : (a))
 #if YYDEBUG
 static const char *const yyname[] = {
@@ -759,12 +870,13 @@ static const char *const yyname[] = {
 "BOOL_NOT","EQUALS","LESS_EQ","GREATER_EQ","UNEQUALS","LESS","GREATER",
 "ASSIGN_OP","PLUS","MINUS","MULTIPLY","DIVIDE","REMAINDER","EXPONENT","UMINUS",
 "INCR","DECR","$accept","program","named_expression","argument_list",
-"alloc_macro","expression","function","function_header","input_item",
-"opt_argument_list","opt_expression","opt_relational_expression",
-"opt_statement","print_expression","print_expression_list",
-"relational_expression","return_expression","semicolon_list","statement",
-"statement_list","pop_nesting","opt_parameter_list","opt_newline",
-"opt_auto_define_list","parameter_list","define_list","illegal-symbol",
+"alloc_macro","alloc_parallel","expression","function","function_header",
+"input_item","opt_argument_list","opt_expression","opt_relational_expression",
+"opt_statement","par_operator","par_relation","par_step","print_expression",
+"print_expression_list","relational_expression","return_expression",
+"semicolon_list","statement","statement_list","pop_nesting",
+"opt_parameter_list","opt_newline","opt_auto_define_list","parameter_list",
+"define_list","illegal-symbol",
 };
 static const char *const yyrule[] = {
 "$accept : program",
@@ -794,12 +906,21 @@ static const char *const yyrule[] = {
 "statement : QUIT",
 "statement : RETURN return_expression",
 "statement : FOR LPAR alloc_macro opt_expression SEMICOLON opt_relational_expression SEMICOLON opt_expression RPAR opt_statement pop_nesting",
+"statement : LETTER LPAR par_operator LETTER RPAR FOR LPAR alloc_parallel LETTER ASSIGN_OP expression SEMICOLON LETTER par_relation expression SEMICOLON par_step RPAR opt_statement pop_nesting",
 "statement : IF LPAR alloc_macro pop_nesting relational_expression RPAR opt_statement",
 "statement : IF LPAR alloc_macro pop_nesting relational_expression RPAR opt_statement ELSE alloc_macro pop_nesting opt_statement",
 "statement : WHILE LPAR alloc_macro relational_expression RPAR opt_statement pop_nesting",
 "statement : LBRACE statement_list RBRACE",
 "statement : PRINT print_expression_list",
 "alloc_macro :",
+"alloc_parallel :",
+"par_operator : PLUS",
+"par_operator : MULTIPLY",
+"par_operator : LETTER",
+"par_relation : LESS",
+"par_relation : LESS_EQ",
+"par_step : LETTER INCR",
+"par_step : INCR LETTER",
 "pop_nesting :",
 "function : function_header opt_parameter_list RPAR opt_newline LBRACE NEWLINE opt_auto_define_list statement_list RBRACE",
 "function_header : DEFINE LETTER LPAR",
@@ -1006,7 +1127,7 @@ static YYINT  *yylexp = 0;
 
 static YYINT  *yylexemes = 0;
 #endif /* YYBTYACC */
-#line 744 "bc.y"
+#line 934 "bc.y"
 
 
 static void
@@ -1081,18 +1202,75 @@ emit(ssize_t i, int level)
 			i++;
 		}
 	} else if (instructions[i].index != END_NODE)
-		fputs(instructions[i].u.cstr, stdout);
+		output(instructions[i].u.cstr);
 }
 
 static void
 emit_macro(int node, ssize_t code)
 {
-	putchar('[');
+	output("[");
 	emit(code, 0);
-	printf("]s%s\n", instructions[node].u.cstr);
+	output("]s");
+	output(instructions[node].u.cstr);
+	output("\n");
 	nesting--;
 }
 
+/*
+ * Generated code is collected and, at the end of each input item,
+ * written to stdout in one go, which is the pipe to dc when forked.
+ * When running dc in-process it is handed to dc_eval() instead.
+ */
+static void
+output(const char *str)
+{
+	size_t	len, newsize;
+	char	*p;
+
+	len = strlen(str);
+	if (outbuf_len + len >= outbuf_sz) {
+		newsize = outbuf_sz * 2 + len + 1;
+		p = realloc(outbuf, newsize);
+		if (p == NULL)
+			err(1, NULL);
+		outbuf_sz = newsize;
+		outbuf = p;
+	}
+	memcpy(outbuf + outbuf_len, str, len + 1);
+	outbuf_len += len;
+}
+
+static void
+flush_output(void)
+{
+	char	*p;
+	ssize_t	n;
+
+	if (outbuf_len == 0)
+		return;
+	if (in_process) {
+		outbuf_len = 0;
+		/* In a batch, every input item read from stdin is a job */
+		if (batch && yyin == stdin) {
+			if (!batch_started) {
+				dc_batch_init(threads > 0 ? threads : 1);
+				batch_started = true;
+			}
+			dc_batch_eval(outbuf);
+		} else
+			dc_eval(outbuf);
+		return;
+	}
+	for (p = outbuf; outbuf_len > 0; p += n, outbuf_len -= n) {
+		n = write(STDOUT_FILENO, p, outbuf_len);
+		if (n == -1) {
+			if (errno != EINTR)
+				err(1, "write");
+			n = 0;
+		}
+	}
+}
+
 static void
 free_tree(void)
 {
@@ -1104,6 +1282,116 @@ free_tree(void)
 	current = 0;
 }
 
+static ssize_t
+new_macro(bool parallel)
+{
+	ssize_t ret;
+
+	ret = cs(str_table[macro_char]);
+	macro_char++;
+	/* Do not use [, \ and ] */
+	if (macro_char == '[')
+		macro_char += 3;
+	/* skip letters */
+	else if (macro_char == 'a')
+		macro_char = '{';
+	else if (macro_char == ARRAY_CHAR)
+		macro_char += 26;
+	else if (macro_char == 255)
+		fatal("program too big");
+	if (breaksp == BREAKSTACK_SZ)
+		fatal("nesting too deep");
+	breakpar[breaksp] = parallel;
+	breakstack[breaksp++] = nesting++;
+	return ret;
+}
+
+/* Whether the code being compiled runs in the body of a parallel for */
+static bool
+in_parallel(void)
+{
+	int i;
+
+	for (i = 0; i < breaksp; i++)
+		if (breakpar[i])
+			return true;
+	return false;
+}
+
+/* The name of a variable being used, for par_store(), if it may be */
+static char *
+par_name(const char *name, const char *suffix)
+{
+	char *p;
+
+	if (!in_parallel())
+		return NULL;
+	if (asprintf(&p, "%s%s", name, suffix) == -1)
+		err(1, NULL);
+	return p;
+}
+
+/* Note that the variable name is written, in the innermost parallel for */
+static void
+par_store(char *name)
+{
+	struct par_store	*p;
+	int			level;
+
+	if (name == NULL)
+		return;
+	for (level = breaksp - 1; !breakpar[level]; level--)
+		continue;
+	p = reallocarray(par_stores, par_nstores + 1, sizeof(*p));
+	if (p == NULL)
+		err(1, NULL);
+	par_stores = p;
+	par_stores[par_nstores].name = name;
+	par_stores[par_nstores++].level = level;
+}
+
+/*
+ * At the end of the parallel for with the reduction variable s and the
+ * index i, warn of the other variables its body writes: each chunk of
+ * the loop has its own copy of them, and they are not kept after it.
+ * Not in a batch, where a warning would take the place of a job.  Both
+ * s and i are written in the body of an outer parallel for.  With s
+ * NULL, forget the loop.
+ */
+static void
+par_end(const char *s, const char *i)
+{
+	char	*msg;
+	size_t	first, j, k;
+
+	for (first = par_nstores; first > 0 &&
+	    par_stores[first - 1].level >= breaksp; first--)
+		continue;
+	for (j = first; j < par_nstores; j++) {
+		if (s == NULL || batch || strcmp(par_stores[j].name, s) == 0)
+			continue;
+		for (k = first; k < j; k++)
+			if (strcmp(par_stores[k].name,
+			    par_stores[j].name) == 0)
+				break;
+		if (k < j)
+			continue;
+		if (asprintf(&msg, "%s is set in a parallel for, so not "
+		    "shared by its chunks or kept after it",
+		    par_stores[j].name) == -1)
+			err(1, NULL);
+		warning(msg);
+		free(msg);
+	}
+	for (j = first; j < par_nstores; j++)
+		free(par_stores[j].name);
+	par_nstores = first;
+	if (s != NULL) {
+		par_store(par_name(s, ""));
+		par_store(par_name(i, ""));
+	}
+}
+
 static ssize_t
 numnode(int num)
 {
@@ -1119,23 +1407,59 @@ numnode(int num)
 }
 
 
+/* The slot of name in a symbol table of size sz, a power of two */
+static struct symbol *
+symtab_slot(struct symbol *tab, size_t sz, const char *name)
+{
+	const u_char	*p;
+	size_t		h = 2166136261U;
+
+	for (p = (const u_char *)name; *p != '\0'; p++)
+		h = (h ^ *p) * 16777619U;
+	for (h &= sz - 1; tab[h].name != NULL; h = (h + 1) & (sz - 1))
+		if (strcmp(tab[h].name, name) == 0)
+			break;
+	return &tab[h];
+}
+
+static void
+symtab_grow(void)
+{
+	struct symbol	*tab;
+	size_t		i, sz;
+
+	sz = symtab_sz == 0 ? SYMTAB_MIN : symtab_sz * 2;
+	tab = calloc(sz, sizeof(*tab));
+	if (tab == NULL)
+		err(1, NULL);
+	for (i = 0; i < symtab_sz; i++)
+		if (symtab[i].name != NULL)
+			*symtab_slot(tab, sz, symtab[i].name) = symtab[i];
+	free(symtab);
+	symtab = tab;
+	symtab_sz = sz;
+}
+
 static ssize_t
 lookup(char * str, size_t len, char type)
 {
-	ENTRY	entry, *found;
-	u_short	num;
-	u_char	*p;
+	struct symbol	*sym;
+	u_short		num;
+	u_char		*p;
 
 	/* The scanner allocated an extra byte already */
 	if (str[len-1] != type) {
 		str[len] = type;
 		str[len+1] = '\0';
 	}
-	entry.key = str;
-	found = hsearch(entry, FIND);
-	if (found == NULL) {
+	sym = symtab_slot(symtab, symtab_sz, str);
+	if (sym->name == NULL) {
 		if (var_count == MAX_VARIABLES)
 			errx(1, "too many variables");
+		if (2 * (var_count + 1) > symtab_sz) {
+			symtab_grow();
+			sym = symtab_slot(symtab, symtab_sz, str);
+		}
 		p = malloc(4);
 		if (p == NULL)
 			err(1, NULL);
@@ -1145,15 +1469,12 @@ lookup(char * str, size_t len, char type)
 		p[2] = ENCODE(num % VAR_BASE + 1);
 		p[3] = '\0';
 
-		entry.data = (char *)p;
-		entry.key = strdup(str);
-		if (entry.key == NULL)
-			err(1, NULL);
-		found = hsearch(entry, ENTER);
-		if (found == NULL)
+		sym->reg = (char *)p;
+		sym->name = strdup(str);
+		if (sym->name == NULL)
 			err(1, NULL);
 	}
-	return cs(found->data);
+	return cs(sym->reg);
 }
 
 static ssize_t
@@ -1192,6 +1513,61 @@ function_node(char *str)
 		return lookup(str, len, 'F');
 }
 
+/*
+ * The opcode that replaces the body of a function of the math library,
+ * or NULL.  The functions stay in their registers, so that a program
+ * can still redefine them.
+ */
+static const char *
+library_opcode(const char *name)
+{
+	size_t	i;
+
+	if (!native_lib || strcmp(filename, _PATH_LIBB) != 0)
+		return NULL;
+	for (i = 0; i < LIBRARY_SZ; i++)
+		if (strcmp(name, library[i].name) == 0)
+			return library[i].opcode;
+	return NULL;
+}
+
+/* Whether n is node(l, r, cs(op), END_NODE) */
+static bool
+binary_node(ssize_t n, const char *op, ssize_t *l, ssize_t *r)
+{
+	ssize_t	o;
+
+	if (instructions[n].index < 0 || n + 3 >= current ||
+	    instructions[n + 3].index != END_NODE)
+		return false;
+	o = instructions[n + 2].index;
+	if (o < 0 || instructions[o].index != CONST_STRING ||
+	    strcmp(instructions[o].u.cstr, op) != 0)
+		return false;
+	*l = instructions[n].index;
+	*r = instructions[n + 1].index;
+	return true;
+}
+
+/*
+ * a % m, with a^b % m and a*b + c % m done by dc in one step.  The
+ * operands are evaluated in the same order either way.
+ */
+static ssize_t
+remainder_node(ssize_t n, ssize_t m)
+{
+	ssize_t	a, b, c, ab;
+
+	if (own_dc) {
+		if (binary_node(n, "^", &a, &b))
+			return node(a, b, m, cs("|"), END_NODE);
+		if (binary_node(n, "+", &ab, &c) &&
+		    binary_node(ab, "*", &a, &b))
+			return node(a, b, c, m, cs("m"), END_NODE);
+	}
+	return node(n, m, cs("%"), END_NODE);
+}
+
 static void
 add_par(ssize_t n)
 {
@@ -1209,7 +1585,7 @@ add_local(ssize_t n)
 void
 yyerror(char *s)
 {
-	char	*str, *p;
+	char	*str;
 	int	n;
 
 	if (yyin != NULL && feof(yyin))
@@ -1229,15 +1605,27 @@ yyerror(char *s)
 		    __progname, filename, lineno, s, yytext);
 	if (n == -1)
 		err(1, NULL);
+	print_error(str);
+	free(str);
+}
+
+/* Have dc print the message, so that it comes in order with its output */
+static void
+print_error(const char *str)
+{
+	const char	*p;
+	char		c[2];
 
-	fputs("c[", stdout);
+	output("c[");
 	for (p = str; *p != '\0'; p++) {
 		if (*p == '[' || *p == ']' || *p =='\\')
-			putchar('\\');
-		putchar(*p);
+			output("\\");
+		c[0] = *p;
+		c[1] = '\0';
+		output(c);
 	}
-	fputs("]ec\n", stdout);
-	free(str);
+	output("]ec\n");
+	flush_output();
 }
 
 void
@@ -1249,7 +1637,17 @@ fatal(const char *s)
 static void
 warning(const char *s)
 {
-	warnx("%s:%d: %s", filename, lineno, s);
+	char	*str;
+
+	/* A batch job must get its error line */
+	if (batch && yyin == stdin) {
+		if (asprintf(&str, "%s: %s:%d: %s", __progname, filename,
+		    lineno, s) == -1)
+			err(1, NULL);
+		print_error(str);
+		free(str);
+	} else
+		warnx("%s:%d: %s", filename, lineno, s);
 }
 
 static void
@@ -1261,15 +1659,15 @@ init(void)
 		str_table[i][0] = i;
 		str_table[i][1] = '\0';
 	}
-	if (hcreate(1 << 16) == 0)
-		err(1, NULL);
+	symtab_grow();
 }
 
 
 static void
 usage(void)
 {
-	fprintf(stderr, "usage: %s [-cl] [-e expression] [file ...]\n",
+	fprintf(stderr,
+	    "usage: %s [-bclp] [-a index] [-e expression] [-j threads] [file ...]\n",
 	    __progname);
 	exit(1);
 }
@@ -1379,11 +1777,23 @@ main(int argc, char *argv[])
 	if ((cmdexpr = strdup("")) == NULL)
 		err(1, NULL);
 	/* The d debug option is 4.4 BSD bc(1) compatible */
-	while ((ch = getopt(argc, argv, "cde:l")) != -1) {
+	while ((ch = getopt(argc, argv, "a:bcde:j:lp")) != -1) {
 		switch (ch) {
+		case 'a':
+			array_max = strtol(optarg, &q, 10);
+			if (optarg[0] == '\0' || *q != '\0' || array_max < 0 ||
+			    array_max == LONG_MAX)
+				errx(1, "invalid array index: %s", optarg);
+			break;
+		case 'b':
+			batch = true;
+			do_fork = false;
+			in_process = true;
+			break;
 		case 'c':
 		case 'd':
 			do_fork = false;
+			in_process = false;
 			break;
 		case 'e':
 			q = cmdexpr;
@@ -1391,8 +1801,19 @@ main(int argc, char *argv[])
 				err(1, NULL);
 			free(q);
 			break;
+		case 'j':
+			threads = strtol(optarg, &q, 10);
+			if (optarg[0] == '\0' || *q != '\0' ||
+			    threads < 1 || threads > MAX_THREADS)
+				errx(1, "invalid number of threads: %s", optarg);
+			break;
 		case 'l':
 			sargv[sargc++] = _PATH_LIBB;
+			native_lib = true;
+			break;
+		case 'p':
+			do_fork = false;
+			in_process = true;
 			break;
 		default:
 			usage();
@@ -1420,17 +1841,41 @@ main(int argc, char *argv[])
 			close(p[0]);
 			close(p[1]);
 		} else {
-			char *dc_argv[] = { "dc", "-x", NULL };
+			char *dc_argv[] = { "dc", "-x", NULL, NULL, NULL, NULL,
+			    NULL };
 			extern int dc_main(int, char **);
+			int dc_argc = 2;
+			char jbuf[24], abuf[24];
 
 			close(STDIN_FILENO);
 			dup(p[0]);
 			close(p[0]);
 			close(p[1]);
 
-			exit (dc_main(2, dc_argv));
+			if (threads > 0) {
+				(void)snprintf(jbuf, sizeof(jbuf), "%ld",
+				    threads);
+				dc_argv[dc_argc++] = "-j";
+				dc_argv[dc_argc++] = jbuf;
+			}
+			if (array_max >= 0) {
+				(void)snprintf(abuf, sizeof(abuf), "%ld",
+				    array_max);
+				dc_argv[dc_argc++] = "-a";
+				dc_argv[dc_argc++] = abuf;
+			}
+			exit (dc_main(dc_argc, dc_argv));
 		}
+	} else if (in_process) {
+		dc_init();
+		dc_threads(threads);
+		if (array_max >= 0)
+			dc_array_max(array_max);
 	}
+	/* Code printed with -c is not bound to this dc */
+	own_dc = do_fork || in_process;
+	batch = batch && in_process;
+	native_lib = native_lib && own_dc && dc_native_library();
 	if (interactive) {
 		gettty(&ttysaved);
 		el = el_init("bc", stdin, stderr, stderr);
@@ -1446,9 +1891,12 @@ main(int argc, char *argv[])
 	}
 
 	yywrap();
-	return yyparse();
+	i = yyparse();
+	if (batch_started)
+		dc_batch_end();
+	return i;
 }
-#line 1452 "bc.c"
+#line 1900 "bc.c"
 
 /* For use in generated program */
 #define yydepth (int)(yystack.s_mark - yystack.s_base)
@@ -2119,91 +2567,96 @@ yyreduce:
     switch (yyn)
     {
 case 3:
-#line 178 "bc.y"
+#line 237 "bc.y"
 	{
 				emit(yystack.l_mark[-1].node, 0);
 				macro_char = reset_macro_char;
-				putchar('\n');
+				output("\n");
+				flush_output();
 				free_tree();
 				st_has_continue = false;
 			}
-#line 2131 "bc.c"
+#line 2580 "bc.c"
 break;
 case 4:
-#line 186 "bc.y"
+#line 246 "bc.y"
 	{
-				putchar('\n');
+				output("\n");
+				/* In a batch, the rest of its last line joins it */
+				if (!batch || yyin != stdin)
+					flush_output();
 				free_tree();
 				st_has_continue = false;
 			}
-#line 2140 "bc.c"
+#line 2592 "bc.c"
 break;
 case 5:
-#line 192 "bc.y"
+#line 255 "bc.y"
 	{
 				yyerrok;
 			}
-#line 2147 "bc.c"
+#line 2599 "bc.c"
 break;
 case 6:
-#line 196 "bc.y"
+#line 259 "bc.y"
 	{
 				yyerrok;
 			}
-#line 2154 "bc.c"
+#line 2606 "bc.c"
 break;
 case 7:
-#line 202 "bc.y"
+#line 265 "bc.y"
 	{
 				yyval.node = cs("");
 			}
-#line 2161 "bc.c"
+#line 2613 "bc.c"
 break;
 case 9:
-#line 207 "bc.y"
+#line 270 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, END_NODE);
 			}
-#line 2168 "bc.c"
+#line 2620 "bc.c"
 break;
 case 11:
-#line 214 "bc.y"
+#line 277 "bc.y"
 	{
 				yyval.node = cs("");
 			}
-#line 2175 "bc.c"
+#line 2627 "bc.c"
 break;
 case 14:
-#line 220 "bc.y"
+#line 283 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, END_NODE);
 			}
-#line 2182 "bc.c"
+#line 2634 "bc.c"
 break;
 case 16:
-#line 225 "bc.y"
+#line 288 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, END_NODE);
 			}
-#line 2189 "bc.c"
+#line 2641 "bc.c"
 break;
 case 17:
-#line 232 "bc.y"
+#line 295 "bc.y"
 	{
 				yyval.node = cs("");
 			}
-#line 2196 "bc.c"
+#line 2648 "bc.c"
 break;
 case 19:
-#line 239 "bc.y"
+#line 302 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[0].node, cs("ps."), END_NODE);
 			}
-#line 2203 "bc.c"
+#line 2655 "bc.c"
 break;
 case 20:
-#line 243 "bc.y"
+#line 306 "bc.y"
 	{
+				par_store(yystack.l_mark[-2].lvalue.name);
 				if (yystack.l_mark[-1].str[0] == '\0')
 					yyval.node = node(yystack.l_mark[0].node, cs(yystack.l_mark[-1].str), yystack.l_mark[-2].lvalue.store,
 					    END_NODE);
@@ -2211,22 +2664,25 @@ case 20:
 					yyval.node = node(yystack.l_mark[-2].lvalue.load, yystack.l_mark[0].node, cs(yystack.l_mark[-1].str), yystack.l_mark[-2].lvalue.store,
 					    END_NODE);
 			}
-#line 2215 "bc.c"
+#line 2668 "bc.c"
 break;
 case 21:
-#line 252 "bc.y"
+#line 316 "bc.y"
 	{
 				yyval.node = node(cs("["), as(yystack.l_mark[0].str),
 				    cs("]P"), END_NODE);
 			}
-#line 2223 "bc.c"
+#line 2676 "bc.c"
 break;
 case 22:
-#line 257 "bc.y"
+#line 321 "bc.y"
 	{
 				if (breaksp == 0) {
 					warning("break not in for or while");
 					YYERROR;
+				} else if (breakpar[breaksp-1]) {
+					warning("break in parallel for");
+					YYERROR;
 				} else {
 					yyval.node = node(
 					    numnode(nesting -
@@ -2234,14 +2690,17 @@ case 22:
 					    cs("Q"), END_NODE);
 				}
 			}
-#line 2238 "bc.c"
+#line 2694 "bc.c"
 break;
 case 23:
-#line 269 "bc.y"
+#line 336 "bc.y"
 	{
 				if (breaksp == 0) {
 					warning("continue not in for or while");
 					YYERROR;
+				} else if (breakpar[breaksp-1]) {
+					warning("continue in parallel for");
+					YYERROR;
 				} else {
 					st_has_continue = true;
 					yyval.node = node(numnode(nesting -
@@ -2249,36 +2708,47 @@ case 23:
 					    cs("J"), END_NODE);
 				}
 			}
-#line 2253 "bc.c"
+#line 2712 "bc.c"
 break;
 case 24:
-#line 281 "bc.y"
+#line 351 "bc.y"
 	{
 				sigset_t mask;
 
-				putchar('q');
-				fflush(stdout);
+				if (batch) {
+					/* A function ending the input is held */
+					flush_output();
+					if (batch_started)
+						dc_batch_end();
+					exit(0);
+				}
+				output("q");
+				flush_output();
 				if (dc) {
 					sigprocmask(SIG_BLOCK, NULL, &mask);
 					sigsuspend(&mask);
 				} else
 					exit(0);
 			}
-#line 2268 "bc.c"
+#line 2734 "bc.c"
 break;
 case 25:
-#line 293 "bc.y"
+#line 370 "bc.y"
 	{
 				if (nesting == 0) {
 					warning("return must be in a function");
 					YYERROR;
 				}
+				if (in_parallel()) {
+					warning("return in parallel for");
+					YYERROR;
+				}
 				yyval.node = yystack.l_mark[0].node;
 			}
-#line 2279 "bc.c"
+#line 2749 "bc.c"
 break;
 case 26:
-#line 303 "bc.y"
+#line 384 "bc.y"
 	{
 				ssize_t n;
 
@@ -2293,28 +2763,88 @@ case 26:
 				yyval.node = node(yystack.l_mark[-7].node, cs("s."), yystack.l_mark[-5].node, yystack.l_mark[-8].node, cs(" "),
 				    END_NODE);
 			}
-#line 2297 "bc.c"
+#line 2767 "bc.c"
 break;
 case 27:
-#line 319 "bc.y"
+#line 402 "bc.y"
+	{
+				ssize_t	s, init;
+				int	mode;
+				const char *msg = NULL;
+
+				/*
+				 * "parallel" is not a keyword, so that it stays
+				 * usable as a name.  The arguments of a call
+				 * cannot start with + or *, or with two names.
+				 */
+				if (strcmp(yystack.l_mark[-19].astr, "parallel") != 0)
+					msg = "syntax error";
+				else if (yystack.l_mark[-10].str[0] != '\0' ||
+				    strcmp(yystack.l_mark[-11].astr, yystack.l_mark[-7].astr) != 0 ||
+				    strcmp(yystack.l_mark[-11].astr, yystack.l_mark[-3].astr) != 0)
+					msg = "parallel for must have the form "
+					    "for (i = a; i < b; i++)";
+				free(yystack.l_mark[-19].astr);
+				if (msg != NULL) {
+					par_end(NULL, NULL);
+					free(yystack.l_mark[-16].astr);
+					free(yystack.l_mark[-11].astr);
+					free(yystack.l_mark[-7].astr);
+					free(yystack.l_mark[-3].astr);
+					nesting--;
+					warning(msg);
+					YYERROR;
+				}
+				par_end(yystack.l_mark[-16].astr, yystack.l_mark[-11].astr);
+				/*
+				 * dc runs the body for each index from a on,
+				 * in chunks, on machines with their own copies
+				 * of the variables.  Each chunk starts its
+				 * partial result from init; & combines them
+				 * and leaves the index after the last on top.
+				 * The bound is evaluated once.
+				 */
+				emit_macro(yystack.l_mark[-12].node, node(cs("s"), letter_node(yystack.l_mark[-11].astr), yystack.l_mark[-1].node,
+				    END_NODE));
+				s = letter_node(yystack.l_mark[-16].astr);
+				mode = yystack.l_mark[-17].node + yystack.l_mark[-6].node;
+				if (yystack.l_mark[-17].node == 0)
+					init = node(cs("[0s"), s, cs("]"), END_NODE);
+				else if (yystack.l_mark[-17].node == 2)
+					init = node(cs("[1s"), s, cs("]"), END_NODE);
+				else
+					init = cs("[]");
+				yyval.node = node(cs("l"), s, yystack.l_mark[-9].node, cs(" "), yystack.l_mark[-5].node,
+				    numnode(mode), init, cs("l"), yystack.l_mark[-12].node, cs("[l"), s,
+				    cs("]&s"), letter_node(yystack.l_mark[-11].astr), cs("s"), s, cs(" "),
+				    END_NODE);
+				free(yystack.l_mark[-16].astr);
+				free(yystack.l_mark[-11].astr);
+				free(yystack.l_mark[-7].astr);
+				free(yystack.l_mark[-3].astr);
+			}
+#line 2827 "bc.c"
+break;
+case 28:
+#line 460 "bc.y"
 	{
 				emit_macro(yystack.l_mark[-4].node, yystack.l_mark[0].node);
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[-4].node, cs(" "), END_NODE);
 			}
-#line 2305 "bc.c"
+#line 2835 "bc.c"
 break;
-case 28:
-#line 325 "bc.y"
+case 29:
+#line 466 "bc.y"
 	{
 				emit_macro(yystack.l_mark[-8].node, yystack.l_mark[-4].node);
 				emit_macro(yystack.l_mark[-2].node, yystack.l_mark[0].node);
 				yyval.node = node(yystack.l_mark[-6].node, yystack.l_mark[-8].node, cs("e"), yystack.l_mark[-2].node, cs(" "),
 				    END_NODE);
 			}
-#line 2315 "bc.c"
+#line 2845 "bc.c"
 break;
-case 29:
-#line 333 "bc.y"
+case 30:
+#line 474 "bc.y"
 	{
 				ssize_t n;
 
@@ -2325,66 +2855,120 @@ case 29:
 				emit_macro(yystack.l_mark[-4].node, n);
 				yyval.node = node(yystack.l_mark[-3].node, yystack.l_mark[-4].node, cs(" "), END_NODE);
 			}
-#line 2329 "bc.c"
+#line 2859 "bc.c"
 break;
-case 30:
-#line 344 "bc.y"
+case 31:
+#line 485 "bc.y"
 	{
 				yyval.node = yystack.l_mark[-1].node;
 			}
-#line 2336 "bc.c"
+#line 2866 "bc.c"
 break;
-case 31:
-#line 348 "bc.y"
+case 32:
+#line 489 "bc.y"
 	{
 				yyval.node = yystack.l_mark[0].node;
 			}
-#line 2343 "bc.c"
-break;
-case 32:
-#line 354 "bc.y"
-	{
-				yyval.node = cs(str_table[macro_char]);
-				macro_char++;
-				/* Do not use [, \ and ] */
-				if (macro_char == '[')
-					macro_char += 3;
-				/* skip letters */
-				else if (macro_char == 'a')
-					macro_char = '{';
-				else if (macro_char == ARRAY_CHAR)
-					macro_char += 26;
-				else if (macro_char == 255)
-					fatal("program too big");
-				if (breaksp == BREAKSTACK_SZ)
-					fatal("nesting too deep");
-				breakstack[breaksp++] = nesting++;
-			}
-#line 2364 "bc.c"
+#line 2873 "bc.c"
 break;
 case 33:
-#line 374 "bc.y"
+#line 495 "bc.y"
 	{
-				breaksp--;
+				yyval.node = new_macro(false);
 			}
-#line 2371 "bc.c"
+#line 2880 "bc.c"
 break;
 case 34:
-#line 382 "bc.y"
+#line 501 "bc.y"
+	{
+				yyval.node = new_macro(true);
+			}
+#line 2887 "bc.c"
+break;
+case 35:
+#line 507 "bc.y"
+	{
+				yyval.node = 0;
+			}
+#line 2894 "bc.c"
+break;
+case 36:
+#line 511 "bc.y"
+	{
+				yyval.node = 2;
+			}
+#line 2901 "bc.c"
+break;
+case 37:
+#line 515 "bc.y"
+	{
+				if (strcmp(yystack.l_mark[0].astr, "max") != 0) {
+					free(yystack.l_mark[0].astr);
+					warning("reduction must be +, * or max");
+					YYERROR;
+				}
+				free(yystack.l_mark[0].astr);
+				yyval.node = 4;
+			}
+#line 2914 "bc.c"
+break;
+case 38:
+#line 527 "bc.y"
+	{
+				yyval.node = 0;
+			}
+#line 2921 "bc.c"
+break;
+case 39:
+#line 531 "bc.y"
+	{
+				yyval.node = 1;
+			}
+#line 2928 "bc.c"
+break;
+case 40:
+#line 537 "bc.y"
+	{
+				yyval.astr = yystack.l_mark[-1].astr;
+			}
+#line 2935 "bc.c"
+break;
+case 41:
+#line 541 "bc.y"
+	{
+				yyval.astr = yystack.l_mark[0].astr;
+			}
+#line 2942 "bc.c"
+break;
+case 42:
+#line 547 "bc.y"
+	{
+				breaksp--;
+			}
+#line 2949 "bc.c"
+break;
+case 43:
+#line 555 "bc.y"
 	{
-				int n = node(prologue, yystack.l_mark[-1].node, epilogue,
-				    cs("0"), numnode(nesting),
-				    cs("Q"), END_NODE);
+				int n;
+
+				if (native_op != NULL)
+					n = cs(native_op);
+				else
+					n = node(prologue, yystack.l_mark[-1].node, epilogue,
+					    cs("0"), numnode(nesting),
+					    cs("Q"), END_NODE);
 				emit_macro(yystack.l_mark[-8].node, n);
 				reset_macro_char = macro_char;
 				nesting = 0;
 				breaksp = 0;
 			}
-#line 2384 "bc.c"
+#line 2967 "bc.c"
 break;
-case 35:
-#line 394 "bc.y"
+case 44:
+#line 572 "bc.y"
 	{
+				native_op = library_opcode(yystack.l_mark[-1].astr);
 				yyval.node = function_node(yystack.l_mark[-1].astr);
 				free(yystack.l_mark[-1].astr);
 				prologue = cs("");
@@ -2393,305 +2977,311 @@ case 35:
 				breaksp = 0;
 				breakstack[breaksp] = 0;
 			}
-#line 2397 "bc.c"
+#line 2981 "bc.c"
 break;
-case 40:
-#line 416 "bc.y"
+case 49:
+#line 595 "bc.y"
 	{
 				add_par(letter_node(yystack.l_mark[0].astr));
 				free(yystack.l_mark[0].astr);
 			}
-#line 2405 "bc.c"
+#line 2989 "bc.c"
 break;
-case 41:
-#line 421 "bc.y"
+case 50:
+#line 600 "bc.y"
 	{
 				add_par(array_node(yystack.l_mark[-2].astr));
 				free(yystack.l_mark[-2].astr);
 			}
-#line 2413 "bc.c"
+#line 2997 "bc.c"
 break;
-case 42:
-#line 426 "bc.y"
+case 51:
+#line 605 "bc.y"
 	{
 				add_par(letter_node(yystack.l_mark[0].astr));
 				free(yystack.l_mark[0].astr);
 			}
-#line 2421 "bc.c"
+#line 3005 "bc.c"
 break;
-case 43:
-#line 431 "bc.y"
+case 52:
+#line 610 "bc.y"
 	{
 				add_par(array_node(yystack.l_mark[-2].astr));
 				free(yystack.l_mark[-2].astr);
 			}
-#line 2429 "bc.c"
+#line 3013 "bc.c"
 break;
-case 47:
-#line 447 "bc.y"
+case 56:
+#line 626 "bc.y"
 	{
 				add_local(letter_node(yystack.l_mark[0].astr));
 				free(yystack.l_mark[0].astr);
 			}
-#line 2437 "bc.c"
+#line 3021 "bc.c"
 break;
-case 48:
-#line 452 "bc.y"
+case 57:
+#line 631 "bc.y"
 	{
 				add_local(array_node(yystack.l_mark[-2].astr));
 				free(yystack.l_mark[-2].astr);
 			}
-#line 2445 "bc.c"
+#line 3029 "bc.c"
 break;
-case 49:
-#line 457 "bc.y"
+case 58:
+#line 636 "bc.y"
 	{
 				add_local(letter_node(yystack.l_mark[0].astr));
 				free(yystack.l_mark[0].astr);
 			}
-#line 2453 "bc.c"
+#line 3037 "bc.c"
 break;
-case 50:
-#line 462 "bc.y"
+case 59:
+#line 641 "bc.y"
 	{
 				add_local(array_node(yystack.l_mark[-2].astr));
 				free(yystack.l_mark[-2].astr);
 			}
-#line 2461 "bc.c"
+#line 3045 "bc.c"
 break;
-case 51:
-#line 471 "bc.y"
+case 60:
+#line 650 "bc.y"
 	{
 				yyval.node = cs("");
 			}
-#line 2468 "bc.c"
+#line 3052 "bc.c"
 break;
-case 54:
-#line 480 "bc.y"
+case 63:
+#line 659 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, END_NODE);
 			}
-#line 2475 "bc.c"
+#line 3059 "bc.c"
 break;
-case 55:
-#line 484 "bc.y"
+case 64:
+#line 663 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-4].node, cs("l"), array_node(yystack.l_mark[-2].astr),
 				    END_NODE);
 				free(yystack.l_mark[-2].astr);
 			}
-#line 2484 "bc.c"
+#line 3068 "bc.c"
 break;
-case 56:
-#line 493 "bc.y"
+case 65:
+#line 672 "bc.y"
 	{
 				yyval.node = cs(" 0 0=");
 			}
-#line 2491 "bc.c"
+#line 3075 "bc.c"
 break;
-case 58:
-#line 501 "bc.y"
+case 67:
+#line 680 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("="), END_NODE);
 			}
-#line 2498 "bc.c"
+#line 3082 "bc.c"
 break;
-case 59:
-#line 505 "bc.y"
+case 68:
+#line 684 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("!="), END_NODE);
 			}
-#line 2505 "bc.c"
+#line 3089 "bc.c"
 break;
-case 60:
-#line 509 "bc.y"
+case 69:
+#line 688 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs(">"), END_NODE);
 			}
-#line 2512 "bc.c"
+#line 3096 "bc.c"
 break;
-case 61:
-#line 513 "bc.y"
+case 70:
+#line 692 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("!<"), END_NODE);
 			}
-#line 2519 "bc.c"
+#line 3103 "bc.c"
 break;
-case 62:
-#line 517 "bc.y"
+case 71:
+#line 696 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("<"), END_NODE);
 			}
-#line 2526 "bc.c"
+#line 3110 "bc.c"
 break;
-case 63:
-#line 521 "bc.y"
+case 72:
+#line 700 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("!>"), END_NODE);
 			}
-#line 2533 "bc.c"
+#line 3117 "bc.c"
 break;
-case 64:
-#line 525 "bc.y"
+case 73:
+#line 704 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[0].node, cs(" 0!="), END_NODE);
 			}
-#line 2540 "bc.c"
+#line 3124 "bc.c"
 break;
-case 65:
-#line 533 "bc.y"
+case 74:
+#line 712 "bc.y"
 	{
 				yyval.node = node(cs("0"), epilogue,
 				    numnode(nesting), cs("Q"), END_NODE);
 			}
-#line 2548 "bc.c"
+#line 3132 "bc.c"
 break;
-case 66:
-#line 538 "bc.y"
+case 75:
+#line 717 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[0].node, epilogue,
 				    numnode(nesting), cs("Q"), END_NODE);
 			}
-#line 2556 "bc.c"
+#line 3140 "bc.c"
 break;
-case 67:
-#line 543 "bc.y"
+case 76:
+#line 722 "bc.y"
 	{
 				yyval.node = node(cs("0"), epilogue,
 				    numnode(nesting), cs("Q"), END_NODE);
 			}
-#line 2564 "bc.c"
+#line 3148 "bc.c"
 break;
-case 68:
-#line 551 "bc.y"
+case 77:
+#line 730 "bc.y"
 	{
 				yyval.node = cs(" 0");
 			}
-#line 2571 "bc.c"
+#line 3155 "bc.c"
 break;
-case 70:
-#line 558 "bc.y"
+case 79:
+#line 737 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[0].lvalue.load, END_NODE);
+				free(yystack.l_mark[0].lvalue.name);
 			}
-#line 2578 "bc.c"
+#line 3163 "bc.c"
 break;
-case 71:
-#line 561 "bc.y"
+case 80:
+#line 741 "bc.y"
 	{
 				yyval.node = node(cs("l."), END_NODE);
 			}
-#line 2585 "bc.c"
+#line 3170 "bc.c"
 break;
-case 72:
-#line 565 "bc.y"
+case 81:
+#line 745 "bc.y"
 	{
 				yyval.node = node(cs(" "), as(yystack.l_mark[0].str), END_NODE);
 			}
-#line 2592 "bc.c"
+#line 3177 "bc.c"
 break;
-case 73:
-#line 569 "bc.y"
+case 82:
+#line 749 "bc.y"
 	{
 				yyval.node = yystack.l_mark[-1].node;
 			}
-#line 2599 "bc.c"
+#line 3184 "bc.c"
 break;
-case 74:
-#line 573 "bc.y"
+case 83:
+#line 753 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-1].node, cs("l"),
 				    function_node(yystack.l_mark[-3].astr), cs("x"),
 				    END_NODE);
 				free(yystack.l_mark[-3].astr);
 			}
-#line 2609 "bc.c"
+#line 3194 "bc.c"
 break;
-case 75:
-#line 580 "bc.y"
+case 84:
+#line 760 "bc.y"
 	{
 				yyval.node = node(cs(" 0"), yystack.l_mark[0].node, cs("-"),
 				    END_NODE);
 			}
-#line 2617 "bc.c"
+#line 3202 "bc.c"
 break;
-case 76:
-#line 585 "bc.y"
+case 85:
+#line 765 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("+"), END_NODE);
 			}
-#line 2624 "bc.c"
+#line 3209 "bc.c"
 break;
-case 77:
-#line 589 "bc.y"
+case 86:
+#line 769 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("-"), END_NODE);
 			}
-#line 2631 "bc.c"
+#line 3216 "bc.c"
 break;
-case 78:
-#line 593 "bc.y"
+case 87:
+#line 773 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("*"), END_NODE);
 			}
-#line 2638 "bc.c"
+#line 3223 "bc.c"
 break;
-case 79:
-#line 597 "bc.y"
+case 88:
+#line 777 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("/"), END_NODE);
 			}
-#line 2645 "bc.c"
+#line 3230 "bc.c"
 break;
-case 80:
-#line 601 "bc.y"
+case 89:
+#line 781 "bc.y"
 	{
-				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("%"), END_NODE);
+				yyval.node = remainder_node(yystack.l_mark[-2].node, yystack.l_mark[0].node);
 			}
-#line 2652 "bc.c"
+#line 3237 "bc.c"
 break;
-case 81:
-#line 605 "bc.y"
+case 90:
+#line 785 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("^"), END_NODE);
 			}
-#line 2659 "bc.c"
+#line 3244 "bc.c"
 break;
-case 82:
-#line 609 "bc.y"
+case 91:
+#line 789 "bc.y"
 	{
+				par_store(yystack.l_mark[0].lvalue.name);
 				yyval.node = node(yystack.l_mark[0].lvalue.load, cs("1+d"), yystack.l_mark[0].lvalue.store,
 				    END_NODE);
 			}
-#line 2667 "bc.c"
+#line 3253 "bc.c"
 break;
-case 83:
-#line 614 "bc.y"
+case 92:
+#line 795 "bc.y"
 	{
+				par_store(yystack.l_mark[0].lvalue.name);
 				yyval.node = node(yystack.l_mark[0].lvalue.load, cs("1-d"),
 				    yystack.l_mark[0].lvalue.store, END_NODE);
 			}
-#line 2675 "bc.c"
+#line 3262 "bc.c"
 break;
-case 84:
-#line 619 "bc.y"
+case 93:
+#line 801 "bc.y"
 	{
+				par_store(yystack.l_mark[-1].lvalue.name);
 				yyval.node = node(yystack.l_mark[-1].lvalue.load, cs("d1+"),
 				    yystack.l_mark[-1].lvalue.store, END_NODE);
 			}
-#line 2683 "bc.c"
+#line 3271 "bc.c"
 break;
-case 85:
-#line 624 "bc.y"
+case 94:
+#line 807 "bc.y"
 	{
+				par_store(yystack.l_mark[-1].lvalue.name);
 				yyval.node = node(yystack.l_mark[-1].lvalue.load, cs("d1-"),
 				    yystack.l_mark[-1].lvalue.store, END_NODE);
 			}
-#line 2691 "bc.c"
+#line 3280 "bc.c"
 break;
-case 86:
-#line 629 "bc.y"
+case 95:
+#line 813 "bc.y"
 	{
+				par_store(yystack.l_mark[-2].lvalue.name);
 				if (yystack.l_mark[-1].str[0] == '\0')
 					yyval.node = node(yystack.l_mark[0].node, cs(yystack.l_mark[-1].str), cs("d"), yystack.l_mark[-2].lvalue.store,
 					    END_NODE);
@@ -2699,166 +3289,171 @@ case 86:
 					yyval.node = node(yystack.l_mark[-2].lvalue.load, yystack.l_mark[0].node, cs(yystack.l_mark[-1].str), cs("d"),
 					    yystack.l_mark[-2].lvalue.store, END_NODE);
 			}
-#line 2703 "bc.c"
+#line 3293 "bc.c"
 break;
-case 87:
-#line 638 "bc.y"
+case 96:
+#line 823 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-1].node, cs("Z"), END_NODE);
 			}
-#line 2710 "bc.c"
+#line 3300 "bc.c"
 break;
-case 88:
-#line 642 "bc.y"
+case 97:
+#line 827 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-1].node, cs("v"), END_NODE);
 			}
-#line 2717 "bc.c"
+#line 3307 "bc.c"
 break;
-case 89:
-#line 646 "bc.y"
+case 98:
+#line 831 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-1].node, cs("X"), END_NODE);
 			}
-#line 2724 "bc.c"
+#line 3314 "bc.c"
 break;
-case 90:
-#line 650 "bc.y"
+case 99:
+#line 835 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[0].node, cs("N"), END_NODE);
 			}
-#line 2731 "bc.c"
+#line 3321 "bc.c"
 break;
-case 91:
-#line 654 "bc.y"
+case 100:
+#line 839 "bc.y"
 	{
 				ssize_t n = node(cs("R"), yystack.l_mark[0].node, END_NODE);
 				emit_macro(yystack.l_mark[-2].node, n);
 				yyval.node = node(yystack.l_mark[-4].node, cs("d0!="), yystack.l_mark[-2].node, END_NODE);
 			}
-#line 2740 "bc.c"
+#line 3330 "bc.c"
 break;
-case 92:
-#line 660 "bc.y"
+case 101:
+#line 845 "bc.y"
 	{
 				ssize_t n = node(cs("R"), yystack.l_mark[0].node, END_NODE);
 				emit_macro(yystack.l_mark[-2].node, n);
 				yyval.node = node(yystack.l_mark[-4].node, cs("d0="), yystack.l_mark[-2].node, END_NODE);
 			}
-#line 2749 "bc.c"
+#line 3339 "bc.c"
 break;
-case 93:
-#line 666 "bc.y"
+case 102:
+#line 851 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("G"), END_NODE);
 			}
-#line 2756 "bc.c"
+#line 3346 "bc.c"
 break;
-case 94:
-#line 670 "bc.y"
+case 103:
+#line 855 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("GN"), END_NODE);
 			}
-#line 2763 "bc.c"
+#line 3353 "bc.c"
 break;
-case 95:
-#line 674 "bc.y"
+case 104:
+#line 859 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[0].node, yystack.l_mark[-2].node, cs("("), END_NODE);
 			}
-#line 2770 "bc.c"
+#line 3360 "bc.c"
 break;
-case 96:
-#line 678 "bc.y"
+case 105:
+#line 863 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[0].node, yystack.l_mark[-2].node, cs("{"), END_NODE);
 			}
-#line 2777 "bc.c"
+#line 3367 "bc.c"
 break;
-case 97:
-#line 682 "bc.y"
+case 106:
+#line 867 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("("), END_NODE);
 			}
-#line 2784 "bc.c"
+#line 3374 "bc.c"
 break;
-case 98:
-#line 686 "bc.y"
+case 107:
+#line 871 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, cs("{"), END_NODE);
 			}
-#line 2791 "bc.c"
+#line 3381 "bc.c"
 break;
-case 99:
-#line 693 "bc.y"
+case 108:
+#line 878 "bc.y"
 	{
+				yyval.lvalue.name = par_name(yystack.l_mark[0].astr, "");
 				yyval.lvalue.load = node(cs("l"), letter_node(yystack.l_mark[0].astr),
 				    END_NODE);
 				yyval.lvalue.store = node(cs("s"), letter_node(yystack.l_mark[0].astr),
 				    END_NODE);
 				free(yystack.l_mark[0].astr);
 			}
-#line 2802 "bc.c"
+#line 3393 "bc.c"
 break;
-case 100:
-#line 701 "bc.y"
+case 109:
+#line 887 "bc.y"
 	{
+				yyval.lvalue.name = par_name(yystack.l_mark[-3].astr, "[]");
 				yyval.lvalue.load = node(yystack.l_mark[-1].node, cs(";"),
 				    array_node(yystack.l_mark[-3].astr), END_NODE);
 				yyval.lvalue.store = node(yystack.l_mark[-1].node, cs(":"),
 				    array_node(yystack.l_mark[-3].astr), END_NODE);
 				free(yystack.l_mark[-3].astr);
 			}
-#line 2813 "bc.c"
+#line 3405 "bc.c"
 break;
-case 101:
-#line 709 "bc.y"
+case 110:
+#line 896 "bc.y"
 	{
 				yyval.lvalue.load = cs("K");
 				yyval.lvalue.store = cs("k");
+				yyval.lvalue.name = NULL;
 			}
-#line 2821 "bc.c"
+#line 3414 "bc.c"
 break;
-case 102:
-#line 714 "bc.y"
+case 111:
+#line 902 "bc.y"
 	{
 				yyval.lvalue.load = cs("I");
 				yyval.lvalue.store = cs("i");
+				yyval.lvalue.name = NULL;
 			}
-#line 2829 "bc.c"
+#line 3423 "bc.c"
 break;
-case 103:
-#line 719 "bc.y"
+case 112:
+#line 908 "bc.y"
 	{
 				yyval.lvalue.load = cs("O");
 				yyval.lvalue.store = cs("o");
+				yyval.lvalue.name = NULL;
 			}
-#line 2837 "bc.c"
+#line 3432 "bc.c"
 break;
-case 105:
-#line 728 "bc.y"
+case 114:
+#line 918 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[-2].node, yystack.l_mark[0].node, END_NODE);
 			}
-#line 2844 "bc.c"
+#line 3439 "bc.c"
 break;
-case 106:
-#line 734 "bc.y"
+case 115:
+#line 924 "bc.y"
 	{
 				yyval.node = node(yystack.l_mark[0].node, cs("ds.n"), END_NODE);
 			}
-#line 2851 "bc.c"
+#line 3446 "bc.c"
 break;
-case 107:
-#line 738 "bc.y"
+case 116:
+#line 928 "bc.y"
 	{
 				char *p = escape(yystack.l_mark[0].str);
 				yyval.node = node(cs("["), as(p), cs("]n"), END_NODE);
 				free(p);
 			}
-#line 2860 "bc.c"
+#line 3455 "bc.c"
 break;
-#line 2862 "bc.c"
+#line 3457 "bc.c"
     default:
         break;
     }
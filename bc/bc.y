@@ -38,7 +38,6 @@
 #include <errno.h>
 #include <histedit.h>
 #include <limits.h>
-#include <search.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <string.h>
@@ -68,6 +67,7 @@ int			sargc;
 char			**sargv;
 char			*filename;
 char			*cmdexpr;
+bool			in_process = false;
 
 static void		grow(void);
 static ssize_t		cs(const char *);
@@ -75,16 +75,30 @@ static ssize_t		as(const char *);
 static ssize_t		node(ssize_t, ...);
 static void		emit(ssize_t, int);
 static void		emit_macro(int, ssize_t);
+static void		output(const char *);
+static void		flush_output(void);
 static void		free_tree(void);
 static ssize_t		numnode(int);
+static ssize_t		new_macro(bool);
+static bool		in_parallel(void);
+static char		*par_name(const char *, const char *);
+static void		par_store(char *);
+static void		par_end(const char *, const char *);
+static struct symbol	*symtab_slot(struct symbol *, size_t, const char *);
+static void		symtab_grow(void);
 static ssize_t		lookup(char *, size_t, char);
 static ssize_t		letter_node(char *);
 static ssize_t		array_node(char *);
 static ssize_t		function_node(char *);
+static const char	*library_opcode(const char *);
+static bool		binary_node(ssize_t, const char *, ssize_t *,
+			    ssize_t *);
+static ssize_t		remainder_node(ssize_t, ssize_t);
 
 static void		add_par(ssize_t);
 static void		add_local(ssize_t);
 static void		warning(const char *);
+static void		print_error(const char *);
 static void		init(void);
 static void		usage(void);
 static char		*escape(const char *);
@@ -96,18 +110,58 @@ static int		macro_char = '0';
 static int		reset_macro_char = '0';
 static int		nesting = 0;
 static int		breakstack[16];
+static bool		breakpar[16];	/* the loop is a parallel for */
 static int		breaksp = 0;
+/* Variables written in the bodies of the parallel fors being compiled */
+static struct par_store {
+	char		*name;
+	int		level;		/* in breakstack, of the loop */
+}			*par_stores;
+static size_t		par_nstores;
 static ssize_t		prologue;
 static ssize_t		epilogue;
 static bool		st_has_continue;
 static char		str_table[UCHAR_MAX][2];
 static bool		do_fork = true;
+static char		*outbuf;
+static size_t		outbuf_len;
+static size_t		outbuf_sz;
 static u_short		var_count;
+/* Names of the variables, arrays and functions, and their registers */
+static struct symbol {
+	char		*name;
+	char		*reg;
+}			*symtab;
+static size_t		symtab_sz;
 static pid_t		dc;
+static bool		own_dc;
+static bool		native_lib = false;
+/* -b: each input item on stdin is a job run from the state before it */
+static bool		batch = false;
+static bool		batch_started;
+/* -j: threads for batch jobs, and dc's worker machines for parallel for */
+static long		threads = 0;
+/* -a: the largest array index, -1 for dc's default */
+static long		array_max = -1;
+static const char	*native_op;
+
+/* The functions of the math library dc has built in */
+static const struct {
+	const char	*name;
+	const char	*opcode;
+} library[] = {
+	{ "e",	"H" },
+	{ "l",	"T" },
+	{ "s",	"U" },
+	{ "c",	"V" },
+	{ "a",	"W" },
+	{ "j",	"Y" }
+};
 
 extern char *__progname;
 
 #define BREAKSTACK_SZ	(sizeof(breakstack)/sizeof(breakstack[0]))
+#define LIBRARY_SZ	(sizeof(library)/sizeof(library[0]))
 
 /* These values are 4.4BSD bc compatible */
 #define FUNC_CHAR	0x01
@@ -117,6 +171,7 @@ extern char *__progname;
 #define ENCODE(c)	((c) < '[' ? (c) : (c) + 3);
 #define VAR_BASE	(256-4)
 #define MAX_VARIABLES	(VAR_BASE * VAR_BASE)
+#define SYMTAB_MIN	64	/* grown by doubling when half full */
 
 %}
 
@@ -152,6 +207,7 @@ extern char *__progname;
 %type <lvalue>	named_expression
 %type <node>	argument_list
 %type <node>	alloc_macro
+%type <node>	alloc_parallel
 %type <node>	expression
 %type <node>	function
 %type <node>	function_header
@@ -160,6 +216,9 @@ extern char *__progname;
 %type <node>	opt_expression
 %type <node>	opt_relational_expression
 %type <node>	opt_statement
+%type <node>	par_operator
+%type <node>	par_relation
+%type <astr>	par_step
 %type <node>	print_expression
 %type <node>	print_expression_list
 %type <node>	relational_expression
@@ -178,13 +237,17 @@ input_item	: semicolon_list NEWLINE
 			{
 				emit($1, 0);
 				macro_char = reset_macro_char;
-				putchar('\n');
+				output("\n");
+				flush_output();
 				free_tree();
 				st_has_continue = false;
 			}
 		| function
 			{
-				putchar('\n');
+				output("\n");
+				/* In a batch, the rest of its last line joins it */
+				if (!batch || yyin != stdin)
+					flush_output();
 				free_tree();
 				st_has_continue = false;
 			}
@@ -241,6 +304,7 @@ statement	: expression
 			}
 		| named_expression ASSIGN_OP expression
 			{
+				par_store($1.name);
 				if ($2[0] == '\0')
 					$$ = node($3, cs($2), $1.store,
 					    END_NODE);
@@ -258,6 +322,9 @@ statement	: expression
 				if (breaksp == 0) {
 					warning("break not in for or while");
 					YYERROR;
+				} else if (breakpar[breaksp-1]) {
+					warning("break in parallel for");
+					YYERROR;
 				} else {
 					$$ = node(
 					    numnode(nesting -
@@ -270,6 +337,9 @@ statement	: expression
 				if (breaksp == 0) {
 					warning("continue not in for or while");
 					YYERROR;
+				} else if (breakpar[breaksp-1]) {
+					warning("continue in parallel for");
+					YYERROR;
 				} else {
 					st_has_continue = true;
 					$$ = node(numnode(nesting -
@@ -281,8 +351,15 @@ statement	: expression
 			{
 				sigset_t mask;
 
-				putchar('q');
-				fflush(stdout);
+				if (batch) {
+					/* A function ending the input is held */
+					flush_output();
+					if (batch_started)
+						dc_batch_end();
+					exit(0);
+				}
+				output("q");
+				flush_output();
 				if (dc) {
 					sigprocmask(SIG_BLOCK, NULL, &mask);
 					sigsuspend(&mask);
@@ -295,6 +372,10 @@ statement	: expression
 					warning("return must be in a function");
 					YYERROR;
 				}
+				if (in_parallel()) {
+					warning("return in parallel for");
+					YYERROR;
+				}
 				$$ = $2;
 			}
 		| FOR LPAR alloc_macro opt_expression SEMICOLON
@@ -314,6 +395,66 @@ statement	: expression
 				$$ = node($4, cs("s."), $6, $3, cs(" "),
 				    END_NODE);
 			}
+		| LETTER LPAR par_operator LETTER RPAR FOR LPAR alloc_parallel
+		      LETTER ASSIGN_OP expression SEMICOLON
+		      LETTER par_relation expression SEMICOLON
+		      par_step RPAR opt_statement pop_nesting
+			{
+				ssize_t	s, init;
+				int	mode;
+				const char *msg = NULL;
+
+				/*
+				 * "parallel" is not a keyword, so that it stays
+				 * usable as a name.  The arguments of a call
+				 * cannot start with + or *, or with two names.
+				 */
+				if (strcmp($1, "parallel") != 0)
+					msg = "syntax error";
+				else if ($10[0] != '\0' ||
+				    strcmp($9, $13) != 0 ||
+				    strcmp($9, $17) != 0)
+					msg = "parallel for must have the form "
+					    "for (i = a; i < b; i++)";
+				free($1);
+				if (msg != NULL) {
+					par_end(NULL, NULL);
+					free($4);
+					free($9);
+					free($13);
+					free($17);
+					nesting--;
+					warning(msg);
+					YYERROR;
+				}
+				par_end($4, $9);
+				/*
+				 * dc runs the body for each index from a on,
+				 * in chunks, on machines with their own copies
+				 * of the variables.  Each chunk starts its
+				 * partial result from init; & combines them
+				 * and leaves the index after the last on top.
+				 * The bound is evaluated once.
+				 */
+				emit_macro($8, node(cs("s"), letter_node($9), $19,
+				    END_NODE));
+				s = letter_node($4);
+				mode = $3 + $14;
+				if ($3 == 0)
+					init = node(cs("[0s"), s, cs("]"), END_NODE);
+				else if ($3 == 2)
+					init = node(cs("[1s"), s, cs("]"), END_NODE);
+				else
+					init = cs("[]");
+				$$ = node(cs("l"), s, $11, cs(" "), $15,
+				    numnode(mode), init, cs("l"), $8, cs("[l"), s,
+				    cs("]&s"), letter_node($9), cs("s"), s, cs(" "),
+				    END_NODE);
+				free($4);
+				free($9);
+				free($13);
+				free($17);
+			}
 		| IF LPAR alloc_macro pop_nesting relational_expression RPAR
 		      opt_statement
 			{
@@ -352,21 +493,53 @@ statement	: expression
 
 alloc_macro	: /* empty */
 			{
-				$$ = cs(str_table[macro_char]);
-				macro_char++;
-				/* Do not use [, \ and ] */
-				if (macro_char == '[')
-					macro_char += 3;
-				/* skip letters */
-				else if (macro_char == 'a')
-					macro_char = '{';
-				else if (macro_char == ARRAY_CHAR)
-					macro_char += 26;
-				else if (macro_char == 255)
-					fatal("program too big");
-				if (breaksp == BREAKSTACK_SZ)
-					fatal("nesting too deep");
-				breakstack[breaksp++] = nesting++;
+				$$ = new_macro(false);
+			}
+		;
+
+alloc_parallel	: /* empty */
+			{
+				$$ = new_macro(true);
+			}
+		;
+
+par_operator	: PLUS
+			{
+				$$ = 0;
+			}
+		| MULTIPLY
+			{
+				$$ = 2;
+			}
+		| LETTER
+			{
+				if (strcmp($1, "max") != 0) {
+					free($1);
+					warning("reduction must be +, * or max");
+					YYERROR;
+				}
+				free($1);
+				$$ = 4;
+			}
+		;
+
+par_relation	: LESS
+			{
+				$$ = 0;
+			}
+		| LESS_EQ
+			{
+				$$ = 1;
+			}
+		;
+
+par_step	: LETTER INCR
+			{
+				$$ = $1;
+			}
+		| INCR LETTER
+			{
+				$$ = $2;
 			}
 		;
 
@@ -380,9 +553,14 @@ function	: function_header opt_parameter_list RPAR opt_newline
 		  LBRACE NEWLINE opt_auto_define_list
 		  statement_list RBRACE
 			{
-				int n = node(prologue, $8, epilogue,
-				    cs("0"), numnode(nesting),
-				    cs("Q"), END_NODE);
+				int n;
+
+				if (native_op != NULL)
+					n = cs(native_op);
+				else
+					n = node(prologue, $8, epilogue,
+					    cs("0"), numnode(nesting),
+					    cs("Q"), END_NODE);
 				emit_macro($1, n);
 				reset_macro_char = macro_char;
 				nesting = 0;
@@ -392,6 +570,7 @@ function	: function_header opt_parameter_list RPAR opt_newline
 
 function_header : DEFINE LETTER LPAR
 			{
+				native_op = library_opcode($2);
 				$$ = function_node($2);
 				free($2);
 				prologue = cs("");
@@ -557,6 +736,7 @@ opt_expression : /* empty */
 expression	: named_expression
 			{
 				$$ = node($1.load, END_NODE);
+				free($1.name);
 			}
 		| DOT	{
 				$$ = node(cs("l."), END_NODE);
@@ -599,7 +779,7 @@ expression	: named_expression
 			}
 		| expression REMAINDER expression
 			{
-				$$ = node($1, $3, cs("%"), END_NODE);
+				$$ = remainder_node($1, $3);
 			}
 		| expression EXPONENT expression
 			{
@@ -607,26 +787,31 @@ expression	: named_expression
 			}
 		| INCR named_expression
 			{
+				par_store($2.name);
 				$$ = node($2.load, cs("1+d"), $2.store,
 				    END_NODE);
 			}
 		| DECR named_expression
 			{
+				par_store($2.name);
 				$$ = node($2.load, cs("1-d"),
 				    $2.store, END_NODE);
 			}
 		| named_expression INCR
 			{
+				par_store($1.name);
 				$$ = node($1.load, cs("d1+"),
 				    $1.store, END_NODE);
 			}
 		| named_expression DECR
 			{
+				par_store($1.name);
 				$$ = node($1.load, cs("d1-"),
 				    $1.store, END_NODE);
 			}
 		| named_expression ASSIGN_OP expression
 			{
+				par_store($1.name);
 				if ($2[0] == '\0')
 					$$ = node($3, cs($2), cs("d"), $1.store,
 					    END_NODE);
@@ -691,6 +876,7 @@ expression	: named_expression
 named_expression
 		: LETTER
 			{
+				$$.name = par_name($1, "");
 				$$.load = node(cs("l"), letter_node($1),
 				    END_NODE);
 				$$.store = node(cs("s"), letter_node($1),
@@ -699,6 +885,7 @@ named_expression
 			}
 		| LETTER LBRACKET expression RBRACKET
 			{
+				$$.name = par_name($1, "[]");
 				$$.load = node($3, cs(";"),
 				    array_node($1), END_NODE);
 				$$.store = node($3, cs(":"),
@@ -709,16 +896,19 @@ named_expression
 			{
 				$$.load = cs("K");
 				$$.store = cs("k");
+				$$.name = NULL;
 			}
 		| IBASE
 			{
 				$$.load = cs("I");
 				$$.store = cs("i");
+				$$.name = NULL;
 			}
 		| OBASE
 			{
 				$$.load = cs("O");
 				$$.store = cs("o");
+				$$.name = NULL;
 			}
 		;
 
@@ -815,18 +1005,75 @@ emit(ssize_t i, int level)
 			i++;
 		}
 	} else if (instructions[i].index != END_NODE)
-		fputs(instructions[i].u.cstr, stdout);
+		output(instructions[i].u.cstr);
 }
 
 static void
 emit_macro(int node, ssize_t code)
 {
-	putchar('[');
+	output("[");
 	emit(code, 0);
-	printf("]s%s\n", instructions[node].u.cstr);
+	output("]s");
+	output(instructions[node].u.cstr);
+	output("\n");
 	nesting--;
 }
 
+/*
+ * Generated code is collected and, at the end of each input item,
+ * written to stdout in one go, which is the pipe to dc when forked.
+ * When running dc in-process it is handed to dc_eval() instead.
+ */
+static void
+output(const char *str)
+{
+	size_t	len, newsize;
+	char	*p;
+
+	len = strlen(str);
+	if (outbuf_len + len >= outbuf_sz) {
+		newsize = outbuf_sz * 2 + len + 1;
+		p = realloc(outbuf, newsize);
+		if (p == NULL)
+			err(1, NULL);
+		outbuf_sz = newsize;
+		outbuf = p;
+	}
+	memcpy(outbuf + outbuf_len, str, len + 1);
+	outbuf_len += len;
+}
+
+static void
+flush_output(void)
+{
+	char	*p;
+	ssize_t	n;
+
+	if (outbuf_len == 0)
+		return;
+	if (in_process) {
+		outbuf_len = 0;
+		/* In a batch, every input item read from stdin is a job */
+		if (batch && yyin == stdin) {
+			if (!batch_started) {
+				dc_batch_init(threads > 0 ? threads : 1);
+				batch_started = true;
+			}
+			dc_batch_eval(outbuf);
+		} else
+			dc_eval(outbuf);
+		return;
+	}
+	for (p = outbuf; outbuf_len > 0; p += n, outbuf_len -= n) {
+		n = write(STDOUT_FILENO, p, outbuf_len);
+		if (n == -1) {
+			if (errno != EINTR)
+				err(1, "write");
+			n = 0;
+		}
+	}
+}
+
 static void
 free_tree(void)
 {
@@ -838,6 +1085,116 @@ free_tree(void)
 	current = 0;
 }
 
+static ssize_t
+new_macro(bool parallel)
+{
+	ssize_t ret;
+
+	ret = cs(str_table[macro_char]);
+	macro_char++;
+	/* Do not use [, \ and ] */
+	if (macro_char == '[')
+		macro_char += 3;
+	/* skip letters */
+	else if (macro_char == 'a')
+		macro_char = '{';
+	else if (macro_char == ARRAY_CHAR)
+		macro_char += 26;
+	else if (macro_char == 255)
+		fatal("program too big");
+	if (breaksp == BREAKSTACK_SZ)
+		fatal("nesting too deep");
+	breakpar[breaksp] = parallel;
+	breakstack[breaksp++] = nesting++;
+	return ret;
+}
+
+/* Whether the code being compiled runs in the body of a parallel for */
+static bool
+in_parallel(void)
+{
+	int i;
+
+	for (i = 0; i < breaksp; i++)
+		if (breakpar[i])
+			return true;
+	return false;
+}
+
+/* The name of a variable being used, for par_store(), if it may be */
+static char *
+par_name(const char *name, const char *suffix)
+{
+	char *p;
+
+	if (!in_parallel())
+		return NULL;
+	if (asprintf(&p, "%s%s", name, suffix) == -1)
+		err(1, NULL);
+	return p;
+}
+
+/* Note that the variable name is written, in the innermost parallel for */
+static void
+par_store(char *name)
+{
+	struct par_store	*p;
+	int			level;
+
+	if (name == NULL)
+		return;
+	for (level = breaksp - 1; !breakpar[level]; level--)
+		continue;
+	p = reallocarray(par_stores, par_nstores + 1, sizeof(*p));
+	if (p == NULL)
+		err(1, NULL);
+	par_stores = p;
+	par_stores[par_nstores].name = name;
+	par_stores[par_nstores++].level = level;
+}
+
+/*
+ * At the end of the parallel for with the reduction variable s and the
+ * index i, warn of the other variables its body writes: each chunk of
+ * the loop has its own copy of them, and they are not kept after it.
+ * Not in a batch, where a warning would take the place of a job.  Both
+ * s and i are written in the body of an outer parallel for.  With s
+ * NULL, forget the loop.
+ */
+static void
+par_end(const char *s, const char *i)
+{
+	char	*msg;
+	size_t	first, j, k;
+
+	for (first = par_nstores; first > 0 &&
+	    par_stores[first - 1].level >= breaksp; first--)
+		continue;
+	for (j = first; j < par_nstores; j++) {
+		if (s == NULL || batch || strcmp(par_stores[j].name, s) == 0)
+			continue;
+		for (k = first; k < j; k++)
+			if (strcmp(par_stores[k].name,
+			    par_stores[j].name) == 0)
+				break;
+		if (k < j)
+			continue;
+		if (asprintf(&msg, "%s is set in a parallel for, so not "
+		    "shared by its chunks or kept after it",
+		    par_stores[j].name) == -1)
+			err(1, NULL);
+		warning(msg);
+		free(msg);
+	}
+	for (j = first; j < par_nstores; j++)
+		free(par_stores[j].name);
+	par_nstores = first;
+	if (s != NULL) {
+		par_store(par_name(s, ""));
+		par_store(par_name(i, ""));
+	}
+}
+
 static ssize_t
 numnode(int num)
 {
@@ -853,23 +1210,59 @@ numnode(int num)
 }
 
 
+/* The slot of name in a symbol table of size sz, a power of two */
+static struct symbol *
+symtab_slot(struct symbol *tab, size_t sz, const char *name)
+{
+	const u_char	*p;
+	size_t		h = 2166136261U;
+
+	for (p = (const u_char *)name; *p != '\0'; p++)
+		h = (h ^ *p) * 16777619U;
+	for (h &= sz - 1; tab[h].name != NULL; h = (h + 1) & (sz - 1))
+		if (strcmp(tab[h].name, name) == 0)
+			break;
+	return &tab[h];
+}
+
+static void
+symtab_grow(void)
+{
+	struct symbol	*tab;
+	size_t		i, sz;
+
+	sz = symtab_sz == 0 ? SYMTAB_MIN : symtab_sz * 2;
+	tab = calloc(sz, sizeof(*tab));
+	if (tab == NULL)
+		err(1, NULL);
+	for (i = 0; i < symtab_sz; i++)
+		if (symtab[i].name != NULL)
+			*symtab_slot(tab, sz, symtab[i].name) = symtab[i];
+	free(symtab);
+	symtab = tab;
+	symtab_sz = sz;
+}
+
 static ssize_t
 lookup(char * str, size_t len, char type)
 {
-	ENTRY	entry, *found;
-	u_short	num;
-	u_char	*p;
+	struct symbol	*sym;
+	u_short		num;
+	u_char		*p;
 
 	/* The scanner allocated an extra byte already */
 	if (str[len-1] != type) {
 		str[len] = type;
 		str[len+1] = '\0';
 	}
-	entry.key = str;
-	found = hsearch(entry, FIND);
-	if (found == NULL) {
+	sym = symtab_slot(symtab, symtab_sz, str);
+	if (sym->name == NULL) {
 		if (var_count == MAX_VARIABLES)
 			errx(1, "too many variables");
+		if (2 * (var_count + 1) > symtab_sz) {
+			symtab_grow();
+			sym = symtab_slot(symtab, symtab_sz, str);
+		}
 		p = malloc(4);
 		if (p == NULL)
 			err(1, NULL);
@@ -879,15 +1272,12 @@ lookup(char * str, size_t len, char type)
 		p[2] = ENCODE(num % VAR_BASE + 1);
 		p[3] = '\0';
 
-		entry.data = (char *)p;
-		entry.key = strdup(str);
-		if (entry.key == NULL)
-			err(1, NULL);
-		found = hsearch(entry, ENTER);
-		if (found == NULL)
+		sym->reg = (char *)p;
+		sym->name = strdup(str);
+		if (sym->name == NULL)
 			err(1, NULL);
 	}
-	return cs(found->data);
+	return cs(sym->reg);
 }
 
 static ssize_t
@@ -926,6 +1316,61 @@ function_node(char *str)
 		return lookup(str, len, 'F');
 }
 
+/*
+ * The opcode that replaces the body of a function of the math library,
+ * or NULL.  The functions stay in their registers, so that a program
+ * can still redefine them.
+ */
+static const char *
+library_opcode(const char *name)
+{
+	size_t	i;
+
+	if (!native_lib || strcmp(filename, _PATH_LIBB) != 0)
+		return NULL;
+	for (i = 0; i < LIBRARY_SZ; i++)
+		if (strcmp(name, library[i].name) == 0)
+			return library[i].opcode;
+	return NULL;
+}
+
+/* Whether n is node(l, r, cs(op), END_NODE) */
+static bool
+binary_node(ssize_t n, const char *op, ssize_t *l, ssize_t *r)
+{
+	ssize_t	o;
+
+	if (instructions[n].index < 0 || n + 3 >= current ||
+	    instructions[n + 3].index != END_NODE)
+		return false;
+	o = instructions[n + 2].index;
+	if (o < 0 || instructions[o].index != CONST_STRING ||
+	    strcmp(instructions[o].u.cstr, op) != 0)
+		return false;
+	*l = instructions[n].index;
+	*r = instructions[n + 1].index;
+	return true;
+}
+
+/*
+ * a % m, with a^b % m and a*b + c % m done by dc in one step.  The
+ * operands are evaluated in the same order either way.
+ */
+static ssize_t
+remainder_node(ssize_t n, ssize_t m)
+{
+	ssize_t	a, b, c, ab;
+
+	if (own_dc) {
+		if (binary_node(n, "^", &a, &b))
+			return node(a, b, m, cs("|"), END_NODE);
+		if (binary_node(n, "+", &ab, &c) &&
+		    binary_node(ab, "*", &a, &b))
+			return node(a, b, c, m, cs("m"), END_NODE);
+	}
+	return node(n, m, cs("%"), END_NODE);
+}
+
 static void
 add_par(ssize_t n)
 {
@@ -943,7 +1388,7 @@ add_local(ssize_t n)
 void
 yyerror(char *s)
 {
-	char	*str, *p;
+	char	*str;
 	int	n;
 
 	if (yyin != NULL && feof(yyin))
@@ -963,15 +1408,27 @@ yyerror(char *s)
 		    __progname, filename, lineno, s, yytext);
 	if (n == -1)
 		err(1, NULL);
+	print_error(str);
+	free(str);
+}
+
+/* Have dc print the message, so that it comes in order with its output */
+static void
+print_error(const char *str)
+{
+	const char	*p;
+	char		c[2];
 
-	fputs("c[", stdout);
+	output("c[");
 	for (p = str; *p != '\0'; p++) {
 		if (*p == '[' || *p == ']' || *p =='\\')
-			putchar('\\');
-		putchar(*p);
+			output("\\");
+		c[0] = *p;
+		c[1] = '\0';
+		output(c);
 	}
-	fputs("]ec\n", stdout);
-	free(str);
+	output("]ec\n");
+	flush_output();
 }
 
 void
@@ -983,7 +1440,17 @@ fatal(const char *s)
 static void
 warning(const char *s)
 {
-	warnx("%s:%d: %s", filename, lineno, s);
+	char	*str;
+
+	/* A batch job must get its error line */
+	if (batch && yyin == stdin) {
+		if (asprintf(&str, "%s: %s:%d: %s", __progname, filename,
+		    lineno, s) == -1)
+			err(1, NULL);
+		print_error(str);
+		free(str);
+	} else
+		warnx("%s:%d: %s", filename, lineno, s);
 }
 
 static void
@@ -995,15 +1462,15 @@ init(void)
 		str_table[i][0] = i;
 		str_table[i][1] = '\0';
 	}
-	if (hcreate(1 << 16) == 0)
-		err(1, NULL);
+	symtab_grow();
 }
 
 
 static void
 usage(void)
 {
-	fprintf(stderr, "usage: %s [-cl] [-e expression] [file ...]\n",
+	fprintf(stderr,
+	    "usage: %s [-bclp] [-a index] [-e expression] [-j threads] [file ...]\n",
 	    __progname);
 	exit(1);
 }
@@ -1113,11 +1580,23 @@ main(int argc, char *argv[])
 	if ((cmdexpr = strdup("")) == NULL)
 		err(1, NULL);
 	/* The d debug option is 4.4 BSD bc(1) compatible */
-	while ((ch = getopt(argc, argv, "cde:l")) != -1) {
+	while ((ch = getopt(argc, argv, "a:bcde:j:lp")) != -1) {
 		switch (ch) {
+		case 'a':
+			array_max = strtol(optarg, &q, 10);
+			if (optarg[0] == '\0' || *q != '\0' || array_max < 0 ||
+			    array_max == LONG_MAX)
+				errx(1, "invalid array index: %s", optarg);
+			break;
+		case 'b':
+			batch = true;
+			do_fork = false;
+			in_process = true;
+			break;
 		case 'c':
 		case 'd':
 			do_fork = false;
+			in_process = false;
 			break;
 		case 'e':
 			q = cmdexpr;
@@ -1125,8 +1604,19 @@ main(int argc, char *argv[])
 				err(1, NULL);
 			free(q);
 			break;
+		case 'j':
+			threads = strtol(optarg, &q, 10);
+			if (optarg[0] == '\0' || *q != '\0' ||
+			    threads < 1 || threads > MAX_THREADS)
+				errx(1, "invalid number of threads: %s", optarg);
+			break;
 		case 'l':
 			sargv[sargc++] = _PATH_LIBB;
+			native_lib = true;
+			break;
+		case 'p':
+			do_fork = false;
+			in_process = true;
 			break;
 		default:
 			usage();
@@ -1154,17 +1644,41 @@ main(int argc, char *argv[])
 			close(p[0]);
 			close(p[1]);
 		} else {
-			char *dc_argv[] = { "dc", "-x", NULL };
+			char *dc_argv[] = { "dc", "-x", NULL, NULL, NULL, NULL,
+			    NULL };
 			extern int dc_main(int, char **);
+			int dc_argc = 2;
+			char jbuf[24], abuf[24];
 
 			close(STDIN_FILENO);
 			dup(p[0]);
 			close(p[0]);
 			close(p[1]);
 
-			exit (dc_main(2, dc_argv));
+			if (threads > 0) {
+				(void)snprintf(jbuf, sizeof(jbuf), "%ld",
+				    threads);
+				dc_argv[dc_argc++] = "-j";
+				dc_argv[dc_argc++] = jbuf;
+			}
+			if (array_max >= 0) {
+				(void)snprintf(abuf, sizeof(abuf), "%ld",
+				    array_max);
+				dc_argv[dc_argc++] = "-a";
+				dc_argv[dc_argc++] = abuf;
+			}
+			exit (dc_main(dc_argc, dc_argv));
 		}
+	} else if (in_process) {
+		dc_init();
+		dc_threads(threads);
+		if (array_max >= 0)
+			dc_array_max(array_max);
 	}
+	/* Code printed with -c is not bound to this dc */
+	own_dc = do_fork || in_process;
+	batch = batch && in_process;
+	native_lib = native_lib && own_dc && dc_native_library();
 	if (interactive) {
 		gettty(&ttysaved);
 		el = el_init("bc", stdin, stderr, stderr);
@@ -1180,5 +1694,8 @@ main(int argc, char *argv[])
 	}
 
 	yywrap();
-	return yyparse();
+	i = yyparse();
+	if (batch_started)
+		dc_batch_end();
+	return i;
 }
@@ -22,6 +22,7 @@
 struct lvalue {
 	ssize_t load;
 	ssize_t store;
+	char	*name;		/* in the body of a parallel for */
 };
 
 int		yylex(void);
@@ -33,6 +34,18 @@ int		gettty(struct termios *);
 void		tstpcont(int);
 unsigned char	bc_eof(EditLine *, int);
 
+/* dc, when run in-process */
+#define MAX_THREADS	1024	/* most that -j takes */
+void		dc_init(void);
+void		dc_eval(char *);
+void		dc_threads(int);
+void		dc_array_max(long);
+void		dc_batch_init(int);
+void		dc_batch_eval(char *);
+void		dc_batch_end(void);
+void		dc_interrupt(void);
+bool		dc_native_library(void);
+
 extern int	lineno;
 extern char	*yytext;
 extern FILE	*yyin;
@@ -41,6 +54,7 @@ extern int	sargc;
 extern char	**sargv;
 extern char	*filename;
 extern bool	interactive;
+extern bool	in_process;
 extern EditLine	*el;
 extern History	*hist;
 extern HistEvent he;
@@ -2356,17 +2356,23 @@ abort_line(int sig)
 	(void) sig;
 	static const char str1[] = "[\n]P\n";
 	static const char str2[] = "[^C\n]P\n";
+	const char *str;
 	int save_errno;
 	const LineInfo *info;
 
 	save_errno = errno;
+	str = use_el ? str2 : str1;
 	if (use_el) {
-		write(STDOUT_FILENO, str2, sizeof(str2) - 1);
 		/* XXX signal race */
 		info = el_line(el);
 		skipchars = info->lastchar - info->buffer;
+	}
+	if (in_process) {
+		/* No dc on the other end of stdout, print the text directly */
+		write(STDOUT_FILENO, str + 1, strlen(str) - 4);
+		dc_interrupt();
 	} else
-		write(STDOUT_FILENO, str1, sizeof(str1) - 1);
+		write(STDOUT_FILENO, str, strlen(str));
 	errno = save_errno;
 }
 
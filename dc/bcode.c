@@ -17,8 +17,10 @@
  */
 
 #include <err.h>
+#include <errno.h>
 #include <limits.h>
 #include <signal.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -27,12 +29,13 @@
 
 /* #define	DEBUGGING */
 
-#define MAX_ARRAY_INDEX		2048
+#define MAX_ARRAY_INDEX		2048	/* unless set with -a */
 #define READSTACK_SIZE		8
 
 #define NO_ELSE			-2	/* -1 is EOF */
 #define REG_ARRAY_SIZE_SMALL	(UCHAR_MAX + 1)
 #define REG_ARRAY_SIZE_BIG	(UCHAR_MAX + 1 + USHRT_MAX + 1)
+#define PAR_CHUNKS		256	/* most chunks a parallel loop is cut in */
 
 struct bmachine {
 	struct stack		stack;
@@ -47,15 +50,68 @@ struct bmachine {
 	struct source		*readstack;
 	size_t			readstack_sz;
 	BN_CTX			*ctx;
+	FILE			*out;
+	FILE			*err;
 };
 
 static struct bmachine	bmachine;
+static u_long		max_array_index = MAX_ARRAY_INDEX;
+
+extern char		*__progname;
+
+/*
+ * The state batch jobs start from, and the registers written since.
+ * Registers that were not empty at the mark are kept sorted by index.
+ */
+struct saved_reg {
+	int			idx;
+	struct stack		stack;
+};
+
+static struct {
+	bool			marked;
+	struct stack		stack;
+	u_int			scale;
+	u_int			obase;
+	u_int			ibase;
+	struct saved_reg	*saved;
+	size_t			nsaved;
+	bool			*dirty;
+	int			*touched;
+	size_t			ntouched;
+	size_t			touched_sz;
+} baseline;
+
+/*
+ * Registers written by the chunks of a parallel loop, with what they
+ * held before, so that as in the GMP dc, a chunk leaves none of its
+ * writes behind.  Only the innermost loop saves a register: an inner
+ * loop puts back what it writes.
+ */
+struct undo_reg {
+	int			idx;
+	u_int			level;		/* of the save before this one */
+	struct stack		stack;
+};
+
+static struct {
+	u_int			depth;		/* of chunks running */
+	u_int			*level;		/* the depth each is saved for */
+	struct undo_reg		*saved;
+	size_t			nsaved;
+	size_t			size;
+} undo;
 static void sighandler(int);
 
 static __inline int	readch(void);
 static __inline void	unreadch(void);
 static __inline char	*readline(void);
 static __inline void	src_free(void);
+static __inline void	touch_reg(int);
+static void		undo_save(int);
+static size_t		undo_begin(void);
+static void		undo_end(size_t);
+static int		saved_reg_cmp(const void *, const void *);
 
 static __inline u_int	max(u_int, u_int);
 static u_long		get_ulong(struct number *);
@@ -96,6 +152,8 @@ static void		bdiv(void);
 static void		bmod(void);
 static void		bdivmod(void);
 static void		bexp(void);
+static void		bmodexp(void);
+static void		bmuladdmod(void);
 static void		bsqrt(void);
 static void		not(void);
 static void		equal_numbers(void);
@@ -120,11 +178,16 @@ static void		quit(void);
 static void		quitN(void);
 static void		skipN(void);
 static void		skip_until_mark(void);
+static void		end_job(void);
 static void		parse_number(void);
 static void		unknown(void);
 static void		eval_string(char *);
+static bool		push_macro(char *);
 static void		eval_line(void);
 static void		eval_tos(void);
+static void		run_macro(const char *);
+static bool		par_operands(void);
+static void		parallel_for(void);
 
 
 typedef void		(*opcode_function)(void);
@@ -142,6 +205,7 @@ static const struct jump_entry jump_table_data[] = {
 	{ '!',	not_compare	},
 	{ '#',	comment		},
 	{ '%',	bmod		},
+	{ '&',	parallel_for	},
 	{ '(',	less_numbers	},
 	{ '*',	bmul		},
 	{ '+',	badd		},
@@ -199,6 +263,7 @@ static const struct jump_entry jump_table_data[] = {
 	{ 'i',	set_ibase	},
 	{ 'k',	set_scale	},
 	{ 'l',	load		},
+	{ 'm',	bmuladdmod	},
 	{ 'n',	pop_printn	},
 	{ 'o',	set_obase	},
 	{ 'p',	print_tos	},
@@ -209,6 +274,7 @@ static const struct jump_entry jump_table_data[] = {
 	{ 'x',	eval_tos	},
 	{ 'z',	stackdepth	},
 	{ '{',	lesseq_numbers	},
+	{ '|',	bmodexp		},
 	{ '~',	bdivmod		}
 };
 
@@ -265,15 +331,52 @@ init_bmachine(bool extended_registers)
 	if (bmachine.readstack == NULL)
 		err(1, NULL);
 	bmachine.obase = bmachine.ibase = 10;
+	bmachine.out = stdout;
+	bmachine.err = stderr;
 	(void)signal(SIGINT, sighandler);
 }
 
+/* Where the machine writes its output and its error messages */
+void
+bmachine_setio(FILE *out, FILE *err)
+{
+	bmachine.out = out;
+	bmachine.err = err;
+}
+
+/* bwarnx(3), to the error stream of the machine */
+void
+bwarnx(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void)fprintf(bmachine.err, "%s: ", __progname);
+	(void)vfprintf(bmachine.err, fmt, ap);
+	(void)putc('\n', bmachine.err);
+	va_end(ap);
+}
+
 u_int
 bmachine_scale(void)
 {
 	return bmachine.scale;
 }
 
+/* The largest array index that may be used */
+void
+bmachine_array_max(u_long max)
+{
+	max_array_index = max;
+}
+
+/* Same as receiving SIGINT; for bc(1) running dc in-process */
+void
+bmachine_interrupt(void)
+{
+	bmachine.interrupted = true;
+}
+
 /* Reset the things needed before processing a (new) file */
 void
 reset_bmachine(struct source *src)
@@ -282,6 +385,147 @@ reset_bmachine(struct source *src)
 	bmachine.readstack[0] = *src;
 }
 
+/*
+ * Take the current stack, registers and bases as the state that
+ * bmachine_restore() returns to.  Called once, before the first job of
+ * a batch.
+ */
+void
+bmachine_mark(void)
+{
+	size_t i;
+
+	if (baseline.marked)
+		return;
+	baseline.marked = true;
+	stack_init(&baseline.stack);
+	stack_copy(&baseline.stack, &bmachine.stack);
+	baseline.scale = bmachine.scale;
+	baseline.obase = bmachine.obase;
+	baseline.ibase = bmachine.ibase;
+
+	for (i = 0; i < bmachine.reg_array_size; i++) {
+		if (bmachine.reg[i].sp == -1)
+			continue;
+		baseline.saved = breallocarray(baseline.saved,
+		    baseline.nsaved + 1, sizeof(*baseline.saved));
+		baseline.saved[baseline.nsaved].idx = i;
+		stack_init(&baseline.saved[baseline.nsaved].stack);
+		stack_copy(&baseline.saved[baseline.nsaved].stack,
+		    &bmachine.reg[i]);
+		baseline.nsaved++;
+	}
+	baseline.dirty = calloc(bmachine.reg_array_size,
+	    sizeof(*baseline.dirty));
+	if (baseline.dirty == NULL)
+		err(1, NULL);
+}
+
+/*
+ * Go back to the state of bmachine_mark().  Only the registers written
+ * since are copied back, into the storage they already have.
+ */
+void
+bmachine_restore(void)
+{
+	struct saved_reg	key, *r;
+	size_t			i;
+	int			idx;
+
+	for (i = 0; i < baseline.ntouched; i++) {
+		idx = baseline.touched[i];
+		baseline.dirty[idx] = false;
+		key.idx = idx;
+		r = baseline.nsaved == 0 ? NULL : bsearch(&key,
+		    baseline.saved, baseline.nsaved, sizeof(*baseline.saved),
+		    saved_reg_cmp);
+		if (r != NULL)
+			stack_copy(&bmachine.reg[idx], &r->stack);
+		else
+			stack_reset(&bmachine.reg[idx]);
+	}
+	baseline.ntouched = 0;
+
+	stack_copy(&bmachine.stack, &baseline.stack);
+	bmachine.scale = baseline.scale;
+	bmachine.obase = baseline.obase;
+	bmachine.ibase = baseline.ibase;
+	bmachine.interrupted = false;
+}
+
+static int
+saved_reg_cmp(const void *a, const void *b)
+{
+	const struct saved_reg *ra = a, *rb = b;
+
+	return ra->idx < rb->idx ? -1 : ra->idx > rb->idx;
+}
+
+/* Note a register write, for bmachine_restore() and undo_end() */
+static __inline void
+touch_reg(int idx)
+{
+	if (undo.depth > 0 && undo.level[idx] != undo.depth)
+		undo_save(idx);
+	if (!baseline.marked || baseline.dirty[idx])
+		return;
+	if (baseline.ntouched == baseline.touched_sz) {
+		baseline.touched_sz = baseline.touched_sz * 2 + 16;
+		baseline.touched = breallocarray(baseline.touched,
+		    baseline.touched_sz, sizeof(*baseline.touched));
+	}
+	baseline.dirty[idx] = true;
+	baseline.touched[baseline.ntouched++] = idx;
+}
+
+/* Keep what register idx holds, to be put back by undo_end() */
+static void
+undo_save(int idx)
+{
+	struct undo_reg	*u;
+
+	if (undo.nsaved == undo.size) {
+		undo.size = undo.size * 2 + 16;
+		undo.saved = breallocarray(undo.saved, undo.size,
+		    sizeof(*undo.saved));
+	}
+	u = &undo.saved[undo.nsaved++];
+	u->idx = idx;
+	u->level = undo.level[idx];
+	stack_init(&u->stack);
+	stack_copy(&u->stack, &bmachine.reg[idx]);
+	undo.level[idx] = undo.depth;
+}
+
+/* Start saving the registers written; returns the mark for undo_end() */
+static size_t
+undo_begin(void)
+{
+	if (undo.level == NULL) {
+		undo.level = calloc(bmachine.reg_array_size,
+		    sizeof(*undo.level));
+		if (undo.level == NULL)
+			err(1, NULL);
+	}
+	undo.depth++;
+	return undo.nsaved;
+}
+
+/* Put back the registers written since undo_begin() returned mark */
+static void
+undo_end(size_t mark)
+{
+	struct undo_reg	*u;
+
+	while (undo.nsaved > mark) {
+		u = &undo.saved[--undo.nsaved];
+		stack_clear(&bmachine.reg[u->idx]);
+		bmachine.reg[u->idx] = u->stack;
+		undo.level[u->idx] = u->level;
+	}
+	undo.depth--;
+}
+
 static __inline int
 readch(void)
 {
@@ -487,7 +731,7 @@ clear_stack(void)
 static void
 print_stack(void)
 {
-	stack_print(stdout, &bmachine.stack, "", bmachine.obase);
+	stack_print(bmachine.out, &bmachine.stack, "", bmachine.obase);
 }
 
 static void
@@ -495,10 +739,10 @@ print_tos(void)
 {
 	struct value *value = tos();
 	if (value != NULL) {
-		print_value(stdout, value, "", bmachine.obase);
-		(void)putchar('\n');
+		print_value(bmachine.out, value, "", bmachine.obase);
+		(void)putc('\n', bmachine.out);
 	} else
-		warnx("stack empty");
+		bwarnx("stack empty");
 }
 
 static void
@@ -506,10 +750,10 @@ print_err(void)
 {
 	struct value *value = tos();
 	if (value != NULL) {
-		print_value(stderr, value, "", bmachine.obase);
-		(void)putc('\n', stderr);
+		print_value(bmachine.err, value, "", bmachine.obase);
+		(void)putc('\n', bmachine.err);
 	} else
-		warnx("stack empty");
+		bwarnx("stack empty");
 }
 
 static void
@@ -523,12 +767,12 @@ pop_print(void)
 			break;
 		case BCODE_NUMBER:
 			normalize(value->u.num, 0);
-			print_ascii(stdout, value->u.num);
-			(void)fflush(stdout);
+			print_ascii(bmachine.out, value->u.num);
+			(void)fflush(bmachine.out);
 			break;
 		case BCODE_STRING:
-			(void)fputs(value->u.string, stdout);
-			(void)fflush(stdout);
+			(void)fputs(value->u.string, bmachine.out);
+			(void)fflush(bmachine.out);
 			break;
 		}
 		stack_free_value(value);
@@ -541,8 +785,8 @@ pop_printn(void)
 	struct value *value = pop();
 
 	if (value != NULL) {
-		print_value(stdout, value, "", bmachine.obase);
-		(void)fflush(stdout);
+		print_value(bmachine.out, value, "", bmachine.obase);
+		(void)fflush(bmachine.out);
 		stack_free_value(value);
 	}
 }
@@ -586,13 +830,13 @@ set_scale(void)
 	n = pop_number();
 	if (n != NULL) {
 		if (BN_is_negative(n->number))
-			warnx("scale must be a nonnegative number");
+			bwarnx("scale must be a nonnegative number");
 		else {
 			scale = get_ulong(n);
 			if (scale != BN_MASK2 && scale <= UINT_MAX)
 				bmachine.scale = (u_int)scale;
 			else
-				warnx("scale too large");
+				bwarnx("scale too large");
 		}
 		free_number(n);
 	}
@@ -620,7 +864,7 @@ set_obase(void)
 		if (base != BN_MASK2 && base > 1 && base <= UINT_MAX)
 			bmachine.obase = (u_int)base;
 		else
-			warnx("output base must be a number greater than 1");
+			bwarnx("output base must be a number greater than 1");
 		free_number(n);
 	}
 }
@@ -647,7 +891,7 @@ set_ibase(void)
 		if (base != BN_MASK2 && 2 <= base && base <= 16)
 			bmachine.ibase = (u_int)base;
 		else
-			warnx("input base must be a number between 2 and 16 "
+			bwarnx("input base must be a number between 2 and 16 "
 			    "(inclusive)");
 		free_number(n);
 	}
@@ -808,13 +1052,13 @@ readreg(void)
 		ch1 = readch();
 		ch2 = readch();
 		if (ch1 == EOF || ch2 == EOF) {
-			warnx("unexpected eof");
+			bwarnx("unexpected eof");
 			idx = -1;
 		} else
 			idx = (ch1 << 8) + ch2 + UCHAR_MAX + 1;
 	}
 	if (idx < 0 || idx >= bmachine.reg_array_size) {
-		warnx("internal error: reg num = %d", idx);
+		bwarnx("internal error: reg num = %d", idx);
 		idx = -1;
 	}
 	return idx;
@@ -851,6 +1095,7 @@ store(void)
 		if (val == NULL) {
 			return;
 		}
+		touch_reg(idx);
 		stack_set_tos(&bmachine.reg[idx], val);
 	}
 }
@@ -865,6 +1110,7 @@ load_stack(void)
 	idx = readreg();
 	if (idx >= 0) {
 		stack = &bmachine.reg[idx];
+		touch_reg(idx);
 		value = NULL;
 		if (stack_size(stack) > 0) {
 			value = stack_pop(stack);
@@ -872,7 +1118,7 @@ load_stack(void)
 		if (value != NULL)
 			push(value);
 		else
-			warnx("stack register '%c' (0%o) is empty",
+			bwarnx("stack register '%c' (0%o) is empty",
 			    idx, idx);
 	}
 }
@@ -888,6 +1134,7 @@ store_stack(void)
 		value = pop();
 		if (value == NULL)
 			return;
+		touch_reg(idx);
 		stack_push(&bmachine.reg[idx], value);
 	}
 }
@@ -908,9 +1155,9 @@ load_array(void)
 			return;
 		idx = get_ulong(inumber);
 		if (BN_is_negative(inumber->number))
-			warnx("negative idx");
-		else if (idx == BN_MASK2 || idx > MAX_ARRAY_INDEX)
-			warnx("idx too big");
+			bwarnx("negative idx");
+		else if (idx == BN_MASK2 || idx > max_array_index)
+			bwarnx("idx too big");
 		else {
 			stack = &bmachine.reg[reg];
 			v = frame_retrieve(stack, idx);
@@ -946,13 +1193,14 @@ store_array(void)
 		}
 		idx = get_ulong(inumber);
 		if (BN_is_negative(inumber->number)) {
-			warnx("negative idx");
+			bwarnx("negative idx");
 			stack_free_value(value);
-		} else if (idx == BN_MASK2 || idx > MAX_ARRAY_INDEX) {
-			warnx("idx too big");
+		} else if (idx == BN_MASK2 || idx > max_array_index) {
+			bwarnx("idx too big");
 			stack_free_value(value);
 		} else {
 			stack = &bmachine.reg[reg];
+			touch_reg(reg);
 			frame_assign(stack, idx, value);
 		}
 		free_number(inumber);
@@ -1072,7 +1320,7 @@ bdiv(void)
 	scale = max(a->scale, b->scale);
 
 	if (BN_is_zero(a->number))
-		warnx("divide by zero");
+		bwarnx("divide by zero");
 	else {
 		normalize(a, scale);
 		normalize(b, scale + r->scale);
@@ -1105,7 +1353,7 @@ bmod(void)
 	r->scale = max(b->scale, a->scale + bmachine.scale);
 
 	if (BN_is_zero(a->number))
-		warnx("remainder by zero");
+		bwarnx("remainder by zero");
 	else {
 		normalize(a, scale);
 		normalize(b, scale + bmachine.scale);
@@ -1140,7 +1388,7 @@ bdivmod(void)
 	scale = max(a->scale, b->scale);
 
 	if (BN_is_zero(a->number))
-		warnx("divide by zero");
+		bwarnx("divide by zero");
 	else {
 		normalize(a, scale);
 		normalize(b, scale + bmachine.scale);
@@ -1179,7 +1427,7 @@ bexp(void)
 		bn_checkp(f);
 		split_number(p, i, f);
 		if (!BN_is_zero(f))
-			warnx("Runtime warning: non-zero fractional part "
+			bwarnx("Runtime warning: non-zero fractional part "
 			    "in exponent");
 		BN_free(p->number);
 		p->number = i;
@@ -1240,7 +1488,7 @@ bexp(void)
 			scale_number(one, r->scale + rscale);
 
 			if (BN_is_zero(r->number))
-				warnx("divide by zero");
+				bwarnx("divide by zero");
 			else
 				bn_check(BN_div(r->number, NULL, one,
 				    r->number, bmachine.ctx));
@@ -1254,6 +1502,69 @@ bexp(void)
 	free_number(p);
 }
 
+/* a b m |: a^b % m */
+static void
+bmodexp(void)
+{
+	struct number	*a, *p, *m;
+
+	m = pop_number();
+	if (m == NULL)
+		return;
+	p = pop_number();
+	if (p == NULL) {
+		push_number(m);
+		return;
+	}
+	a = pop_number();
+	if (a == NULL) {
+		push_number(p);
+		push_number(m);
+		return;
+	}
+	push_number(a);
+	push_number(p);
+	bexp();
+	push_number(m);
+	bmod();
+}
+
+/* a b c m m: (a*b + c) % m */
+static void
+bmuladdmod(void)
+{
+	struct number	*a, *b, *c, *m;
+
+	m = pop_number();
+	if (m == NULL)
+		return;
+	c = pop_number();
+	if (c == NULL) {
+		push_number(m);
+		return;
+	}
+	b = pop_number();
+	if (b == NULL) {
+		push_number(c);
+		push_number(m);
+		return;
+	}
+	a = pop_number();
+	if (a == NULL) {
+		push_number(b);
+		push_number(c);
+		push_number(m);
+		return;
+	}
+	push_number(a);
+	push_number(b);
+	bmul();
+	push_number(c);
+	badd();
+	push_number(m);
+	bmod();
+}
+
 static void
 bsqrt(void)
 {
@@ -1270,7 +1581,7 @@ bsqrt(void)
 		r = new_number();
 		push_number(r);
 	} else if (BN_is_negative(n->number))
-		warnx("square root of negative number");
+		bwarnx("square root of negative number");
 	else {
 		scale = max(bmachine.scale, n->scale);
 		normalize(n, 2*scale);
@@ -1396,7 +1707,7 @@ not_compare(void)
 		break;
 	default:
 		unreadch();
-		warnx("! command is deprecated");
+		bwarnx("! command is deprecated");
 		break;
 	}
 }
@@ -1474,14 +1785,15 @@ compare(enum bcode_compare type)
 	if (idx >= 0 && (ok || (!ok && elseidx != NO_ELSE))) {
 		v = stack_tos(&bmachine.reg[idx]);
 		if (v == NULL)
-			warnx("register '%c' (0%o) is empty", idx, idx);
+			bwarnx("register '%c' (0%o) is empty", idx, idx);
 		else {
 			switch(v->type) {
 			case BCODE_NONE:
-				warnx("register '%c' (0%o) is empty", idx, idx);
+				bwarnx("register '%c' (0%o) is empty", idx, idx);
 				break;
 			case BCODE_NUMBER:
-				warn("eval called with non-string argument");
+				bwarnx("eval called with non-string argument: %s",
+				    strerror(errno));
 				break;
 			case BCODE_STRING:
 				eval_string(bstrdup(v->u.string));
@@ -1496,9 +1808,26 @@ nop(void)
 {
 }
 
+/* In a batch, end the job: drop all that is left to read */
+static void
+end_job(void)
+{
+	static char	empty[] = "";
+
+	while (bmachine.readsp > 0) {
+		src_free();
+		bmachine.readsp--;
+	}
+	src_setstring(&bmachine.readstack[0], empty);
+}
+
 static void
 quit(void)
 {
+	if (bmachine.readsp < 2 && baseline.marked) {
+		end_job();
+		return;
+	}
 	if (bmachine.readsp < 2)
 		exit(0);
 	src_free();
@@ -1519,9 +1848,9 @@ quitN(void)
 	i = get_ulong(n);
 	free_number(n);
 	if (i == BN_MASK2 || i == 0)
-		warnx("Q command requires a number >= 1");
+		bwarnx("Q command requires a number >= 1");
 	else if (bmachine.readsp < i)
-		warnx("Q command argument exceeded string execution depth");
+		bwarnx("Q command argument exceeded string execution depth");
 	else {
 		while (i-- > 0) {
 			src_free();
@@ -1541,9 +1870,9 @@ skipN(void)
 		return;
 	i = get_ulong(n);
 	if (i == BN_MASK2)
-		warnx("J command requires a number >= 0");
+		bwarnx("J command requires a number >= 0");
 	else if (i > 0 && bmachine.readsp < i)
-		warnx("J command argument exceeded string execution depth");
+		bwarnx("J command argument exceeded string execution depth");
 	else {
 		while (i-- > 0) {
 			src_free();
@@ -1561,7 +1890,11 @@ skip_until_mark(void)
 		case 'M':
 			return;
 		case EOF:
-			errx(1, "mark not found");
+			/* A batch goes on with its next job */
+			if (!baseline.marked)
+				errx(1, "mark not found");
+			bwarnx("mark not found");
+			end_job();
 			return;
 		case 'l':
 		case 'L':
@@ -1615,7 +1948,7 @@ static void
 unknown(void)
 {
 	int ch = bmachine.readstack[bmachine.readsp].lastchar;
-	warnx("%c (0%o) is unimplemented", ch, ch);
+	bwarnx("%c (0%o) is unimplemented", ch, ch);
 }
 
 static void
@@ -1633,17 +1966,34 @@ eval_string(char *p)
 		} else
 			unreadch();
 	}
+	(void)push_macro(p);
+}
+
+/*
+ * Read p next, returning to what is read now at its end; false if it
+ * could not be, and the job was ended.
+ */
+static bool
+push_macro(char *p)
+{
 	if (bmachine.readsp == bmachine.readstack_sz - 1) {
 		size_t newsz = bmachine.readstack_sz * 2;
 		struct source *stack;
 		stack = reallocarray(bmachine.readstack, newsz,
 		    sizeof(struct source));
-		if (stack == NULL)
-			err(1, "recursion too deep");
+		if (stack == NULL) {
+			if (!baseline.marked)
+				err(1, "recursion too deep");
+			bwarnx("recursion too deep");
+			free(p);
+			end_job();
+			return false;
+		}
 		bmachine.readstack_sz = newsz;
 		bmachine.readstack = stack;
 	}
 	src_setstring(&bmachine.readstack[++bmachine.readsp], p);
+	return true;
 }
 
 static void
@@ -1653,6 +2003,11 @@ eval_line(void)
 	struct source	in;
 	char		*p;
 
+	/* In a batch, stdin may hold the jobs, which must not be eaten */
+	if (baseline.marked) {
+		bwarnx("? not allowed in a batch");
+		return;
+	}
 	clearerr(stdin);
 	src_setstream(&in, stdin);
 	p = (*in.vtable->readline)(&in);
@@ -1669,6 +2024,161 @@ eval_tos(void)
 		eval_string(p);
 }
 
+/*
+ * Parallel loops, as in the GMP dc: a start value, the bounds a and b,
+ * a mode, and init, body and end macros.  Here the chunks run one after
+ * the other, in this machine.  What a chunk writes to the registers is
+ * undone after it, so that as in the GMP dc, each starts from the
+ * registers as the loop found them, and all it leaves is its partial
+ * result.  & leaves the combined result and the index after the last.
+ */
+static void
+run_macro(const char *macro)
+{
+	size_t	top;
+	int	ch;
+
+	if (!push_macro(bstrdup(macro)))
+		return;
+	top = bmachine.readsp;
+	while (bmachine.readsp >= top) {
+		ch = readch();
+		if (ch == EOF || bmachine.interrupted) {
+			src_free();
+			bmachine.readsp--;
+			continue;
+		}
+		if (0 <= ch && ch < nitems(jump_table))
+			(*jump_table[ch])();
+		else
+			unknown();
+	}
+}
+
+/* Check the operands of &, at depth 0 and up */
+static bool
+par_operands(void)
+{
+	ssize_t	i;
+	size_t	depth = stack_size(&bmachine.stack);
+
+	if (depth < 7) {
+		bwarnx("stack empty");
+		return false;
+	}
+	for (i = 0; i < 7; i++) {
+		if (bmachine.stack.stack[bmachine.stack.sp - i].type !=
+		    (i < 3 ? BCODE_STRING : BCODE_NUMBER)) {
+			bwarnx(i < 3 ? "not a string" : "not a number");
+			return false;
+		}
+	}
+	return true;
+}
+
+static void
+parallel_for(void)
+{
+	struct number	*a, *b, *n, *m, *one;
+	char		*macro[3];
+	BIGNUM		*i, *f;
+	u_long		mode, total, nchunks, c, k, count;
+	size_t		mark, depth;
+	u_int		scale, obase, ibase;
+	int		j;
+
+	if (!par_operands())
+		return;
+	for (j = 3; j-- > 0;)
+		macro[j] = pop_string();
+	n = pop_number();
+	mode = get_ulong(n);
+	free_number(n);
+	b = pop_number();
+	a = pop_number();
+
+	/* The number of indices from a: ceil(b - a), or floor(b - a) + 1 */
+	push_number(b);
+	push_number(dup_number(a));
+	bsub();
+	n = pop_number();
+	i = BN_new();
+	bn_checkp(i);
+	f = BN_new();
+	bn_checkp(f);
+	split_number(n, i, f);
+	total = 0;
+	if (mode > 5)
+		bwarnx("invalid parallel loop mode");
+	else if (!BN_is_negative(n->number)) {
+		total = BN_get_word(i);
+		if (total == BN_MASK2 || total == BN_MASK2 - 1) {
+			bwarnx("parallel loop too long");
+			total = 0;
+		} else if ((mode & 1) || !BN_is_zero(f))
+			total++;
+	}
+	BN_free(i);
+	BN_free(f);
+	free_number(n);
+
+	one = new_number();
+	bn_check(BN_one(one->number));
+	normalize(one, a->scale);
+	nchunks = total < PAR_CHUNKS ? total : PAR_CHUNKS;
+	/* The start value is on the stack */
+	for (c = 0; c < nchunks; c++) {
+		count = total / nchunks + (c < total % nchunks);
+		mark = undo_begin();
+		depth = stack_size(&bmachine.stack);
+		scale = bmachine.scale;
+		obase = bmachine.obase;
+		ibase = bmachine.ibase;
+		run_macro(macro[0]);
+		for (k = 0; k < count && !bmachine.interrupted; k++) {
+			push_number(dup_number(a));
+			run_macro(macro[1]);
+			bn_check(BN_add(a->number, a->number, one->number));
+		}
+		run_macro(macro[2]);
+		n = pop_number();
+		while (stack_size(&bmachine.stack) > depth)
+			stack_free_value(pop());
+		bmachine.scale = scale;
+		bmachine.obase = obase;
+		bmachine.ibase = ibase;
+		undo_end(mark);
+		if (n == NULL)
+			continue;
+		push_number(n);
+		switch (mode >> 1) {
+		case 0:
+			badd();
+			break;
+		case 1:
+			bmul();
+			break;
+		default:
+			n = pop_number();
+			m = pop_number();
+			if (compare_numbers(BCODE_LESS, dup_number(m),
+			    dup_number(n))) {
+				push_number(n);
+				free_number(m);
+			} else {
+				push_number(m);
+				free_number(n);
+			}
+			break;
+		}
+	}
+	free_number(one);
+	/* Counted up to the index after the last */
+	push_number(a);
+	for (j = 0; j < 3; j++)
+		free(macro[j]);
+}
+
 void
 eval(void)
 {
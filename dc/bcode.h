@@ -89,6 +89,13 @@ struct source {
 void			init_bmachine(bool);
 void			reset_bmachine(struct source *);
 u_int			bmachine_scale(void);
+void			bmachine_interrupt(void);
+void			bmachine_array_max(u_long);
+void			bmachine_mark(void);
+void			bmachine_restore(void);
+void			bmachine_setio(FILE *, FILE *);
+void			bwarnx(const char *, ...)
+			    __attribute__((__format__ (printf, 1, 2)));
 void			scale_number(BIGNUM *, int);
 void			normalize(struct number *, u_int);
 void			eval(void);
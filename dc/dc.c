@@ -19,6 +19,7 @@
 #include <sys/stat.h>
 #include <err.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -26,13 +27,26 @@
 #include "extern.h"
 
 static __dead void	usage(void);
+static void	batch_run(FILE *);
+static void	batch_frame(FILE *, const char *, const char *, size_t);
 
 extern char		*__progname;
 
+/* Batch mode: the streams a job writes to, and their buffers */
+static struct {
+	FILE	*out;
+	FILE	*err;
+	char	*outbuf;
+	char	*errbuf;
+	size_t	outsz;
+	size_t	errsz;
+} batch;
+
 static __dead void
 usage(void)
 {
-	(void)fprintf(stderr, "usage: %s [-x] [-e expression] [file]\n",
+	(void)fprintf(stderr,
+	    "usage: %s [-bx] [-a index] [-e expression] [-j threads] [file]\n",
 	    __progname);
 	exit(1);
 }
@@ -42,6 +56,9 @@ dc_main(int argc, char *argv[])
 {
 	int		ch;
 	bool		extended_regs = false;
+	bool		batch_mode = false;
+	long		threads = 1;
+	long		array_max = -1;
 	FILE		*file;
 	struct source	src;
 	char		*buf, *p;
@@ -51,14 +68,29 @@ dc_main(int argc, char *argv[])
 	/* accept and ignore a single dash to be 4.4BSD dc(1) compatible */
 	optind = 1;
 	optreset = 1;
-	while ((ch = getopt(argc, argv, "e:x-")) != -1) {
+	while ((ch = getopt(argc, argv, "a:be:j:x-")) != -1) {
 		switch (ch) {
+		case 'a':
+			array_max = strtol(optarg, &p, 10);
+			if (optarg[0] == '\0' || *p != '\0' || array_max < 0 ||
+			    array_max == LONG_MAX)
+				errx(1, "invalid array index: %s", optarg);
+			break;
+		case 'b':
+			batch_mode = true;
+			break;
 		case 'e':
 			p = buf;
 			if (asprintf(&buf, "%s %s", buf, optarg) == -1)
 				err(1, NULL);
 			free(p);
 			break;
+		case 'j':
+			threads = strtol(optarg, &p, 10);
+			if (optarg[0] == '\0' || *p != '\0' || threads < 1 ||
+			    threads > MAX_THREADS)
+				errx(1, "invalid number of threads: %s", optarg);
+			break;
 		case 'x':
 			extended_regs = true;
 			break;
@@ -72,6 +104,8 @@ dc_main(int argc, char *argv[])
 	argv += optind;
 
 	init_bmachine(extended_regs);
+	if (array_max >= 0)
+		dc_array_max(array_max);
 	(void)setvbuf(stdout, NULL, _IOLBF, 0);
 	(void)setvbuf(stderr, NULL, _IOLBF, 0);
 
@@ -82,9 +116,18 @@ dc_main(int argc, char *argv[])
 		reset_bmachine(&src);
 		eval();
 		free(buf);
-		if (argc == 0)
+		if (argc == 0 && !batch_mode)
 			return (0);
 	}
+	if (batch_mode) {
+		file = stdin;
+		if (argc == 1 && (file = fopen(argv[0], "r")) == NULL)
+			err(1, "cannot open file %s", argv[0]);
+		dc_batch_init(threads);
+		batch_run(file);
+		dc_batch_end();
+		return (0);
+	}
 	if (argc == 1) {
 		file = fopen(argv[0], "r");
 		if (file == NULL)
@@ -111,3 +154,133 @@ dc_main(int argc, char *argv[])
 
 	return (0);
 }
+
+/*
+ * Interface for bc(1) running dc in its own process instead of in a
+ * child reading from a pipe: dc_init() once, then dc_eval() for each
+ * chunk of generated code.
+ */
+void
+dc_init(void)
+{
+	init_bmachine(true);
+	(void)setvbuf(stdout, NULL, _IOLBF, 0);
+	(void)setvbuf(stderr, NULL, _IOLBF, 0);
+}
+
+/* Parallel loops run serially here */
+/* ARGSUSED */
+void
+dc_threads(int threads)
+{
+	(void)threads;
+}
+
+/* The largest array index, for -a */
+void
+dc_array_max(long max)
+{
+	bmachine_array_max(max);
+}
+
+void
+dc_eval(char *buf)
+{
+	struct source	src;
+
+	src_setstring(&src, buf);
+	reset_bmachine(&src);
+	eval();
+}
+
+/* Called from bc's SIGINT handler */
+void
+dc_interrupt(void)
+{
+	bmachine_interrupt();
+}
+
+/* Whether the functions of bc's math library are built in */
+bool
+dc_native_library(void)
+{
+	return false;
+}
+
+/* Batch mode as in the GMP dc, but jobs run one at a time */
+/* ARGSUSED */
+void
+dc_batch_init(int threads)
+{
+	(void)threads;
+	bmachine_mark();
+	(void)fflush(stdout);
+	(void)fflush(stderr);
+	batch.out = open_memstream(&batch.outbuf, &batch.outsz);
+	batch.err = open_memstream(&batch.errbuf, &batch.errsz);
+	if (batch.out == NULL || batch.err == NULL)
+		err(1, NULL);
+	bmachine_setio(batch.out, batch.err);
+}
+
+void
+dc_batch_eval(char *buf)
+{
+	off_t	len;
+
+	bmachine_restore();
+	dc_eval(buf);
+	(void)fflush(batch.out);
+	(void)fflush(batch.err);
+	if ((len = ftello(batch.err)) > 0)
+		batch_frame(stdout, "error", batch.errbuf, len);
+	else
+		batch_frame(stdout, "ok", batch.outbuf, ftello(batch.out));
+	rewind(batch.out);
+	rewind(batch.err);
+}
+
+void
+dc_batch_end(void)
+{
+	(void)fflush(stdout);
+}
+
+/* Every line of f is a job */
+static void
+batch_run(FILE *f)
+{
+	char	*line = NULL;
+	size_t	size = 0;
+
+	while (getline(&line, &size, f) != -1)
+		dc_batch_eval(line);
+	if (ferror(f))
+		err(1, "read");
+	free(line);
+}
+
+static void
+batch_frame(FILE *f, const char *status, const char *text, size_t len)
+{
+	size_t	i;
+
+	if (len > 0 && text[len - 1] == '\n')
+		len--;
+	(void)fputs(status, f);
+	if (len > 0)
+		(void)putc(' ', f);
+	for (i = 0; i < len; i++) {
+		if (text[i] == '\\' && i + 1 < len && text[i + 1] == '\n')
+			i++;
+		else if (text[i] == '\\')
+			(void)fputs("\\\\", f);
+		else if (text[i] == '\n')
+			(void)fputs("\\n", f);
+		else
+			(void)putc(text[i], f);
+	}
+	(void)putc('\n', f);
+	if (ferror(f))
+		err(1, "write");
+}
@@ -55,10 +55,23 @@ struct value	*stack_pop(struct stack *);
 struct number	*stack_popnumber(struct stack *);
 char *		stack_popstring(struct stack *);
 void		stack_clear(struct stack *);
+void		stack_reset(struct stack *);
+void		stack_copy(struct stack *, const struct stack *);
 void		stack_print(FILE *, const struct stack *, const char *,
 		    u_int base);
 void		frame_assign(struct stack *, size_t, const struct value *);
 struct value *	frame_retrieve(const struct stack *, size_t);
 /* void		frame_free(struct stack *); */
 
+#define MAX_THREADS	1024	/* most that -j takes */
+
 int		dc_main(int, char **);
+void		dc_init(void);
+void		dc_eval(char *);
+void		dc_threads(int);
+void		dc_array_max(long);
+void		dc_batch_init(int);
+void		dc_batch_eval(char *);
+void		dc_batch_end(void);
+void		dc_interrupt(void);
+bool		dc_native_library(void);
@@ -44,7 +44,7 @@ stack_empty(const struct stack *stack)
 {
 	bool empty = stack->sp == -1;
 	if (empty)
-		warnx("stack empty");
+		bwarnx("stack empty");
 	return empty;
 }
 
@@ -102,7 +102,7 @@ stack_dup(struct stack *stack)
 
 	value = stack_tos(stack);
 	if (value == NULL) {
-		warnx("stack empty");
+		bwarnx("stack empty");
 		return;
 	}
 	stack_push(stack, stack_dup_value(value, &copy));
@@ -114,7 +114,7 @@ stack_swap(struct stack *stack)
 	struct value	copy;
 
 	if (stack->sp < 1) {
-		warnx("stack empty");
+		bwarnx("stack empty");
 		return;
 	}
 	copy = stack->stack[stack->sp];
@@ -209,7 +209,7 @@ stack_popnumber(struct stack *stack)
 	array_free(stack->stack[stack->sp].array);
 	stack->stack[stack->sp].array = NULL;
 	if (stack->stack[stack->sp].type != BCODE_NUMBER) {
-		warnx("not a number"); /* XXX remove */
+		bwarnx("not a number"); /* XXX remove */
 		return NULL;
 	}
 	return stack->stack[stack->sp--].u.num;
@@ -223,7 +223,7 @@ stack_popstring(struct stack *stack)
 	array_free(stack->stack[stack->sp].array);
 	stack->stack[stack->sp].array = NULL;
 	if (stack->stack[stack->sp].type != BCODE_STRING) {
-		warnx("not a string"); /* XXX remove */
+		bwarnx("not a string"); /* XXX remove */
 		return NULL;
 	}
 	return stack->stack[stack->sp--].u.string;
@@ -238,6 +238,27 @@ stack_clear(struct stack *stack)
 	stack_init(stack);
 }
 
+/* Like stack_clear(), but keep the storage for reuse */
+void
+stack_reset(struct stack *stack)
+{
+	while (stack->sp >= 0)
+		stack_free_value(&stack->stack[stack->sp--]);
+}
+
+/* Make to a copy of from, reusing the storage of to */
+void
+stack_copy(struct stack *to, const struct stack *from)
+{
+	ssize_t i;
+
+	stack_reset(to);
+	for (i = 0; i <= from->sp; i++) {
+		stack_grow(to);
+		(void)stack_dup_value(&from->stack[i], &to->stack[to->sp]);
+	}
+}
+
 void
 stack_print(FILE *f, const struct stack *stack, const char *prefix, u_int base)
 {
@@ -17,8 +17,11 @@
  */
 
 #include <err.h>
+#include <errno.h>
 #include <limits.h>
+#include <pthread.h>
 #include <signal.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -27,12 +30,16 @@
 
 /* #define	DEBUGGING */
 
-#define MAX_ARRAY_INDEX		2048
+#define MAX_ARRAY_INDEX		16777215	/* unless set with -a */
 #define READSTACK_SIZE		8
 
 #define NO_ELSE			-2	/* -1 is EOF */
+#define CONSTANT_HASH_SIZE	64
 #define REG_ARRAY_SIZE_SMALL	(UCHAR_MAX + 1)
 #define REG_ARRAY_SIZE_BIG	(UCHAR_MAX + 1 + USHRT_MAX + 1)
+#define REG_PAGE_SIZE		256	/* registers allocated at a time */
+#define PAR_CHUNKS		256	/* most chunks a parallel loop is cut in */
+#define MAX_POW_BITS		(1UL << 30)	/* most bits ^ builds a number of */
 
 struct bmachine {
 	struct stack		stack;
@@ -42,29 +49,105 @@ struct bmachine {
 	size_t			readsp;
 	bool			extended_regs;
 	size_t			reg_array_size;
-	struct stack		*reg;
+	struct stack		**reg;		/* pages, allocated on use */
 	volatile sig_atomic_t	interrupted;
 	struct source		*readstack;
 	size_t			readstack_sz;
+	FILE			*out;
+	FILE			*err;
 };
 
-static struct bmachine	bmachine;
+/*
+ * All state is per thread, so that a batch can run a machine on each of
+ * several threads.
+ */
+static __thread struct bmachine	bmachine;
+
+/* Set before any machine runs, so shared */
+static u_long			max_array_index = MAX_ARRAY_INDEX;
+
+extern char		*__progname;
+
+/*
+ * The state batch jobs start from, and the registers written since.
+ * Registers that were not empty at the mark are kept sorted by index.
+ */
+struct saved_reg {
+	int			idx;
+	struct stack		stack;
+};
+
+static __thread struct baseline {
+	bool			marked;
+	bool			extended_regs;
+	struct stack		stack;
+	u_int			scale;
+	u_int			obase;
+	u_int			ibase;
+	struct saved_reg	*saved;
+	size_t			nsaved;
+	bool			*dirty;
+	int			*touched;
+	size_t			ntouched;
+	size_t			touched_sz;
+} baseline;
+
+/*
+ * Registers written by the chunks of a parallel loop that run on the
+ * calling machine, with what they held before, so that as on a worker,
+ * a chunk leaves none of its writes behind.  Only the innermost loop
+ * running here saves a register: an inner loop puts back what it writes.
+ */
+struct undo_reg {
+	int			idx;
+	u_int			level;		/* of the save before this one */
+	struct stack		stack;
+};
+
+static __thread struct {
+	u_int			depth;		/* of chunks running here */
+	u_int			*level;		/* the depth each is saved for */
+	struct undo_reg		*saved;
+	size_t			nsaved;
+	size_t			size;
+} undo;
+
+/* Numbers appearing in compiled strings, keyed by text and input base */
+static __thread struct {
+	struct constant		**tab;
+	size_t			size;
+	size_t			count;
+} constants;
+
+struct chunk;
+struct par_io;
+
 static void sighandler(int);
 
 static __inline int	readch(void);
 static __inline void	unreadch(void);
 static __inline char	*readline(void);
 static __inline void	src_free(void);
+static __inline void	touch_reg(int);
+static void		undo_save(int);
+static size_t		undo_begin(void);
+static void		undo_end(size_t);
+static __inline struct stack *reg_find(const struct bmachine *, size_t);
+static __inline struct stack *reg_stack(size_t);
+static int		saved_reg_cmp(const void *, const void *);
+static __inline struct instr *cur_instr(void);
+static size_t		read_depth(void);
+static void		pop_level(void);
 
 static __inline u_int	max(u_int, u_int);
 static u_long		get_ulong(struct number *);
 
 static __inline void	push_number(struct number *);
-static __inline void	push_string(char *);
+static __inline void	push_string(struct string *);
 static __inline void	push(struct value *);
 static __inline struct value *tos(void);
 static __inline struct number	*pop_number(void);
-static __inline char	*pop_string(void);
+static __inline struct string *pop_string(void);
 static void		clear_stack(void);
 static void		print_tos(void);
 static void		print_err(void);
@@ -83,19 +166,33 @@ static void		get_ibase(void);
 static void		set_ibase(void);
 static void		stackdepth(void);
 static void		push_scale(void);
-static u_int		count_digits(const struct number *);
 static void		num_digits(void);
 static void		to_ascii(void);
 static void		push_line(void);
 static void		comment(void);
+static void		power_of_ten_free(void);
+static void		add_scaled(mpz_t, const mpz_t, u_int);
+static void		sub_scaled(mpz_t, const mpz_t, u_int);
 static void		badd(void);
 static void		bsub(void);
 static void		bmul(void);
 static void		bdiv(void);
 static void		bmod(void);
 static void		bdivmod(void);
+static bool		pow_number(struct number *, const struct number *,
+			    mpz_srcptr);
 static void		bexp(void);
+static void		bmodexp(void);
+static void		bmuladdmod(void);
 static void		bsqrt(void);
+static void		library_fn(struct number *(*)(const struct number *,
+			    u_int));
+static void		lib_e(void);
+static void		lib_l(void);
+static void		lib_s(void);
+static void		lib_c(void);
+static void		lib_a(void);
+static void		lib_j(void);
 static void		not(void);
 static void		equal_numbers(void);
 static void		less_numbers(void);
@@ -104,6 +201,8 @@ static void		equal(void);
 static void		less(void);
 static void		greater(void);
 static void		not_compare(void);
+static int		cmp_numbers(struct number *, struct number *);
+static bool		compare_result(enum bcode_compare, int);
 static bool		compare_numbers(enum bcode_compare, struct number *,
 			    struct number *);
 static void		compare(enum bcode_compare);
@@ -113,17 +212,47 @@ static void		store(void);
 static void		load_stack(void);
 static void		store_stack(void);
 static void		load_array(void);
+static bool		pop_index(int *, u_long *);
 static void		store_array(void);
 static void		nop(void);
 static void		quit(void);
 static void		quitN(void);
 static void		skipN(void);
 static void		skip_until_mark(void);
+static void		end_job(void);
 static void		parse_number(void);
 static void		unknown(void);
+static bool		push_source(struct source *);
+static void		eval_source(struct source *);
 static void		eval_string(char *);
+static void		eval_program(struct program *);
+static void		eval_value(struct value *);
+static __inline struct program *value_program(struct value *);
 static void		eval_line(void);
 static void		eval_tos(void);
+static void		run_macro(struct value *);
+static void		par_chunk(struct chunk *, struct value *,
+			    const struct number *);
+static void		par_chunk_here(struct chunk *, struct value *,
+			    const struct number *);
+static void		par_sync(bool);
+static void		par_run(struct par_io *);
+static void		*par_worker(void *);
+static bool		par_start(void);
+static bool		par_operands(void);
+static void		par_interrupt(void);
+static void		parallel_for(void);
+
+static int		src_getcharprogram(struct source *);
+static void		src_ungetcharprogram(struct source *);
+static char		*src_getlineprogram(struct source *);
+static void		src_freeprogram(struct source *);
+static struct instr	*program_add(struct program *, int);
+static int		compile_reg(const u_char **);
+static bool		is_number_char(int);
+static u_int		constant_hash(const char *, size_t, u_int);
+static struct constant	*constant_intern(const char *, size_t, u_int);
+static void		constant_release(struct constant *);
 
 
 typedef void		(*opcode_function)(void);
@@ -136,11 +265,19 @@ struct jump_entry {
 
 static opcode_function jump_table[UCHAR_MAX + 1];
 
+static struct vtable program_vtable = {
+	src_getcharprogram,
+	src_ungetcharprogram,
+	src_getlineprogram,
+	src_freeprogram
+};
+
 static const struct jump_entry jump_table_data[] = {
 	{ ' ',	nop		},
 	{ '!',	not_compare	},
 	{ '#',	comment		},
 	{ '%',	bmod		},
+	{ '&',	parallel_for	},
 	{ '(',	less_numbers	},
 	{ '*',	bmul		},
 	{ '+',	badd		},
@@ -170,6 +307,7 @@ static const struct jump_entry jump_table_data[] = {
 	{ 'E',	parse_number	},
 	{ 'F',	parse_number	},
 	{ 'G',	equal_numbers	},
+	{ 'H',	lib_e		},
 	{ 'I',	get_ibase	},
 	{ 'J',	skipN		},
 	{ 'K',	get_scale	},
@@ -181,7 +319,12 @@ static const struct jump_entry jump_table_data[] = {
 	{ 'Q',	quitN		},
 	{ 'R',	drop		},
 	{ 'S',	store_stack	},
+	{ 'T',	lib_l		},
+	{ 'U',	lib_s		},
+	{ 'V',	lib_c		},
+	{ 'W',	lib_a		},
 	{ 'X',	push_scale	},
+	{ 'Y',	lib_j		},
 	{ 'Z',	num_digits	},
 	{ '[',	push_line	},
 	{ '\f',	nop		},
@@ -198,6 +341,7 @@ static const struct jump_entry jump_table_data[] = {
 	{ 'i',	set_ibase	},
 	{ 'k',	set_scale	},
 	{ 'l',	load		},
+	{ 'm',	bmuladdmod	},
 	{ 'n',	pop_printn	},
 	{ 'o',	set_obase	},
 	{ 'p',	print_tos	},
@@ -208,6 +352,7 @@ static const struct jump_entry jump_table_data[] = {
 	{ 'x',	eval_tos	},
 	{ 'z',	stackdepth	},
 	{ '{',	lesseq_numbers	},
+	{ '|',	bmodexp		},
 	{ '~',	bdivmod		}
 };
 
@@ -221,6 +366,7 @@ sighandler(int ignored)
 {
 	(void) ignored;
 	bmachine.interrupted = true;
+	par_interrupt();
 }
 
 void
@@ -232,36 +378,66 @@ init_bmachine(bool extended_registers)
 	bmachine.reg_array_size = bmachine.extended_regs ?
 	    REG_ARRAY_SIZE_BIG : REG_ARRAY_SIZE_SMALL;
 
-	bmachine.reg = calloc(bmachine.reg_array_size,
-	    sizeof(bmachine.reg[0]));
+	bmachine.reg = calloc((bmachine.reg_array_size + REG_PAGE_SIZE - 1) /
+	    REG_PAGE_SIZE, sizeof(bmachine.reg[0]));
 	if (bmachine.reg == NULL)
 		err(1, NULL);
 
-	for (i = 0; i < nitems(jump_table); i++)
-		jump_table[i] = unknown;
-
-	for (i = 0; i < nitems(jump_table_data); i++) {
-		if ((unsigned int)jump_table_data[i].ch >= nitems(jump_table))
-			errx(1, "opcode '%c' overflows jump table",
-			    jump_table_data[i].ch);
-		if (jump_table[jump_table_data[i].ch] != unknown)
-			errx(1, "opcode '%c' already assigned",
-			    jump_table_data[i].ch);
-		jump_table[jump_table_data[i].ch] = jump_table_data[i].f;
+	/*
+	 * Shared; machines on other threads are started after the first,
+	 * which also takes SIGINT for the process and reports the number
+	 * pool at exit.
+	 */
+	if (jump_table[0] == NULL) {
+		(void)signal(SIGINT, sighandler);
+		number_pool_stats();
+		for (i = 0; i < nitems(jump_table); i++)
+			jump_table[i] = unknown;
+
+		for (i = 0; i < nitems(jump_table_data); i++) {
+			if ((unsigned int)jump_table_data[i].ch >=
+			    nitems(jump_table))
+				errx(1, "opcode '%c' overflows jump table",
+				    jump_table_data[i].ch);
+			if (jump_table[jump_table_data[i].ch] != unknown)
+				errx(1, "opcode '%c' already assigned",
+				    jump_table_data[i].ch);
+			jump_table[jump_table_data[i].ch] =
+			    jump_table_data[i].f;
+		}
 	}
 
 	stack_init(&bmachine.stack);
 
-	for (i = 0; i < bmachine.reg_array_size; i++)
-		stack_init(&bmachine.reg[i]);
-
 	bmachine.readstack_sz = READSTACK_SIZE;
 	bmachine.readstack = calloc(sizeof(struct source),
 	    bmachine.readstack_sz);
 	if (bmachine.readstack == NULL)
 		err(1, NULL);
 	bmachine.obase = bmachine.ibase = 10;
-	(void)signal(SIGINT, sighandler);
+	bmachine.out = stdout;
+	bmachine.err = stderr;
+}
+
+/* Where the machine writes its output and its error messages */
+void
+bmachine_setio(FILE *out, FILE *err)
+{
+	bmachine.out = out;
+	bmachine.err = err;
+}
+
+/* warnx(3), to the error stream of the machine */
+void
+bwarnx(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void)fprintf(bmachine.err, "%s: ", __progname);
+	(void)vfprintf(bmachine.err, fmt, ap);
+	(void)putc('\n', bmachine.err);
+	va_end(ap);
 }
 
 u_int
@@ -270,12 +446,274 @@ bmachine_scale(void)
 	return bmachine.scale;
 }
 
+/* The largest array index that may be used */
+void
+bmachine_array_max(u_long max)
+{
+	max_array_index = max;
+}
+
+/* Same as receiving SIGINT; for bc(1) running dc in-process */
+void
+bmachine_interrupt(void)
+{
+	bmachine.interrupted = true;
+	par_interrupt();
+}
+
+/* Register idx of machine m, or NULL if it was never used */
+static __inline struct stack *
+reg_find(const struct bmachine *m, size_t idx)
+{
+	struct stack *page = m->reg[idx / REG_PAGE_SIZE];
+
+	return page == NULL ? NULL : &page[idx % REG_PAGE_SIZE];
+}
+
+/* Register idx of this thread's machine, allocating its page if needed */
+static __inline struct stack *
+reg_stack(size_t idx)
+{
+	struct stack	**page = &bmachine.reg[idx / REG_PAGE_SIZE];
+	size_t		i;
+
+	if (*page == NULL) {
+		*page = breallocarray(NULL, REG_PAGE_SIZE, sizeof(**page));
+		for (i = 0; i < REG_PAGE_SIZE; i++)
+			stack_init(&(*page)[i]);
+	}
+	return &(*page)[idx % REG_PAGE_SIZE];
+}
+
 /* Reset the things needed before processing a (new) file */
 void
 reset_bmachine(struct source *src)
 {
 	bmachine.readsp = 0;
 	bmachine.readstack[0] = *src;
+	bmachine.readstack[0].idle = 0;
+}
+
+/*
+ * Take the current stack, registers and bases as the state that
+ * bmachine_restore() returns to.  Called once, before the first job of
+ * a batch.
+ */
+const struct baseline *
+bmachine_mark(void)
+{
+	struct stack	*reg;
+	size_t		i;
+
+	if (baseline.marked)
+		return &baseline;
+	baseline.marked = true;
+	baseline.extended_regs = bmachine.extended_regs;
+	stack_init(&baseline.stack);
+	stack_copy(&baseline.stack, &bmachine.stack);
+	baseline.scale = bmachine.scale;
+	baseline.obase = bmachine.obase;
+	baseline.ibase = bmachine.ibase;
+
+	for (i = 0; i < bmachine.reg_array_size; i++) {
+		if ((reg = reg_find(&bmachine, i)) == NULL) {
+			i += REG_PAGE_SIZE - 1;
+			continue;
+		}
+		if (reg->sp == -1)
+			continue;
+		baseline.saved = breallocarray(baseline.saved,
+		    baseline.nsaved + 1, sizeof(*baseline.saved));
+		baseline.saved[baseline.nsaved].idx = i;
+		stack_init(&baseline.saved[baseline.nsaved].stack);
+		stack_copy(&baseline.saved[baseline.nsaved].stack, reg);
+		baseline.nsaved++;
+	}
+	baseline.dirty = calloc(bmachine.reg_array_size,
+	    sizeof(*baseline.dirty));
+	if (baseline.dirty == NULL)
+		err(1, NULL);
+	return &baseline;
+}
+
+/*
+ * Start a machine on this thread from the state marked on another, and
+ * mark it.  The other machine must not run meanwhile.
+ */
+void
+bmachine_start(const struct baseline *from)
+{
+	size_t i;
+
+	init_bmachine(from->extended_regs);
+	stack_copy_unshared(&bmachine.stack, &from->stack);
+	bmachine.scale = from->scale;
+	bmachine.obase = from->obase;
+	bmachine.ibase = from->ibase;
+	for (i = 0; i < from->nsaved; i++)
+		stack_copy_unshared(reg_stack(from->saved[i].idx),
+		    &from->saved[i].stack);
+	(void)bmachine_mark();
+}
+
+/*
+ * Go back to the state of bmachine_mark().  Only the registers written
+ * since are copied back, into the storage they already have.
+ */
+void
+bmachine_restore(void)
+{
+	struct saved_reg	key, *r;
+	size_t			i;
+	int			idx;
+
+	for (i = 0; i < baseline.ntouched; i++) {
+		idx = baseline.touched[i];
+		baseline.dirty[idx] = false;
+		key.idx = idx;
+		r = baseline.nsaved == 0 ? NULL : bsearch(&key,
+		    baseline.saved, baseline.nsaved, sizeof(*baseline.saved),
+		    saved_reg_cmp);
+		if (r != NULL)
+			stack_copy(reg_stack(idx), &r->stack);
+		else
+			stack_reset(reg_stack(idx));
+	}
+	baseline.ntouched = 0;
+
+	stack_copy(&bmachine.stack, &baseline.stack);
+	bmachine.scale = baseline.scale;
+	bmachine.obase = baseline.obase;
+	bmachine.ibase = baseline.ibase;
+	bmachine.interrupted = false;
+}
+
+/*
+ * Free this thread's machine and everything kept for it, before the
+ * thread exits.  The machine must not run again.
+ */
+void
+bmachine_end(void)
+{
+	struct constant	*c, *next;
+	struct stack	*page;
+	size_t		i, j;
+
+	for (i = 0; i < (bmachine.reg_array_size + REG_PAGE_SIZE - 1) /
+	    REG_PAGE_SIZE; i++) {
+		if ((page = bmachine.reg[i]) == NULL)
+			continue;
+		for (j = 0; j < REG_PAGE_SIZE; j++)
+			stack_clear(&page[j]);
+		free(page);
+	}
+	free(bmachine.reg);
+	stack_clear(&bmachine.stack);
+	free(bmachine.readstack);
+
+	stack_clear(&baseline.stack);
+	for (i = 0; i < baseline.nsaved; i++)
+		stack_clear(&baseline.saved[i].stack);
+	free(baseline.saved);
+	free(baseline.dirty);
+	free(baseline.touched);
+
+	for (i = 0; i < undo.nsaved; i++)
+		stack_clear(&undo.saved[i].stack);
+	free(undo.saved);
+	free(undo.level);
+
+	/* What is left is not referred to from anywhere now */
+	for (i = 0; i < constants.size; i++) {
+		for (c = constants.tab[i]; c != NULL; c = next) {
+			next = c->next;
+			free_number(c->num);
+			free(c);
+		}
+	}
+	free(constants.tab);
+
+	power_of_ten_free();
+	free_number_pool();
+	memset(&bmachine, 0, sizeof(bmachine));
+	memset(&baseline, 0, sizeof(baseline));
+	memset(&undo, 0, sizeof(undo));
+	memset(&constants, 0, sizeof(constants));
+}
+
+static int
+saved_reg_cmp(const void *a, const void *b)
+{
+	const struct saved_reg *ra = a, *rb = b;
+
+	return ra->idx < rb->idx ? -1 : ra->idx > rb->idx;
+}
+
+/* Note a register write, for bmachine_restore() and undo_end() */
+static __inline void
+touch_reg(int idx)
+{
+	if (undo.depth > 0 && undo.level[idx] != undo.depth)
+		undo_save(idx);
+	if (!baseline.marked || baseline.dirty[idx])
+		return;
+	if (baseline.ntouched == baseline.touched_sz) {
+		baseline.touched_sz = baseline.touched_sz * 2 + 16;
+		baseline.touched = breallocarray(baseline.touched,
+		    baseline.touched_sz, sizeof(*baseline.touched));
+	}
+	baseline.dirty[idx] = true;
+	baseline.touched[baseline.ntouched++] = idx;
+}
+
+/* Keep what register idx holds, to be put back by undo_end() */
+static void
+undo_save(int idx)
+{
+	struct undo_reg	*u;
+
+	if (undo.nsaved == undo.size) {
+		undo.size = undo.size * 2 + 16;
+		undo.saved = breallocarray(undo.saved, undo.size,
+		    sizeof(*undo.saved));
+	}
+	u = &undo.saved[undo.nsaved++];
+	u->idx = idx;
+	u->level = undo.level[idx];
+	stack_init(&u->stack);
+	stack_copy(&u->stack, reg_stack(idx));
+	undo.level[idx] = undo.depth;
+}
+
+/* Start saving the registers written; returns the mark for undo_end() */
+static size_t
+undo_begin(void)
+{
+	if (undo.level == NULL) {
+		undo.level = calloc(bmachine.reg_array_size,
+		    sizeof(*undo.level));
+		if (undo.level == NULL)
+			err(1, NULL);
+	}
+	undo.depth++;
+	return undo.nsaved;
+}
+
+/* Put back the registers written since undo_begin() returned mark */
+static void
+undo_end(size_t mark)
+{
+	struct undo_reg	*u;
+	struct stack	*r;
+
+	while (undo.nsaved > mark) {
+		u = &undo.saved[--undo.nsaved];
+		r = reg_stack(u->idx);
+		stack_clear(r);
+		*r = u->stack;
+		undo.level[u->idx] = u->level;
+	}
+	undo.depth--;
 }
 
 static __inline int
@@ -283,6 +721,9 @@ readch(void)
 {
 	struct source *src = &bmachine.readstack[bmachine.readsp];
 
+	/* Compiled code is the common case, avoid the indirect call */
+	if (src->vtable == &program_vtable)
+		return src_getcharprogram(src);
 	return src->vtable->readchar(src);
 }
 
@@ -310,6 +751,42 @@ src_free(void)
 	src->vtable->free(src);
 }
 
+/* The instruction being executed, or NULL when interpreting text */
+static __inline struct instr *
+cur_instr(void)
+{
+	struct source *src = &bmachine.readstack[bmachine.readsp];
+
+	if (src->vtable != &program_vtable)
+		return NULL;
+	return &src->u.code.prog->code[src->u.code.pc - 1];
+}
+
+/* The number of levels q, Q and J can leave */
+static size_t
+read_depth(void)
+{
+	size_t i, depth = bmachine.readsp;
+
+	for (i = 1; i <= bmachine.readsp; i++)
+		depth += bmachine.readstack[i].idle;
+	return depth;
+}
+
+/* Leave one level; what is left of an idle caller is its end */
+static void
+pop_level(void)
+{
+	struct source *src = &bmachine.readstack[bmachine.readsp];
+
+	src_free();
+	if (src->idle > 0) {
+		src_setstring(src, bstrdup(""));
+		src->idle--;
+	} else
+		bmachine.readsp--;
+}
+
 #ifdef DEBUGGING
 void
 pn(const char *str, const struct number *n)
@@ -346,6 +823,64 @@ static unsigned long factors[] = {
 	100000000, 1000000000
 };
 
+#define POW10_DIRECT	1024	/* 10^k for smaller k are all kept */
+#define POW10_SLOTS	16	/* larger ones are direct mapped */
+
+static __thread struct {
+	mpz_t	direct[POW10_DIRECT];
+	bool	have[POW10_DIRECT];
+	struct {
+		mpz_t	pow;
+		u_int	k;
+		bool	used;
+	} slot[POW10_SLOTS];
+} pow10;
+
+/*
+ * Powers of ten, computed when first asked for.  The result is valid
+ * until the next call on the same thread, as an entry for
+ * k >= POW10_DIRECT may be replaced by another power that maps to the
+ * same slot.
+ */
+mpz_srcptr
+power_of_ten(u_int k)
+{
+	size_t	i;
+
+	if (k < POW10_DIRECT) {
+		if (!pow10.have[k]) {
+			mpz_init(pow10.direct[k]);
+			mpz_ui_pow_ui(pow10.direct[k], 10, k);
+			pow10.have[k] = true;
+		}
+		return pow10.direct[k];
+	}
+	i = k % POW10_SLOTS;
+	if (!pow10.slot[i].used) {
+		mpz_init(pow10.slot[i].pow);
+		pow10.slot[i].used = true;
+	} else if (pow10.slot[i].k == k)
+		return pow10.slot[i].pow;
+	mpz_ui_pow_ui(pow10.slot[i].pow, 10, k);
+	pow10.slot[i].k = k;
+	return pow10.slot[i].pow;
+}
+
+/* Free the powers of ten kept for this thread */
+static void
+power_of_ten_free(void)
+{
+	size_t	i;
+
+	for (i = 0; i < POW10_DIRECT; i++)
+		if (pow10.have[i])
+			mpz_clear(pow10.direct[i]);
+	for (i = 0; i < POW10_SLOTS; i++)
+		if (pow10.slot[i].used)
+			mpz_clear(pow10.slot[i].pow);
+	memset(&pow10, 0, sizeof(pow10));
+}
+
 void
 scale_number(mpz_t n, int s)
 {
@@ -361,18 +896,30 @@ scale_number(mpz_t n, int s)
 			mpz_mul_si(n, n, factors[abs_scale]);
 		else
 			(void)mpz_tdiv_q_ui(n, n, factors[abs_scale]);
-	} else {
-		mpz_t a;
+	} else if (s > 0)
+		mpz_mul(n, n, power_of_ten(abs_scale));
+	else
+		mpz_tdiv_q(n, n, power_of_ten(abs_scale));
+}
 
-		mpz_init(a);
+/* r += n * 10^s, without scaling n itself */
+static void
+add_scaled(mpz_t r, const mpz_t n, u_int s)
+{
+	if (s < nitems(factors))
+		mpz_addmul_ui(r, n, factors[s]);
+	else
+		mpz_addmul(r, n, power_of_ten(s));
+}
 
-		mpz_ui_pow_ui(a, 10, abs_scale);
-		if (s > 0)
-			mpz_mul(n, n, a);
-		else
-			mpz_tdiv_q(n, n, a);
-		mpz_clear(a);
-	}
+/* r -= n * 10^s, without scaling n itself */
+static void
+sub_scaled(mpz_t r, const mpz_t n, u_int s)
+{
+	if (s < nitems(factors))
+		mpz_submul_ui(r, n, factors[s]);
+	else
+		mpz_submul(r, n, power_of_ten(s));
 }
 
 void
@@ -389,18 +936,10 @@ split_number(const struct number *n, mpz_t i, mpz_t f)
 		rem = mpz_tdiv_q_ui(i, i, factors[n->scale]);
 		if (f != NULL)
 			mpz_set_ui(f, rem);
-	} else {
-		mpz_t a;
-
-		mpz_init(a);
-
-		mpz_ui_pow_ui(a, 10, n->scale);
-		if (f != NULL)
-			mpz_tdiv_qr(i, f, n->number, a);
-		else
-			mpz_tdiv_q(i, n->number, a);
-		mpz_clear(a);
-	}
+	} else if (f != NULL)
+		mpz_tdiv_qr(i, f, n->number, power_of_ten(n->scale));
+	else
+		mpz_tdiv_q(i, n->number, power_of_ten(n->scale));
 }
 
 void
@@ -430,7 +969,7 @@ push_number(struct number *n)
 }
 
 static __inline void
-push_string(char *string)
+push_string(struct string *string)
 {
 	stack_pushstring(&bmachine.stack, string);
 }
@@ -459,7 +998,7 @@ pop_number(void)
 	return stack_popnumber(&bmachine.stack);
 }
 
-static __inline char *
+static __inline struct string *
 pop_string(void)
 {
 	return stack_popstring(&bmachine.stack);
@@ -474,7 +1013,7 @@ clear_stack(void)
 static void
 print_stack(void)
 {
-	stack_print(stdout, &bmachine.stack, "", bmachine.obase);
+	stack_print(bmachine.out, &bmachine.stack, "", bmachine.obase);
 }
 
 static void
@@ -482,10 +1021,10 @@ print_tos(void)
 {
 	struct value *value = tos();
 	if (value != NULL) {
-		print_value(stdout, value, "", bmachine.obase);
-		(void)putchar('\n');
+		print_value(bmachine.out, value, "", bmachine.obase);
+		(void)putc('\n', bmachine.out);
 	} else
-		warnx("stack empty");
+		bwarnx("stack empty");
 }
 
 static void
@@ -493,10 +1032,10 @@ print_err(void)
 {
 	struct value *value = tos();
 	if (value != NULL) {
-		print_value(stderr, value, "", bmachine.obase);
-		(void)putc('\n', stderr);
+		print_value(bmachine.err, value, "", bmachine.obase);
+		(void)putc('\n', bmachine.err);
 	} else
-		warnx("stack empty");
+		bwarnx("stack empty");
 }
 
 static void
@@ -505,17 +1044,18 @@ pop_print(void)
 	struct value *value = pop();
 
 	if (value != NULL) {
+		value_unword(value);
 		switch (value->type) {
 		case BCODE_NONE:
 			break;
 		case BCODE_NUMBER:
-			normalize(value->u.num, 0);
-			print_ascii(stdout, value->u.num);
-			(void)fflush(stdout);
+			normalize(&value->u.num, 0);
+			print_ascii(bmachine.out, &value->u.num);
+			(void)fflush(bmachine.out);
 			break;
 		case BCODE_STRING:
-			(void)fputs(value->u.string, stdout);
-			(void)fflush(stdout);
+			(void)fputs(value->u.string->str, bmachine.out);
+			(void)fflush(bmachine.out);
 			break;
 		}
 		stack_free_value(value);
@@ -528,8 +1068,8 @@ pop_printn(void)
 	struct value *value = pop();
 
 	if (value != NULL) {
-		print_value(stdout, value, "", bmachine.obase);
-		(void)fflush(stdout);
+		print_value(bmachine.out, value, "", bmachine.obase);
+		(void)fflush(bmachine.out);
 		stack_free_value(value);
 	}
 }
@@ -573,13 +1113,13 @@ set_scale(void)
 	n = pop_number();
 	if (n != NULL) {
 		if (-1 == mpz_sgn(n->number))
-			warnx("scale must be a nonnegative number");
+			bwarnx("scale must be a nonnegative number");
 		else {
 			scale = get_ulong(n);
 			if (scale != GMP_NUMB_MASK && scale <= UINT_MAX)
 				bmachine.scale = (u_int)scale;
 			else
-				warnx("scale too large");
+				bwarnx("scale too large");
 		}
 		free_number(n);
 	}
@@ -607,7 +1147,7 @@ set_obase(void)
 		if (base != GMP_NUMB_MASK && base > 1 && base <= UINT_MAX)
 			bmachine.obase = (u_int)base;
 		else
-			warnx("output base must be a number greater than 1");
+			bwarnx("output base must be a number greater than 1");
 		free_number(n);
 	}
 }
@@ -634,7 +1174,7 @@ set_ibase(void)
 		if (base != GMP_NUMB_MASK && 2 <= base && base <= 16)
 			bmachine.ibase = (u_int)base;
 		else
-			warnx("input base must be a number between 2 and 16 "
+			bwarnx("input base must be a number between 2 and 16 "
 			    "(inclusive)");
 		free_number(n);
 	}
@@ -661,11 +1201,12 @@ push_scale(void)
 
 	value = pop();
 	if (value != NULL) {
+		value_unword(value);
 		switch (value->type) {
 		case BCODE_NONE:
 			return;
 		case BCODE_NUMBER:
-			scale = value->u.num->scale;
+			scale = value->u.num.scale;
 			break;
 		case BCODE_STRING:
 			break;
@@ -677,10 +1218,10 @@ push_scale(void)
 	}
 }
 
-static u_int
+u_int
 count_digits(const struct number *n)
 {
-	mpz_t		int_part, a;
+	mpz_t		int_part;
 	uint		d;
 	const uint64_t	c = 1292913986; /* floor(2^32 * log_10(2)) */
 	int		bits;
@@ -704,14 +1245,8 @@ count_digits(const struct number *n)
 
 		/* If close to a possible rounding error fix if needed */
 		if (d != (c * (bits - 1)) >> 32) {
-			mpz_init(a);
-
-			mpz_ui_pow_ui(a, 10, d);
-
-			if (mpz_cmpabs(int_part, a) >= 0)
+			if (mpz_cmpabs(int_part, power_of_ten(d)) >= 0)
 				d++;
-
-			mpz_clear(a);
 		} else
 			d++;
 	}
@@ -730,16 +1265,17 @@ num_digits(void)
 
 	value = pop();
 	if (value != NULL) {
+		value_unword(value);
 		switch (value->type) {
 		case BCODE_NONE:
 			return;
 		case BCODE_NUMBER:
-			digits = count_digits(value->u.num);
+			digits = count_digits(&value->u.num);
 			n = new_number();
 			mpz_set_ui(n->number, digits);
 			break;
 		case BCODE_STRING:
-			digits = strlen(value->u.string);
+			digits = strlen(value->u.string->str);
 			n = new_number();
 			mpz_set_ui(n->number, digits);
 			break;
@@ -758,21 +1294,22 @@ to_ascii(void)
 
 	value = pop();
 	if (value != NULL) {
+		value_unword(value);
 		str[1] = '\0';
 		switch (value->type) {
 		case BCODE_NONE:
 			return;
 		case BCODE_NUMBER:
-			n = value->u.num;
+			n = &value->u.num;
 			normalize(n, 0);
 			str[0] = (char)mpz_get_ui(n->number);
 			break;
 		case BCODE_STRING:
-			str[0] = value->u.string[0];
+			str[0] = value->u.string->str[0];
 			break;
 		}
 		stack_free_value(value);
-		push_string(bstrdup(str));
+		push_string(string_new(str, strlen(str)));
 	}
 }
 
@@ -780,19 +1317,24 @@ static int
 readreg(void)
 {
 	int idx, ch1, ch2;
+	struct instr *in;
+
+	/* Decoded once, by program_compile() */
+	if ((in = cur_instr()) != NULL)
+		return in->u.reg;
 
 	idx = readch();
 	if (idx == 0xff && bmachine.extended_regs) {
 		ch1 = readch();
 		ch2 = readch();
 		if (ch1 == EOF || ch2 == EOF) {
-			warnx("unexpected eof");
+			bwarnx("unexpected eof");
 			idx = -1;
 		} else
 			idx = (ch1 << 8) + ch2 + UCHAR_MAX + 1;
 	}
 	if (idx < 0 || idx >= bmachine.reg_array_size) {
-		warnx("internal error: reg num = %d", idx);
+		bwarnx("internal error: reg num = %d", idx);
 		idx = -1;
 	}
 	return idx;
@@ -802,12 +1344,14 @@ static void
 load(void)
 {
 	int		idx;
+	struct stack	*stack;
 	struct value	*v, copy;
 	struct number	*n;
 
 	idx = readreg();
 	if (idx >= 0) {
-		v = stack_tos(&bmachine.reg[idx]);
+		stack = reg_find(&bmachine, idx);
+		v = stack == NULL ? NULL : stack_tos(stack);
 		if (v == NULL) {
 			n = new_number(); /* Always initialized to zero. */
 			push_number(n);
@@ -828,7 +1372,8 @@ store(void)
 		if (val == NULL) {
 			return;
 		}
-		stack_set_tos(&bmachine.reg[idx], val);
+		touch_reg(idx);
+		stack_set_tos(reg_stack(idx), val);
 	}
 }
 
@@ -841,7 +1386,8 @@ load_stack(void)
 
 	idx = readreg();
 	if (idx >= 0) {
-		stack = &bmachine.reg[idx];
+		stack = reg_stack(idx);
+		touch_reg(idx);
 		value = NULL;
 		if (stack_size(stack) > 0) {
 			value = stack_pop(stack);
@@ -849,7 +1395,7 @@ load_stack(void)
 		if (value != NULL)
 			push(value);
 		else
-			warnx("stack register '%c' (0%o) is empty",
+			bwarnx("stack register '%c' (0%o) is empty",
 			    idx, idx);
 	}
 }
@@ -865,80 +1411,104 @@ store_stack(void)
 		value = pop();
 		if (value == NULL)
 			return;
-		stack_push(&bmachine.reg[idx], value);
+		touch_reg(idx);
+		stack_push(reg_stack(idx), value);
 	}
 }
 
+/* Pop an array index, as its sign and value; false if not a number */
+static bool
+pop_index(int *sign, u_long *idx)
+{
+	struct value	*v = tos();
+	struct number	*n;
+
+	if (v != NULL && v->type == BCODE_NUMBER && v->in_word &&
+	    v->array == NULL) {
+		*sign = v->u.word < 0 ? -1 : v->u.word > 0;
+		*idx = v->u.word;
+		(void)pop();
+		return true;
+	}
+	if ((n = pop_number()) == NULL)
+		return false;
+	*idx = get_ulong(n);
+	*sign = mpz_sgn(n->number);
+	free_number(n);
+	return true;
+}
+
 static void
 load_array(void)
 {
-	int			reg;
-	struct number		*inumber, *n;
+	int			reg, sign;
+	struct number		*n;
 	u_long			idx;
 	struct stack		*stack;
 	struct value		*v, copy;
 
 	reg = readreg();
 	if (reg >= 0) {
-		inumber = pop_number();
-		if (inumber == NULL)
+		if (!pop_index(&sign, &idx))
 			return;
-		idx = get_ulong(inumber);
-		if (-1 == mpz_sgn(inumber->number))
-			warnx("negative idx");
-		else if (idx == GMP_NUMB_MASK || idx > MAX_ARRAY_INDEX)
-			warnx("idx too big");
+		if (sign == -1)
+			bwarnx("negative idx");
+		else if (idx == GMP_NUMB_MASK || idx > max_array_index)
+			bwarnx("idx too big");
 		else {
-			stack = &bmachine.reg[reg];
-			v = frame_retrieve(stack, idx);
+			stack = reg_find(&bmachine, reg);
+			v = stack == NULL ? NULL : frame_retrieve(stack, idx);
 			if (v == NULL || v->type == BCODE_NONE) {
 				n = new_number(); /* Always initialized to zero. */
 				push_number(n);
 			} else
 				push(stack_dup_value(v, &copy));
 		}
-		free_number(inumber);
 	}
 }
 
 static void
 store_array(void)
 {
-	int			reg;
-	struct number		*inumber;
+	int			reg, sign;
 	u_long			idx;
 	struct value		*value;
 	struct stack		*stack;
 
 	reg = readreg();
 	if (reg >= 0) {
-		inumber = pop_number();
-		if (inumber == NULL)
+		if (!pop_index(&sign, &idx))
 			return;
 		value = pop();
-		if (value == NULL) {
-			free_number(inumber);
+		if (value == NULL)
 			return;
-		}
-		idx = get_ulong(inumber);
-		if (-1 == mpz_sgn(inumber->number)) {
-			warnx("negative idx");
+		if (sign == -1) {
+			bwarnx("negative idx");
 			stack_free_value(value);
-		} else if (idx == GMP_NUMB_MASK || idx > MAX_ARRAY_INDEX) {
-			warnx("idx too big");
+		} else if (idx == GMP_NUMB_MASK || idx > max_array_index) {
+			bwarnx("idx too big");
 			stack_free_value(value);
 		} else {
-			stack = &bmachine.reg[reg];
+			stack = reg_stack(reg);
+			touch_reg(reg);
 			frame_assign(stack, idx, value);
 		}
-		free_number(inumber);
 	}
 }
 
 static void
 push_line(void)
 {
-	push_string(read_string(&bmachine.readstack[bmachine.readsp]));
+	struct instr	*in;
+	char		*p;
+
+	if ((in = cur_instr()) != NULL)
+		push_string(string_ref(in->u.string));
+	else {
+		p = read_string(&bmachine.readstack[bmachine.readsp]);
+		push_string(string_new(p, strlen(p)));
+		free(p);
+	}
 }
 
 static void
@@ -951,46 +1521,52 @@ static void
 badd(void)
 {
 	struct number	*a, *b;
+	long		*wa, *wb, w;
 
-	a = pop_number();
-	if (a == NULL)
-		return;
-	b = pop_number();
-	if (b == NULL) {
-		push_number(a);
+	if (stack_words(&bmachine.stack, &wa, &wb) &&
+	    !__builtin_add_overflow(*wb, *wa, &w)) {
+		*wb = w;
+		stack_dropnumber(&bmachine.stack);
 		return;
 	}
+	if (!stack_binop(&bmachine.stack, &a, &b))
+		return;
 
 	if (b->scale > a->scale)
-		normalize(a, b->scale);
-	else if (a->scale > b->scale)
-		normalize(b, a->scale);
-	mpz_add(b->number, a->number, b->number);
-	free_number(a);
-	push_number(b);
+		add_scaled(b->number, a->number, b->scale - a->scale);
+	else {
+		if (a->scale > b->scale)
+			normalize(b, a->scale);
+		mpz_add(b->number, b->number, a->number);
+	}
+	stack_dropnumber(&bmachine.stack);
+	value_word(tos());
 }
 
 static void
 bsub(void)
 {
 	struct number	*a, *b;
+	long		*wa, *wb, w;
 
-	a = pop_number();
-	if (a == NULL)
-		return;
-	b = pop_number();
-	if (b == NULL) {
-		push_number(a);
+	if (stack_words(&bmachine.stack, &wa, &wb) &&
+	    !__builtin_sub_overflow(*wb, *wa, &w)) {
+		*wb = w;
+		stack_dropnumber(&bmachine.stack);
 		return;
 	}
+	if (!stack_binop(&bmachine.stack, &a, &b))
+		return;
 
 	if (b->scale > a->scale)
-		normalize(a, b->scale);
-	else if (a->scale > b->scale)
-		normalize(b, a->scale);
-	mpz_sub(b->number, b->number, a->number);
-	free_number(a);
-	push_number(b);
+		sub_scaled(b->number, a->number, b->scale - a->scale);
+	else {
+		if (a->scale > b->scale)
+			normalize(b, a->scale);
+		mpz_sub(b->number, b->number, a->number);
+	}
+	stack_dropnumber(&bmachine.stack);
+	value_word(tos());
 }
 
 void
@@ -1012,122 +1588,145 @@ static void
 bmul(void)
 {
 	struct number	*a, *b;
+	long		*wa, *wb, w;
 
-	a = pop_number();
-	if (a == NULL)
-		return;
-	b = pop_number();
-	if (b == NULL) {
-		push_number(a);
+	if (stack_words(&bmachine.stack, &wa, &wb) &&
+	    !__builtin_mul_overflow(*wb, *wa, &w)) {
+		*wb = w;
+		stack_dropnumber(&bmachine.stack);
 		return;
 	}
+	if (!stack_binop(&bmachine.stack, &a, &b))
+		return;
 
 	bmul_number(b, a, b, bmachine.scale);
-	free_number(a);
-	push_number(b);
+	stack_dropnumber(&bmachine.stack);
+	value_word(tos());
 }
 
 static void
 bdiv(void)
 {
 	struct number	*a, *b;
-	struct number	*r;
 	u_int		scale;
+	long		*wa, *wb;
 
-	a = pop_number();
-	if (a == NULL)
-		return;
-	b = pop_number();
-	if (b == NULL) {
-		push_number(a);
+	/* C division truncates, as mpz_tdiv_q() */
+	if (bmachine.scale == 0 && stack_words(&bmachine.stack, &wa, &wb) &&
+	    *wa != 0 && !(*wa == -1 && *wb == LONG_MIN)) {
+		*wb /= *wa;
+		stack_dropnumber(&bmachine.stack);
 		return;
 	}
+	if (!stack_binop(&bmachine.stack, &a, &b))
+		return;
 
-	r = new_number();
-	r->scale = bmachine.scale;
 	scale = max(a->scale, b->scale);
 
-	if (0 == mpz_sgn(a->number))
-		warnx("divide by zero");
-	else {
+	if (0 == mpz_sgn(a->number)) {
+		bwarnx("divide by zero");
+		mpz_set_ui(b->number, 0);
+	} else {
 		normalize(a, scale);
-		normalize(b, scale + r->scale);
+		normalize(b, scale + bmachine.scale);
 
-		mpz_tdiv_q(r->number, b->number, a->number);
+		mpz_tdiv_q(b->number, b->number, a->number);
 	}
-	push_number(r);
-	free_number(a);
-	free_number(b);
+	b->scale = bmachine.scale;
+	stack_dropnumber(&bmachine.stack);
 }
 
 static void
 bmod(void)
 {
 	struct number	*a, *b;
-	struct number	*r;
-	u_int		scale;
+	u_int		scale, rscale;
+	long		*wa, *wb;
 
-	a = pop_number();
-	if (a == NULL)
-		return;
-	b = pop_number();
-	if (b == NULL) {
-		push_number(a);
+	if (bmachine.scale == 0 && stack_words(&bmachine.stack, &wa, &wb) &&
+	    *wa != 0 && *wa != -1) {
+		*wb %= *wa;
+		stack_dropnumber(&bmachine.stack);
 		return;
 	}
+	if (!stack_binop(&bmachine.stack, &a, &b))
+		return;
 
-	r = new_number();
 	scale = max(a->scale, b->scale);
-	r->scale = max(b->scale, a->scale + bmachine.scale);
+	rscale = max(b->scale, a->scale + bmachine.scale);
 
-	if (0 == mpz_sgn(a->number))
-		warnx("remainder by zero");
-	else {
+	if (0 == mpz_sgn(a->number)) {
+		bwarnx("remainder by zero");
+		mpz_set_ui(b->number, 0);
+	} else {
 		normalize(a, scale);
 		normalize(b, scale + bmachine.scale);
 
-		mpz_tdiv_r(r->number, b->number, a->number);
+		mpz_tdiv_r(b->number, b->number, a->number);
 	}
-	push_number(r);
-	free_number(a);
-	free_number(b);
+	b->scale = rscale;
+	stack_dropnumber(&bmachine.stack);
 }
 
 static void
 bdivmod(void)
 {
 	struct number	*a, *b;
-	struct number	*rdiv, *rmod;
-	u_int		scale;
+	u_int		scale, rscale;
 
-	a = pop_number();
-	if (a == NULL)
+	if (!stack_binop(&bmachine.stack, &a, &b))
 		return;
-	b = pop_number();
-	if (b == NULL) {
-		push_number(a);
-		return;
-	}
 
-	rdiv = new_number();
-	rmod = new_number();
-	rdiv->scale = bmachine.scale;
-	rmod->scale = max(b->scale, a->scale + bmachine.scale);
 	scale = max(a->scale, b->scale);
+	rscale = max(b->scale, a->scale + bmachine.scale);
 
-	if (0 == mpz_sgn(a->number))
-		warnx("divide by zero");
-	else {
+	/* The quotient replaces b and the remainder a */
+	if (0 == mpz_sgn(a->number)) {
+		bwarnx("divide by zero");
+		mpz_set_ui(b->number, 0);
+	} else {
 		normalize(a, scale);
 		normalize(b, scale + bmachine.scale);
 
-		mpz_tdiv_qr(rdiv->number, rmod->number,
-		    b->number, a->number);
+		mpz_tdiv_qr(b->number, a->number, b->number, a->number);
 	}
-	push_number(rdiv);
-	push_number(rmod);
-	free_number(a);
-	free_number(b);
+	b->scale = bmachine.scale;
+	a->scale = rscale;
+}
+
+/*
+ * r = a^p exactly, for p >= 0, with scale a->scale * p.  Returns false
+ * if the result, or the power of ten that rescales it, would have more
+ * than MAX_POW_BITS bits; for a base of 0 or +-1 it always fits.
+ */
+static bool
+pow_number(struct number *r, const struct number *a, mpz_srcptr p)
+{
+	u_long	b;
+	size_t	bits;
+
+	r->scale = 0;
+	if (mpz_fits_ulong_p(p)) {
+		b = mpz_get_ui(p);
+		bits = mpz_sizeinbase(a->number, 2);
+		/* log2(10) < 3.33 */
+		if ((a->scale == 0 || b <= UINT_MAX / a->scale) &&
+		    (double)b * (bits + 3.33 * a->scale) <= MAX_POW_BITS) {
+			mpz_pow_ui(r->number, a->number, b);
+			r->scale = a->scale * (u_int)b;
+			return true;
+		}
+	}
+	if (0 == mpz_sgn(a->number)) {
+		mpz_set_ui(r->number, 0);
+		return true;
+	}
+	if (0 == mpz_cmpabs(a->number, power_of_ten(a->scale))) {
+		mpz_set_si(r->number, mpz_sgn(a->number) < 0 &&
+		    mpz_odd_p(p) ? -1 : 1);
+		return true;
+	}
+	return false;
 }
 
 static void
@@ -1136,7 +1735,7 @@ bexp(void)
 	struct number	*a, *p;
 	struct number	*r;
 	bool		neg;
-	u_int		rscale;
+	u_int		rscale, m;
 
 	p = pop_number();
 	if (p == NULL)
@@ -1153,7 +1752,7 @@ bexp(void)
 		mpz_init(f);
 		split_number(p, i, f);
 		if (0 != mpz_sgn(f))
-			warnx("Runtime warning: non-zero fractional part "
+			bwarnx("Runtime warning: non-zero fractional part "
 			    "in exponent");
 		mpz_set(p->number, i);
 		mpz_clear(f);
@@ -1166,64 +1765,151 @@ bexp(void)
 		rscale = bmachine.scale;
 	} else {
 		/* Posix bc says min(a.scale * b, max(a.scale, scale)) */
-		u_long	b;
-		u_int	m;
-
-		b = mpz_get_ui(p->number); /* BUG : b is expected to be ~0 if number > MAX_UINT */
 		m = max(a->scale, bmachine.scale);
-		rscale = a->scale * (u_int)b;
-		if (rscale > m || (a->scale > 0 && (b == GMP_NUMB_MASK ||
-		    b > UINT_MAX)))
+		if (a->scale == 0)
+			rscale = 0;
+		else if (mpz_cmp_ui(p->number, m / a->scale) <= 0)
+			rscale = a->scale * (u_int)mpz_get_ui(p->number);
+		else
 			rscale = m;
 	}
 
-	if (0 == mpz_sgn(p->number)) {
-		r = new_number();
-		mpz_set_ui(r->number, 1U);
+	/* The power is exact; only the result is truncated */
+	r = new_number();
+	if (!pow_number(r, a, p->number)) {
+		bwarnx("exponent too large");
+		mpz_set_ui(r->number, 0);
+		r->scale = rscale;
+	} else if (neg) {
+		mpz_t	one;
+
+		mpz_init_set_ui(one, 1);
+		scale_number(one, r->scale + rscale);
+
+		if (0 == mpz_sgn(r->number))
+			bwarnx("divide by zero");
+		else
+			mpz_tdiv_q(r->number, one, r->number);
+		mpz_clear(one);
+		r->scale = rscale;
+	} else
 		normalize(r, rscale);
-	} else {
-		u_int ascale, mscale;
-
-		ascale = a->scale;
-		while (!mpz_tstbit(p->number, 0)) {
-			ascale *= 2;
-			bmul_number(a, a, a, ascale);
-			mpz_tdiv_q_2exp(p->number, p->number, 1);
-		}
+	push_number(r);
+	free_number(a);
+	free_number(p);
+}
 
-		r = dup_number(a);
-		mpz_tdiv_q_2exp(p->number, p->number, 1);
+/*
+ * a b m |: a^b % m.  With integer operands this is mpz_powm(); other
+ * operands get ^ and % one after the other.
+ */
+static void
+bmodexp(void)
+{
+	struct number	*a, *p, *m;
+	bool		neg;
 
-		mscale = ascale;
-		while (0 != mpz_sgn(p->number)) {
-			ascale *= 2;
-			bmul_number(a, a, a, ascale);
-			if (mpz_tstbit(p->number, 0)) {
-				mscale += ascale;
-				bmul_number(r, r, a, mscale);
-			}
-			mpz_tdiv_q_2exp(p->number, p->number, 1);
-		}
+	m = pop_number();
+	if (m == NULL)
+		return;
+	p = pop_number();
+	if (p == NULL) {
+		push_number(m);
+		return;
+	}
+	a = pop_number();
+	if (a == NULL) {
+		push_number(p);
+		push_number(m);
+		return;
+	}
+	if (a->scale != 0 || p->scale != 0 || m->scale != 0 ||
+	    mpz_sgn(p->number) < 0 || mpz_sgn(m->number) == 0) {
+		push_number(a);
+		push_number(p);
+		bexp();
+		push_number(m);
+		bmod();
+		return;
+	}
 
-		if (neg) {
-			mpz_t	one;
+	/* mpz_powm() gives the least residue; % goes by the sign of a^b */
+	neg = mpz_sgn(a->number) < 0 && mpz_odd_p(p->number);
+	mpz_abs(m->number, m->number);
+	mpz_powm(a->number, a->number, p->number, m->number);
+	if (neg && mpz_sgn(a->number) != 0)
+		mpz_sub(a->number, a->number, m->number);
+	if (bmachine.scale != 0) {
+		normalize(a, bmachine.scale);
+		mpz_tdiv_r(a->number, a->number, m->number);
+	}
+	push_number(a);
+	free_number(p);
+	free_number(m);
+}
 
-			mpz_init_set_ui(one, 1);
-			scale_number(one, r->scale + rscale);
+/*
+ * a b c m m: (a*b + c) % m, without the round trips of the product and
+ * the sum through the stack.
+ */
+static void
+bmuladdmod(void)
+{
+	struct number	*a, *b, *c, *m;
 
-			if (0 == mpz_sgn(r->number))
-				warnx("divide by zero");
-			else
-				mpz_tdiv_q(r->number, one,
-				    r->number);
-			mpz_clear(one);
-			r->scale = rscale;
-		} else
-			normalize(r, rscale);
+	m = pop_number();
+	if (m == NULL)
+		return;
+	c = pop_number();
+	if (c == NULL) {
+		push_number(m);
+		return;
 	}
-	push_number(r);
-	free_number(a);
-	free_number(p);
+	b = pop_number();
+	if (b == NULL) {
+		push_number(c);
+		push_number(m);
+		return;
+	}
+	a = pop_number();
+	if (a == NULL) {
+		push_number(b);
+		push_number(c);
+		push_number(m);
+		return;
+	}
+	if (a->scale == 0 && b->scale == 0 && c->scale == 0 &&
+	    m->scale == 0 && mpz_sgn(m->number) != 0) {
+		mpz_addmul(c->number, a->number, b->number);
+		if (bmachine.scale != 0)
+			normalize(c, bmachine.scale);
+		mpz_tdiv_r(c->number, c->number, m->number);
+		push_number(c);
+		free_number(a);
+		free_number(b);
+		free_number(m);
+		return;
+	}
+	push_number(a);
+	push_number(b);
+	bmul();
+	push_number(c);
+	badd();
+	push_number(m);
+	bmod();
+}
+
+/*
+ * r = sqrt(n), n > 0, to max(scale, n->scale) digits; n is rescaled.
+ * The root is truncated, as mpz_sqrt() does.
+ */
+void
+sqrt_number(struct number *r, struct number *n, u_int scale)
+{
+	scale = max(scale, n->scale);
+	normalize(n, 2*scale);
+	mpz_sqrt(r->number, n->number);
+	r->scale = scale;
 }
 
 static void
@@ -1231,10 +1917,7 @@ bsqrt(void)
 {
 	struct number	*n;
 	struct number	*r;
-	mpz_t		x, y, t, o;
-	u_int		scale, onecount;
 
-	onecount = 0;
 	n = pop_number();
 	if (n == NULL)
 		return;
@@ -1242,38 +1925,77 @@ bsqrt(void)
 		r = new_number();
 		push_number(r);
 	} else if (-1 == mpz_sgn(n->number))
-		warnx("square root of negative number");
+		bwarnx("square root of negative number");
 	else {
-		scale = max(bmachine.scale, n->scale);
-		normalize(n, 2*scale);
-		mpz_init_set(x, n->number);
-		mpz_init(y);
-		mpz_init(t);
-		mpz_init_set_ui(o, 1U);
-		mpz_tdiv_q_2exp(x, x, mpz_sizeinbase(x, 2)/2);
-		do {
-			mpz_tdiv_q(y, n->number, x);
-			mpz_add(y, x, y);
-			mpz_tdiv_q_2exp(y, y, 1);
-			mpz_sub(x, y, x);
-			mpz_set(t, x);
-			mpz_set(x, y);
-			mpz_set(y, t);
-		} while ((0 != mpz_sgn(y)) && (onecount += (0 == mpz_cmp(y, o)) ? 1 : 0) < 2);
-		mpz_sub(y, x, y);
 		r = new_number();
-		r->scale = scale;
-		mpz_set(r->number, y);
-		mpz_clear(x);
-		mpz_clear(y);
-		mpz_clear(t);
-		mpz_clear(o);
+		sqrt_number(r, n, bmachine.scale);
 		push_number(r);
 	}
 
 	free_number(n);
 }
 
+/* Replace the top of stack with a function of bc's math library */
+static void
+library_fn(struct number *(*f)(const struct number *, u_int))
+{
+	struct number	*n;
+
+	n = pop_number();
+	if (n == NULL)
+		return;
+	push_number(f(n, bmachine.scale));
+	free_number(n);
+}
+
+static void
+lib_e(void)
+{
+	library_fn(bc_e);
+}
+
+static void
+lib_l(void)
+{
+	library_fn(bc_l);
+}
+
+static void
+lib_s(void)
+{
+	library_fn(bc_s);
+}
+
+static void
+lib_c(void)
+{
+	library_fn(bc_c);
+}
+
+static void
+lib_a(void)
+{
+	library_fn(bc_a);
+}
+
+static void
+lib_j(void)
+{
+	struct number	*n, *x;
+
+	x = pop_number();
+	if (x == NULL)
+		return;
+	n = pop_number();
+	if (n == NULL) {
+		push_number(x);
+		return;
+	}
+	push_number(bc_j(n, x, bmachine.scale));
+	free_number(n);
+	free_number(x);
+}
+
 static void
 not(void)
 {
@@ -1296,58 +2018,40 @@ equal(void)
 static void
 equal_numbers(void)
 {
-	struct number *a, *b, *r;
+	struct number *a, *b;
 
-	a = pop_number();
-	if (a == NULL)
-		return;
-	b = pop_number();
-	if (b == NULL) {
-		push_number(a);
+	if (!stack_binop(&bmachine.stack, &a, &b))
 		return;
-	}
-	r = new_number();
-	mpz_set_ui(r->number,
+	mpz_set_ui(b->number,
 	    compare_numbers(BCODE_EQUAL, a, b) ? 1 : 0);
-	push_number(r);
+	b->scale = 0;
+	stack_dropnumber(&bmachine.stack);
 }
 
 static void
 less_numbers(void)
 {
-	struct number *a, *b, *r;
+	struct number *a, *b;
 
-	a = pop_number();
-	if (a == NULL)
-		return;
-	b = pop_number();
-	if (b == NULL) {
-		push_number(a);
+	if (!stack_binop(&bmachine.stack, &a, &b))
 		return;
-	}
-	r = new_number();
-	mpz_set_ui(r->number,
+	mpz_set_ui(b->number,
 	    compare_numbers(BCODE_LESS, a, b) ? 1 : 0);
-	push_number(r);
+	b->scale = 0;
+	stack_dropnumber(&bmachine.stack);
 }
 
 static void
 lesseq_numbers(void)
 {
-	struct number *a, *b, *r;
+	struct number *a, *b;
 
-	a = pop_number();
-	if (a == NULL)
+	if (!stack_binop(&bmachine.stack, &a, &b))
 		return;
-	b = pop_number();
-	if (b == NULL) {
-		push_number(a);
-		return;
-	}
-	r = new_number();
-	mpz_set_ui(r->number,
+	mpz_set_ui(b->number,
 	    compare_numbers(BCODE_NOT_GREATER, a, b) ? 1 : 0);
-	push_number(r);
+	b->scale = 0;
+	stack_dropnumber(&bmachine.stack);
 }
 
 static void
@@ -1371,7 +2075,7 @@ not_compare(void)
 		break;
 	default:
 		unreadch();
-		warnx("! command is deprecated");
+		bwarnx("! command is deprecated");
 		break;
 	}
 }
@@ -1382,24 +2086,58 @@ greater(void)
 	compare(BCODE_GREATER);
 }
 
+/*
+ * Compare a and b, with their scales aligned.  The one with the smaller
+ * scale is rescaled in place, but only if the sizes of the two do not
+ * already tell which is bigger.
+ */
+static int
+cmp_numbers(struct number *a, struct number *b)
+{
+	struct number	*s, *t;
+	mpz_srcptr	p;
+	size_t		bits, tbits;
+	int		sign, dir;
+
+	sign = mpz_sgn(a->number);
+	if (sign != mpz_sgn(b->number))
+		return sign - mpz_sgn(b->number);
+	if (sign == 0 || a->scale == b->scale)
+		return mpz_cmp(a->number, b->number);
+
+	/* Compare |s| * 10^k with |t|, then flip as needed */
+	if (a->scale < b->scale) {
+		s = a;
+		t = b;
+		dir = -sign;
+	} else {
+		s = b;
+		t = a;
+		dir = sign;
+	}
+	p = power_of_ten(t->scale - s->scale);
+	bits = mpz_sizeinbase(s->number, 2) + mpz_sizeinbase(p, 2);
+	tbits = mpz_sizeinbase(t->number, 2);
+	/* |s| * 10^k has bits - 1 or bits bits */
+	if (bits < tbits)
+		return dir;
+	if (bits - 1 > tbits)
+		return -dir;
+	mpz_mul(s->number, s->number, p);
+	s->scale = t->scale;
+	return mpz_cmp(a->number, b->number);
+}
+
 static bool
 compare_numbers(enum bcode_compare type, struct number *a, struct number *b)
 {
-	u_int	scale;
-	int	cmp;
-
-	scale = max(a->scale, b->scale);
-
-	if (scale > a->scale)
-		normalize(a, scale);
-	else if (scale > b->scale)
-		normalize(b, scale);
-
-	cmp = mpz_cmp(a->number, b->number);
-
-	free_number(a);
-	free_number(b);
+	return compare_result(type, cmp_numbers(a, b));
+}
 
+/* Whether a comparison of type holds, given <0, 0 or >0 */
+static bool
+compare_result(enum bcode_compare type, int cmp)
+{
 	switch (type) {
 	case BCODE_EQUAL:
 		return cmp == 0;
@@ -1422,7 +2160,9 @@ compare(enum bcode_compare type)
 {
 	int		idx, elseidx;
 	struct number	*a, *b;
+	long		*wa, *wb;
 	bool		ok;
+	struct stack	*stack;
 	struct value	*v;
 
 	elseidx = NO_ELSE;
@@ -1432,34 +2172,35 @@ compare(enum bcode_compare type)
 	else
 		unreadch();
 
-	a = pop_number();
-	if (a == NULL)
-		return;
-	b = pop_number();
-	if (b == NULL) {
-		push_number(a);
-		return;
+	if (stack_words(&bmachine.stack, &wa, &wb))
+		ok = compare_result(type, (*wa > *wb) - (*wa < *wb));
+	else {
+		if (!stack_binop(&bmachine.stack, &a, &b))
+			return;
+		ok = compare_numbers(type, a, b);
 	}
-
-	ok = compare_numbers(type, a, b);
+	stack_dropnumber(&bmachine.stack);
+	stack_dropnumber(&bmachine.stack);
 
 	if (!ok && elseidx != NO_ELSE)
 		idx = elseidx;
 
 	if (idx >= 0 && (ok || (!ok && elseidx != NO_ELSE))) {
-		v = stack_tos(&bmachine.reg[idx]);
+		stack = reg_find(&bmachine, idx);
+		v = stack == NULL ? NULL : stack_tos(stack);
 		if (v == NULL)
-			warnx("register '%c' (0%o) is empty", idx, idx);
+			bwarnx("register '%c' (0%o) is empty", idx, idx);
 		else {
 			switch(v->type) {
 			case BCODE_NONE:
-				warnx("register '%c' (0%o) is empty", idx, idx);
+				bwarnx("register '%c' (0%o) is empty", idx, idx);
 				break;
 			case BCODE_NUMBER:
-				warn("eval called with non-string argument");
+				bwarnx("eval called with non-string argument: %s",
+				    strerror(errno));
 				break;
 			case BCODE_STRING:
-				eval_string(bstrdup(v->u.string));
+				eval_value(v);
 				break;
 			}
 		}
@@ -1471,15 +2212,30 @@ nop(void)
 {
 }
 
+/* In a batch, end the job: drop all that is left to read */
+static void
+end_job(void)
+{
+	static char	empty[] = "";
+
+	while (bmachine.readsp > 0) {
+		src_free();
+		bmachine.readsp--;
+	}
+	src_setstring(&bmachine.readstack[0], empty);
+}
+
 static void
 quit(void)
 {
-	if (bmachine.readsp < 2)
+	if (read_depth() < 2 && baseline.marked) {
+		end_job();
+		return;
+	}
+	if (read_depth() < 2)
 		exit(0);
-	src_free();
-	bmachine.readsp--;
-	src_free();
-	bmachine.readsp--;
+	pop_level();
+	pop_level();
 }
 
 static void
@@ -1494,14 +2250,12 @@ quitN(void)
 	i = get_ulong(n);
 	free_number(n);
 	if (i == GMP_NUMB_MASK || i == 0)
-		warnx("Q command requires a number >= 1");
-	else if (bmachine.readsp < i)
-		warnx("Q command argument exceeded string execution depth");
+		bwarnx("Q command requires a number >= 1");
+	else if (read_depth() < i)
+		bwarnx("Q command argument exceeded string execution depth");
 	else {
-		while (i-- > 0) {
-			src_free();
-			bmachine.readsp--;
-		}
+		while (i-- > 0)
+			pop_level();
 	}
 }
 
@@ -1515,15 +2269,14 @@ skipN(void)
 	if (n == NULL)
 		return;
 	i = get_ulong(n);
+	free_number(n);
 	if (i == GMP_NUMB_MASK)
-		warnx("J command requires a number >= 0");
-	else if (i > 0 && bmachine.readsp < i)
-		warnx("J command argument exceeded string execution depth");
+		bwarnx("J command requires a number >= 0");
+	else if (i > 0 && read_depth() < i)
+		bwarnx("J command argument exceeded string execution depth");
 	else {
-		while (i-- > 0) {
-			src_free();
-			bmachine.readsp--;
-		}
+		while (i-- > 0)
+			pop_level();
 		skip_until_mark();
 	}
 }
@@ -1536,7 +2289,11 @@ skip_until_mark(void)
 		case 'M':
 			return;
 		case EOF:
-			errx(1, "mark not found");
+			/* A batch goes on with its next job */
+			if (!baseline.marked)
+				errx(1, "mark not found");
+			bwarnx("mark not found");
+			end_job();
 			return;
 		case 'l':
 		case 'L':
@@ -1554,7 +2311,9 @@ skip_until_mark(void)
 				unreadch();
 			break;
 		case '[':
-			free(read_string(&bmachine.readstack[bmachine.readsp]));
+			if (cur_instr() == NULL)
+				free(read_string(
+				    &bmachine.readstack[bmachine.readsp]));
 			break;
 		case '!':
 			switch (readch()) {
@@ -1581,44 +2340,145 @@ skip_until_mark(void)
 static void
 parse_number(void)
 {
+	struct instr	*in;
+	struct constant	*c;
+	struct number	*n;
+
+	if ((in = cur_instr()) != NULL) {
+		c = in->u.constant;
+		if (c->base != bmachine.ibase) {
+			in->u.constant = constant_intern(c->text,
+			    strlen(c->text), bmachine.ibase);
+			constant_release(c);
+			c = in->u.constant;
+		}
+		if (c->in_word) {
+			stack_pushword(&bmachine.stack, c->word);
+			return;
+		}
+		n = stack_newnumber(&bmachine.stack);
+		n->scale = c->num->scale;
+		mpz_set(n->number, c->num->number);
+		return;
+	}
 	unreadch();
 	push_number(readnumber(&bmachine.readstack[bmachine.readsp],
 	    bmachine.ibase));
+	value_word(tos());
 }
 
 static void
 unknown(void)
 {
 	int ch = bmachine.readstack[bmachine.readsp].lastchar;
-	warnx("%c (0%o) is unimplemented", ch, ch);
+	bwarnx("%c (0%o) is unimplemented", ch, ch);
 }
 
+/*
+ * A call at the end of a macro takes over the caller's level instead
+ * of recursing.  If only blanks were left, which are no-ops, the caller
+ * still counts for q, Q and J, as an idle level of the callee; its text
+ * is done, so loops written either way run in constant depth.
+ */
 static void
-eval_string(char *p)
+eval_source(struct source *src)
 {
-	int ch;
+	struct source	*cur;
+	size_t		idle = 0;
+	int		ch;
 
 	if (bmachine.readsp > 0) {
-		/* Check for tail call. Do not recurse in that case. */
-		ch = readch();
+		while ((ch = readch()) == ' ' || ch == '\t' || ch == '\n' ||
+		    ch == '\r' || ch == '\f')
+			idle = 1;
 		if (ch == EOF) {
-			src_free();
-			src_setstring(&bmachine.readstack[bmachine.readsp], p);
+			cur = &bmachine.readstack[bmachine.readsp];
+			idle += cur->idle;
+			if (cur->vtable == &program_vtable &&
+			    src->vtable == &program_vtable &&
+			    cur->u.code.prog == src->u.code.prog) {
+				/* A loop; jump back to its start */
+				program_unref(src->u.code.prog);
+				cur->u.code.pc = 0;
+			} else {
+				src_free();
+				*cur = *src;
+			}
+			cur->idle = idle;
 			return;
 		} else
 			unreadch();
 	}
+	(void)push_source(src);
+}
+
+/* Read src next; false if it could not be, and the job was ended */
+static bool
+push_source(struct source *src)
+{
 	if (bmachine.readsp == bmachine.readstack_sz - 1) {
 		size_t newsz = bmachine.readstack_sz * 2;
 		struct source *stack;
 		stack = reallocarray(bmachine.readstack, newsz,
 		    sizeof(struct source));
-		if (stack == NULL)
-			err(1, "recursion too deep");
+		if (stack == NULL) {
+			if (!baseline.marked)
+				err(1, "recursion too deep");
+			bwarnx("recursion too deep");
+			src->vtable->free(src);
+			end_job();
+			return false;
+		}
 		bmachine.readstack_sz = newsz;
 		bmachine.readstack = stack;
 	}
-	src_setstring(&bmachine.readstack[++bmachine.readsp], p);
+	bmachine.readstack[++bmachine.readsp] = *src;
+	bmachine.readstack[bmachine.readsp].idle = 0;
+	return true;
+}
+
+static void
+eval_string(char *p)
+{
+	struct source	src;
+
+	src_setstring(&src, p);
+	eval_source(&src);
+}
+
+/* Consumes the reference to prog */
+static void
+eval_program(struct program *prog)
+{
+	struct source	src;
+
+	src.vtable = &program_vtable;
+	src.u.code.prog = prog;
+	src.u.code.pc = 0;
+	eval_source(&src);
+}
+
+static __inline struct program *
+value_program(struct value *v)
+{
+	if (v->u.string->prog == NULL)
+		v->u.string->prog = program_compile(v->u.string->str);
+	return v->u.string->prog;
+}
+
+static void
+eval_value(struct value *v)
+{
+	struct program	*prog;
+	struct source	src;
+
+	prog = value_program(v);
+	if (prog->code != NULL)
+		eval_program(program_ref(prog));
+	else {
+		src_settext(&src, string_ref(v->u.string));
+		eval_source(&src);
+	}
 }
 
 static void
@@ -1628,6 +2488,11 @@ eval_line(void)
 	struct source	in;
 	char		*p;
 
+	/* In a batch, stdin may hold the jobs, which must not be eaten */
+	if (baseline.marked) {
+		bwarnx("? not allowed in a batch");
+		return;
+	}
 	clearerr(stdin);
 	src_setstream(&in, stdin);
 	p = (*in.vtable->readline)(&in);
@@ -1637,11 +2502,720 @@ eval_line(void)
 static void
 eval_tos(void)
 {
-	char *p;
+	struct value	*v;
 
-	p = pop_string();
-	if (p != NULL)
-		eval_string(p);
+	v = tos();
+	if (v == NULL || v->type != BCODE_STRING) {
+		/* Let pop_string() complain */
+		(void)pop_string();
+		return;
+	}
+	v = pop();
+	eval_value(v);
+	stack_free_value(v);
+}
+
+/*
+ * Parallel loops.  The & command pops, from the top, an end macro, a
+ * body macro, an init macro, a mode, the bounds a and b, and a start
+ * value.  The mode is the relation (0 for <, 1 for <=) plus twice the
+ * operator (0 for +, 1 for *, 2 for max).  The range of indices from a
+ * is split into at most PAR_CHUNKS chunks.  Each chunk runs init, then
+ * body with each of its indices on the stack, then end, which leaves
+ * the partial result of the chunk.  Chunks run on a pool of worker
+ * machines, each starting from a private copy of the registers of the
+ * calling machine; their output is written, and their partial results
+ * combined with the start value, in the order of the chunks.  So the
+ * result does not depend on the number of threads.  Chunks of nested
+ * loops run on the calling machine, but have what they write to the
+ * registers undone: wherever it runs, a chunk starts from the registers
+ * as the loop found them, and all it leaves is its partial result.
+ * & leaves the combined result, and on top of it the index after the
+ * last, which a for loop would leave in its variable.
+ */
+struct chunk {
+	u_long			first;
+	u_long			count;
+	struct number		*result;
+	char			*out;
+	size_t			outsz;
+	char			*err;
+	size_t			errsz;
+};
+
+static struct {
+	pthread_mutex_t		busy;	/* held by the machine running a loop */
+	pthread_mutex_t		lock;
+	pthread_cond_t		start;
+	pthread_cond_t		done;
+	u_int			threads;
+	u_int			nworkers;
+	bool			extended_regs;
+	u_long			generation;
+	u_int			running;
+	volatile sig_atomic_t	interrupted;	/* stop the running loop */
+	/* The loop being run */
+	const struct bmachine	*master;
+	const char		*macro[3];
+	const struct number	*from;
+	struct chunk		*chunks;
+	size_t			nchunks;
+	size_t			next;
+} par = {
+	PTHREAD_MUTEX_INITIALIZER,
+	PTHREAD_MUTEX_INITIALIZER,
+	PTHREAD_COND_INITIALIZER,
+	PTHREAD_COND_INITIALIZER
+};
+
+/* The number of worker machines for parallel loops */
+void
+bmachine_threads(u_int threads)
+{
+	par.threads = threads;
+}
+
+/* Run the macro v to its end, from within a command */
+static void
+run_macro(struct value *v)
+{
+	struct program	*prog;
+	struct source	src;
+	size_t		top;
+	int		ch;
+
+	prog = value_program(v);
+	if (prog->code != NULL) {
+		src.vtable = &program_vtable;
+		src.u.code.prog = program_ref(prog);
+		src.u.code.pc = 0;
+	} else
+		src_settext(&src, string_ref(v->u.string));
+	if (!push_source(&src))
+		return;
+
+	/* eval(), down to where v started; Q and q may go further */
+	top = bmachine.readsp;
+	while (bmachine.readsp >= top) {
+		ch = readch();
+		if (ch == EOF || bmachine.interrupted || par.interrupted) {
+			src_free();
+			bmachine.readsp--;
+			continue;
+		}
+		if (0 <= ch && ch < nitems(jump_table))
+			(*jump_table[ch])();
+		else
+			unknown();
+	}
+}
+
+/* Run chunk c of a loop on this machine, leaving its result in c */
+static void
+par_chunk(struct chunk *c, struct value *macro, const struct number *from)
+{
+	struct number	*n;
+	mpz_t		idx;
+	u_long		i;
+
+	mpz_init(idx);
+	mpz_set_ui(idx, c->first);
+	mpz_mul(idx, idx, power_of_ten(from->scale));
+	mpz_add(idx, idx, from->number);
+
+	run_macro(&macro[0]);
+	for (i = 0; i < c->count && !bmachine.interrupted &&
+	    !par.interrupted; i++) {
+		n = stack_newnumber(&bmachine.stack);
+		n->scale = from->scale;
+		mpz_set(n->number, idx);
+		run_macro(&macro[1]);
+		mpz_add(idx, idx, power_of_ten(from->scale));
+	}
+	mpz_clear(idx);
+	run_macro(&macro[2]);
+	/* A chunk cut short has no result */
+	if (!bmachine.interrupted && !par.interrupted)
+		c->result = pop_number();
+}
+
+/* Run chunk c on the calling machine, as a worker would */
+static void
+par_chunk_here(struct chunk *c, struct value *macro,
+    const struct number *from)
+{
+	size_t	mark, depth;
+	u_int	scale, obase, ibase;
+
+	mark = undo_begin();
+	depth = stack_size(&bmachine.stack);
+	scale = bmachine.scale;
+	obase = bmachine.obase;
+	ibase = bmachine.ibase;
+	par_chunk(c, macro, from);
+	while (stack_size(&bmachine.stack) > depth)
+		stack_free_value(pop());
+	bmachine.scale = scale;
+	bmachine.obase = obase;
+	bmachine.ibase = ibase;
+	undo_end(mark);
+}
+
+/* Make this worker's registers and stack those of the calling machine */
+static void
+par_sync(bool all)
+{
+	const struct bmachine	*m = par.master;
+	const struct stack	*from;
+	struct stack		*to;
+	size_t			i;
+	int			idx;
+
+	if (all) {
+		/* Workers have the registers of the first loop's machine */
+		for (i = 0; i < m->reg_array_size &&
+		    i < bmachine.reg_array_size; i++) {
+			to = reg_find(&bmachine, i);
+			from = reg_find(m, i);
+			if (to == NULL && from == NULL) {
+				i += REG_PAGE_SIZE - 1;
+				continue;
+			}
+			if (to == NULL && from->sp == -1)
+				continue;
+			if (to == NULL)
+				to = reg_stack(i);
+			if (from != NULL)
+				stack_copy_unshared(to, from);
+			else
+				stack_reset(to);
+		}
+	} else {
+		for (i = 0; i < baseline.ntouched; i++) {
+			idx = baseline.touched[i];
+			from = idx < m->reg_array_size ?
+			    reg_find(m, idx) : NULL;
+			if (from != NULL)
+				stack_copy_unshared(reg_stack(idx), from);
+			else
+				stack_reset(reg_stack(idx));
+		}
+	}
+	for (i = 0; i < baseline.ntouched; i++)
+		baseline.dirty[baseline.touched[i]] = false;
+	baseline.ntouched = 0;
+
+	stack_reset(&bmachine.stack);
+	bmachine.scale = m->scale;
+	bmachine.obase = m->obase;
+	bmachine.ibase = m->ibase;
+	bmachine.interrupted = false;
+}
+
+/* Where a worker machine writes */
+struct par_io {
+	FILE			*out;
+	FILE			*err;
+	char			*outbuf;
+	char			*errbuf;
+	size_t			outsz;
+	size_t			errsz;
+};
+
+/* Run chunks of the current loop until there are none left */
+static void
+par_run(struct par_io *io)
+{
+	struct value	macro[3];
+	struct chunk	*c;
+	size_t		i;
+	bool		first = true;
+
+	for (i = 0; i < 3; i++) {
+		macro[i].type = BCODE_STRING;
+		macro[i].u.string = string_new(par.macro[i],
+		    strlen(par.macro[i]));
+		macro[i].array = NULL;
+	}
+	for (;;) {
+		pthread_mutex_lock(&par.lock);
+		c = par.next < par.nchunks && !par.interrupted ?
+		    &par.chunks[par.next++] : NULL;
+		pthread_mutex_unlock(&par.lock);
+		if (c == NULL)
+			break;
+		par_sync(first);
+		first = false;
+		par_chunk(c, macro, par.from);
+		(void)fflush(io->out);
+		(void)fflush(io->err);
+		c->outsz = io->outsz;
+		c->out = bmalloc(c->outsz + 1);
+		memcpy(c->out, io->outbuf, c->outsz);
+		c->errsz = io->errsz;
+		c->err = bmalloc(c->errsz + 1);
+		memcpy(c->err, io->errbuf, c->errsz);
+		rewind(io->out);
+		rewind(io->err);
+	}
+	for (i = 0; i < 3; i++)
+		stack_free_value(&macro[i]);
+	/* Workers never end, so their pools are counted here */
+	number_pool_count();
+}
+
+static void *
+par_worker(void *arg)
+{
+	struct par_io	io;
+	sigset_t	set;
+	u_long		seen = 0;
+
+	(void)arg;
+	/* SIGINT is for the calling machine */
+	(void)sigemptyset(&set);
+	(void)sigaddset(&set, SIGINT);
+	(void)pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	init_bmachine(par.extended_regs);
+	io.out = open_memstream(&io.outbuf, &io.outsz);
+	io.err = open_memstream(&io.errbuf, &io.errsz);
+	if (io.out == NULL || io.err == NULL)
+		err(1, NULL);
+	bmachine_setio(io.out, io.err);
+	/* Note the registers written, for par_sync() */
+	baseline.marked = true;
+	baseline.dirty = calloc(bmachine.reg_array_size,
+	    sizeof(*baseline.dirty));
+	if (baseline.dirty == NULL)
+		err(1, NULL);
+
+	pthread_mutex_lock(&par.lock);
+	for (;;) {
+		while (par.generation == seen)
+			pthread_cond_wait(&par.start, &par.lock);
+		seen = par.generation;
+		pthread_mutex_unlock(&par.lock);
+		par_run(&io);
+		pthread_mutex_lock(&par.lock);
+		if (--par.running == 0)
+			pthread_cond_signal(&par.done);
+	}
+	/* NOTREACHED */
+	return NULL;
+}
+
+/* Start the worker machines, once; false if there can be none */
+static bool
+par_start(void)
+{
+	pthread_t	thread;
+
+	if (par.nworkers > 0)
+		return true;
+	par.extended_regs = bmachine.extended_regs;
+	for (; par.nworkers < max(par.threads, 1); par.nworkers++)
+		if (pthread_create(&thread, NULL, par_worker, NULL) != 0 ||
+		    pthread_detach(thread) != 0)
+			break;
+	return par.nworkers > 0;
+}
+
+/*
+ * SIGINT, or bc's, for this machine.  The workers of a loop it is
+ * running do not see its flag, so they are stopped through this one.
+ */
+static void
+par_interrupt(void)
+{
+	if (par.running > 0 && par.master == &bmachine)
+		par.interrupted = true;
+}
+
+/* Check the operands of &, at depth 0 and up */
+static bool
+par_operands(void)
+{
+	ssize_t	i;
+	size_t	depth = stack_size(&bmachine.stack);
+
+	if (depth < 7) {
+		bwarnx("stack empty");
+		return false;
+	}
+	for (i = 0; i < 7; i++) {
+		if (bmachine.stack.stack[bmachine.stack.sp - i].type !=
+		    (i < 3 ? BCODE_STRING : BCODE_NUMBER)) {
+			bwarnx(i < 3 ? "not a string" : "not a number");
+			return false;
+		}
+	}
+	return true;
+}
+
+static void
+parallel_for(void)
+{
+	struct number	*a, *b, *n, *m, *t, *u;
+	struct chunk	*chunks;
+	struct value	macro[3];
+	mpz_t		count;
+	u_long		mode, total, nchunks, serial, i;
+	u_int		s;
+	int		cmp;
+
+	if (!par_operands())
+		return;
+	for (i = 3; i-- > 0;) {
+		macro[i].type = BCODE_STRING;
+		macro[i].u.string = pop_string();
+		macro[i].array = NULL;
+	}
+	n = pop_number();
+	mode = get_ulong(n);
+	free_number(n);
+	b = pop_number();
+	a = pop_number();
+
+	/* The number of indices from a: ceil(b - a), or floor(b - a) + 1 */
+	s = max(a->scale, b->scale);
+	mpz_init(count);
+	mpz_set(count, b->number);
+	scale_number(count, s - b->scale);
+	mpz_set(b->number, a->number);
+	scale_number(b->number, s - a->scale);
+	mpz_sub(count, count, b->number);
+	if (mode & 1) {
+		mpz_fdiv_q(count, count, power_of_ten(s));
+		mpz_add_ui(count, count, 1);
+	} else
+		mpz_cdiv_q(count, count, power_of_ten(s));
+	total = 0;
+	if (mode > 5)
+		bwarnx("invalid parallel loop mode");
+	else if (mpz_sgn(count) > 0) {
+		if (mpz_fits_ulong_p(count))
+			total = mpz_get_ui(count);
+		else
+			bwarnx("parallel loop too long");
+	}
+	mpz_clear(count);
+	free_number(b);
+
+	nchunks = total < PAR_CHUNKS ? total : PAR_CHUNKS;
+	chunks = calloc(nchunks, sizeof(*chunks));
+	if (chunks == NULL && nchunks > 0)
+		err(1, NULL);
+	for (i = 0; i < nchunks; i++) {
+		chunks[i].first = i * (total / nchunks) +
+		    (i < total % nchunks ? i : total % nchunks);
+		chunks[i].count = total / nchunks + (i < total % nchunks);
+	}
+
+	serial = nchunks;
+	if (nchunks > 0 && pthread_mutex_trylock(&par.busy) == 0) {
+		if (par_start()) {
+			pthread_mutex_lock(&par.lock);
+			par.master = &bmachine;
+			for (i = 0; i < 3; i++)
+				par.macro[i] = macro[i].u.string->str;
+			par.from = a;
+			par.chunks = chunks;
+			par.nchunks = nchunks;
+			par.next = 0;
+			par.interrupted = bmachine.interrupted;
+			par.running = par.nworkers;
+			par.generation++;
+			pthread_cond_broadcast(&par.start);
+			while (par.running > 0)
+				pthread_cond_wait(&par.done, &par.lock);
+			par.interrupted = false;
+			pthread_mutex_unlock(&par.lock);
+			serial = 0;
+		}
+		pthread_mutex_unlock(&par.busy);
+	}
+	/* Nested, or no threads: run the chunks here */
+	for (i = 0; i < serial; i++)
+		par_chunk_here(&chunks[i], macro, a);
+	for (i = 0; i < 3; i++)
+		stack_free_value(&macro[i]);
+
+	/* The start value is on the stack */
+	for (i = 0; i < nchunks; i++) {
+		/* Chunks run here have written already */
+		if (chunks[i].out != NULL) {
+			(void)fwrite(chunks[i].out, 1, chunks[i].outsz,
+			    bmachine.out);
+			(void)fwrite(chunks[i].err, 1, chunks[i].errsz,
+			    bmachine.err);
+		}
+		free(chunks[i].out);
+		free(chunks[i].err);
+		if (chunks[i].result == NULL)
+			continue;
+		push_number(chunks[i].result);
+		switch (mode >> 1) {
+		case 0:
+			badd();
+			break;
+		case 1:
+			bmul();
+			break;
+		default:
+			n = pop_number();
+			m = pop_number();
+			/* cmp_numbers() may rescale what it compares */
+			t = dup_number(m);
+			u = dup_number(n);
+			cmp = cmp_numbers(t, u);
+			free_number(t);
+			free_number(u);
+			push_number(cmp < 0 ? n : m);
+			free_number(cmp < 0 ? m : n);
+			break;
+		}
+	}
+	free(chunks);
+
+	/* The index after the last, as a for loop leaves it */
+	mpz_init_set_ui(count, total);
+	mpz_addmul(a->number, count, power_of_ten(a->scale));
+	mpz_clear(count);
+	push_number(a);
+}
+
+static int
+src_getcharprogram(struct source *src)
+{
+	if (src->u.code.pc == src->u.code.prog->len)
+		return src->lastchar = EOF;
+	return src->lastchar = src->u.code.prog->code[src->u.code.pc++].ch;
+}
+
+static void
+src_ungetcharprogram(struct source *src)
+{
+	if (src->lastchar != EOF)
+		src->u.code.pc--;
+}
+
+/* ARGSUSED */
+static char *
+src_getlineprogram(struct source *src)
+{
+	/* Never compiled: programs containing # or a bare ! */
+	(void)src;
+	return bstrdup("");
+}
+
+static void
+src_freeprogram(struct source *src)
+{
+	program_unref(src->u.code.prog);
+}
+
+static struct instr *
+program_add(struct program *prog, int ch)
+{
+	struct instr	*in;
+
+	if ((prog->len & (prog->len - 1)) == 0 && prog->len >= 8)
+		prog->code = breallocarray(prog->code, prog->len * 2,
+		    sizeof(*prog->code));
+	in = &prog->code[prog->len++];
+	in->ch = ch;
+	in->u.reg = -1;
+	return in;
+}
+
+/* Same as readreg(), on text; returns -1 where readreg() would complain */
+static int
+compile_reg(const u_char **pp)
+{
+	const u_char	*p = *pp;
+	int		idx;
+
+	if (*p == '\0')
+		return -1;
+	idx = *p++;
+	if (idx == 0xff && bmachine.extended_regs) {
+		if (p[0] == '\0' || p[1] == '\0')
+			return -1;
+		idx = (p[0] << 8) + p[1] + UCHAR_MAX + 1;
+		p += 2;
+	}
+	if (idx >= bmachine.reg_array_size)
+		return -1;
+	*pp = p;
+	return idx;
+}
+
+static bool
+is_number_char(int ch)
+{
+	return ('0' <= ch && ch <= '9') || ('A' <= ch && ch <= 'F') ||
+	    ch == '_' || ch == '.';
+}
+
+/*
+ * Decode str into instructions.  The result must behave exactly like
+ * the text would, including in skip_until_mark() and for the tail call
+ * check, so anything read differently in those contexts is left to the
+ * text interpreter.
+ */
+struct program *
+program_compile(const char *str)
+{
+	const u_char	*p, *q;
+	struct program	*prog;
+	int		ch, count, reg;
+	bool		escape, dot;
+	size_t		i, sz;
+	char		*lit;
+
+	prog = bmalloc(sizeof(*prog));
+	prog->refcnt = 1;
+	prog->len = 0;
+	prog->code = breallocarray(NULL, 8, sizeof(*prog->code));
+
+	p = (const u_char *)str;
+	while ((ch = *p++) != '\0') {
+		switch (ch) {
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+		case '\f':
+			/*
+			 * Only observable at the end, where it prevents a tail
+			 * call, and before an 'e', which it keeps from being
+			 * read as the else of a comparison
+			 */
+			if (*p == '\0' || *p == 'e')
+				(void)program_add(prog, ch);
+			break;
+		case 'l':
+		case 'L':
+		case 's':
+		case 'S':
+		case ':':
+		case ';':
+			/* skip_until_mark() would read an 'e' as an else register */
+			if ((reg = compile_reg(&p)) == -1 || *p == 'e')
+				goto text;
+			program_add(prog, ch)->u.reg = reg;
+			break;
+		case '<':
+		case '>':
+		case '=':
+			if ((reg = compile_reg(&p)) == -1)
+				goto text;
+			program_add(prog, ch)->u.reg = reg;
+			if (*p == 'e') {
+				p++;
+				if ((reg = compile_reg(&p)) == -1)
+					goto text;
+				program_add(prog, 'e')->u.reg = reg;
+			}
+			break;
+		case '!':
+			/* The comparison itself follows as the next instruction */
+			if (*p != '<' && *p != '>' && *p != '=')
+				goto text;
+			(void)program_add(prog, ch);
+			break;
+		case '#':
+			goto text;
+		case '[':
+			/* Same as read_string() */
+			count = 1;
+			escape = false;
+			i = 0;
+			sz = 15;
+			lit = bmalloc(sz + 1);
+			while ((ch = *p) != '\0') {
+				p++;
+				if (!escape) {
+					if (ch == '[')
+						count++;
+					else if (ch == ']')
+						count--;
+					if (count == 0)
+						break;
+				}
+				if (ch == '\\' && !escape)
+					escape = true;
+				else {
+					escape = false;
+					if (i == sz) {
+						sz *= 2;
+						lit = breallocarray(lit, 1, sz + 1);
+					}
+					lit[i++] = ch;
+				}
+			}
+			lit[i] = '\0';
+			program_add(prog, '[')->u.string = string_new(lit, i);
+			free(lit);
+			break;
+		default:
+			if (!is_number_char(ch)) {
+				(void)program_add(prog, ch);
+				break;
+			}
+			/* The extent of the number as readnumber() sees it */
+			dot = ch == '.';
+			for (q = p; is_number_char(*q); q++) {
+				if (*q == '.') {
+					if (dot) {
+						q++;
+						break;
+					}
+					dot = true;
+				}
+			}
+			program_add(prog, ch)->u.constant = constant_intern(
+			    (const char *)p - 1, q - p + 1, bmachine.ibase);
+			p = q;
+			break;
+		}
+	}
+	return prog;
+
+text:
+	program_unref(prog);
+	prog = bmalloc(sizeof(*prog));
+	prog->refcnt = 1;
+	prog->len = 0;
+	prog->code = NULL;
+	return prog;
+}
+
+struct program *
+program_ref(struct program *prog)
+{
+	prog->refcnt++;
+	return prog;
+}
+
+void
+program_unref(struct program *prog)
+{
+	struct instr	*in;
+	size_t		i;
+
+	if (--prog->refcnt > 0)
+		return;
+	for (i = 0; i < prog->len; i++) {
+		in = &prog->code[i];
+		if (in->ch == '[')
+			string_unref(in->u.string);
+		else if (is_number_char(in->ch))
+			constant_release(in->u.constant);
+	}
+	free(prog->code);
+	free(prog);
 }
 
 void
@@ -1685,3 +3259,92 @@ eval(void)
 #endif
 	}
 }
+
+static u_int
+constant_hash(const char *text, size_t len, u_int base)
+{
+	u_int	h = 2166136261U ^ base;
+	size_t	i;
+
+	for (i = 0; i < len; i++)
+		h = (h ^ (u_char)text[i]) * 16777619U;
+	return h;
+}
+
+/*
+ * Return a reference to the value of the len bytes at text, read in
+ * the given base.  Equal literals share one entry, which is converted
+ * only when it is first seen.
+ */
+static struct constant *
+constant_intern(const char *text, size_t len, u_int base)
+{
+	struct constant	*c, **tab, *next;
+	struct source	src;
+	size_t		i, h;
+
+	if (constants.size == 0) {
+		constants.size = CONSTANT_HASH_SIZE;
+		constants.tab = calloc(constants.size, sizeof(*constants.tab));
+		if (constants.tab == NULL)
+			err(1, NULL);
+	}
+	h = constant_hash(text, len, base) & (constants.size - 1);
+	for (c = constants.tab[h]; c != NULL; c = c->next) {
+		if (c->base == base && strncmp(c->text, text, len) == 0 &&
+		    c->text[len] == '\0') {
+			c->refcnt++;
+			return c;
+		}
+	}
+
+	if (constants.count >= constants.size) {
+		tab = calloc(constants.size * 2, sizeof(*tab));
+		if (tab == NULL)
+			err(1, NULL);
+		for (i = 0; i < constants.size; i++) {
+			for (c = constants.tab[i]; c != NULL; c = next) {
+				next = c->next;
+				h = constant_hash(c->text, strlen(c->text),
+				    c->base) & (constants.size * 2 - 1);
+				c->next = tab[h];
+				tab[h] = c;
+			}
+		}
+		free(constants.tab);
+		constants.tab = tab;
+		constants.size *= 2;
+		h = constant_hash(text, len, base) & (constants.size - 1);
+	}
+
+	c = bmalloc(sizeof(*c) + len + 1);
+	memcpy(c->text, text, len);
+	c->text[len] = '\0';
+	c->refcnt = 1;
+	c->base = base;
+	src_setstring(&src, c->text);
+	c->num = readnumber(&src, base);
+	c->in_word = c->num->scale == 0 && mpz_fits_slong_p(c->num->number);
+	c->word = c->in_word ? mpz_get_si(c->num->number) : 0;
+	c->next = constants.tab[h];
+	constants.tab[h] = c;
+	constants.count++;
+	return c;
+}
+
+static void
+constant_release(struct constant *c)
+{
+	struct constant	**cp;
+
+	if (--c->refcnt > 0)
+		return;
+	cp = &constants.tab[constant_hash(c->text, strlen(c->text),
+	    c->base) & (constants.size - 1)];
+	while (*cp != c)
+		cp = &(*cp)->next;
+	*cp = c->next;
+	constants.count--;
+	free_number(c->num);
+	free(c);
+}
@@ -44,19 +44,53 @@ enum bcode_compare {
 };
 
 struct array;
+struct program;
 
+/*
+ * Strings and arrays are shared by the values holding them, and counted.
+ * Strings are never changed; an array is copied before it is written,
+ * if it is shared.  Numbers are not shared: they live in the values, and
+ * the arithmetic works on them in place.
+ */
+struct string {
+	u_int		refcnt;
+	struct program	*prog;		/* compiled, if done */
+	char		str[];
+};
+
+/*
+ * A number of scale 0 that fits a long may be held in a word instead,
+ * so that loop counters and indices do not go through GMP.  It is given
+ * its mpz_t by value_unword() where one is needed.
+ */
 struct value {
 	union {
-		struct number	*num;
-		char		*string;
+		struct number	num;
+		struct string	*string;
+		long		word;
 	} u;
 	struct array	*array;
 	enum stacktype	type;
+	bool		in_word;	/* a number, held in u.word */
+};
+
+/*
+ * Elements below size are kept in data, grown geometrically; the others
+ * are hashed, so that large or scattered indices do not cost an element
+ * for each index below them.
+ */
+struct array_entry {
+	size_t		key;		/* index + 1, or 0 for a free slot */
+	struct value	value;
 };
 
 struct array {
-	struct value	*data;
-	size_t		size;
+	u_int			refcnt;
+	struct value		*data;
+	size_t			size;
+	struct array_entry	*sparse;
+	size_t			sparse_sz;	/* a power of two */
+	size_t			sparse_cnt;
 };
 
 struct stack {
@@ -81,20 +115,75 @@ struct source {
 			struct {
 				u_char *buf;
 				size_t pos;
+				struct string *text;	/* holds buf */
 			} string;
+			struct {
+				struct program *prog;
+				size_t pc;
+			} code;
 	} u;
 	int		lastchar;
+	size_t		idle;	/* callers left with only blanks to run */
+};
+
+/*
+ * A string decoded once into instructions, so that executing it again
+ * does not rescan the text.  Register operands, the contents of [...]
+ * literals and numbers (as pooled constants) are resolved at compile
+ * time.  Strings that cannot be represented exactly get code == NULL
+ * and are interpreted as text.
+ */
+struct constant {
+	struct constant	*next;
+	u_int		refcnt;
+	u_int		base;
+	struct number	*num;
+	bool		in_word;	/* num fits a word, which is this */
+	long		word;
+	char		text[];
+};
+
+struct instr {
+	int		ch;
+	union {
+		int		reg;
+		struct constant	*constant;
+		struct string	*string;
+	} u;
+};
+
+struct program {
+	u_int		refcnt;
+	size_t		len;
+	struct instr	*code;
 };
 
 void			init_bmachine(bool);
 void			reset_bmachine(struct source *);
 u_int			bmachine_scale(void);
+void			bmachine_interrupt(void);
+void			bmachine_array_max(u_long);
+struct baseline;
+const struct baseline	*bmachine_mark(void);
+void			bmachine_start(const struct baseline *);
+void			bmachine_restore(void);
+void			bmachine_end(void);
+void			bmachine_setio(FILE *, FILE *);
+void			bmachine_threads(u_int);
+void			bwarnx(const char *, ...)
+			    __attribute__((__format__ (printf, 1, 2)));
+mpz_srcptr		power_of_ten(u_int);
 void			scale_number(mpz_t, int);
 void			normalize(struct number *, u_int);
 void			eval(void);
+struct program		*program_compile(const char *);
+struct program		*program_ref(struct program *);
+void			program_unref(struct program *);
 void			pn(const char *, const struct number *);
 void			pbn(const char *, const mpz_t);
 void			negate(struct number *);
 void			split_number(const struct number *, mpz_t, mpz_t);
 void			bmul_number(struct number *, struct number *,
 			    struct number *, u_int scale);
+void			sqrt_number(struct number *, struct number *, u_int);
+u_int			count_digits(const struct number *);
@@ -19,20 +19,90 @@
 #include <sys/stat.h>
 #include <err.h>
 #include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include "extern.h"
 
+#define JOBS_PER_THREAD	64	/* jobs in flight, for reordering */
+
+/*
+ * Batch mode.  A worker is a machine with the streams it writes to.
+ * When jobs run in parallel, each worker has a thread and a deque of
+ * jobs: it takes the oldest of its own, and when it has none, steals
+ * the newest of another's.
+ */
+struct deque {
+	pthread_mutex_t	lock;
+	size_t		*seq;
+	size_t		head;
+	size_t		tail;
+};
+
+struct worker {
+	pthread_t	thread;
+	size_t		id;
+	struct deque	dq;
+	FILE		*out;
+	FILE		*err;
+	char		*outbuf;
+	char		*errbuf;
+	size_t		outsz;
+	size_t		errsz;
+	FILE		*frame;
+	char		*framebuf;
+	size_t		framesz;
+};
+
+/* A slot of the window of jobs read but not yet written */
+struct job {
+	char		*code;
+	size_t		codesz;
+	char		*result;
+	size_t		len;
+	size_t		size;
+	bool		done;
+};
+
+static struct {
+	bool			parallel;
+	struct worker		self;
+	const struct baseline	*base;
+	struct worker		*workers;
+	size_t			nworkers;
+	struct job		*jobs;
+	size_t			window;
+	size_t			next;		/* jobs read */
+	size_t			written;	/* jobs written */
+	size_t			queued;		/* jobs in deques */
+	bool			eof;
+	pthread_mutex_t		lock;		/* all but the deques */
+	pthread_cond_t		work;
+	pthread_cond_t		room;
+} batch;
+
 static void	usage(void);
+static void	batch_run(FILE *);
+static void	worker_init(struct worker *);
+static void	worker_end(struct worker *);
+static void	worker_run(struct worker *, char *, FILE *);
+static void	*worker_main(void *);
+static bool	worker_take(struct worker *, size_t *);
+static bool	deque_get(struct deque *, size_t *, bool);
+static void	job_done(size_t);
+static void	batch_frame(FILE *, const char *, const char *, size_t);
 
 extern char		*__progname;
 
 static void
 usage(void)
 {
-	(void)fprintf(stderr, "usage: %s [-x] [-e expression] [file]\n",
+	(void)fprintf(stderr,
+	    "usage: %s [-bx] [-a index] [-e expression] [-j threads] [file]\n",
 	    __progname);
 	exit(1);
 }
@@ -42,6 +112,9 @@ dc_main(int argc, char *argv[])
 {
 	int		ch;
 	bool		extended_regs = false;
+	bool		batch_mode = false;
+	long		threads = 0;
+	long		array_max = -1;
 	FILE		*file;
 	struct source	src;
 	char		*buf, *p;
@@ -51,14 +124,29 @@ dc_main(int argc, char *argv[])
 	/* accept and ignore a single dash to be 4.4BSD dc(1) compatible */
 	optind = 1;
 	optreset = 1;
-	while ((ch = getopt(argc, argv, "e:x-")) != -1) {
+	while ((ch = getopt(argc, argv, "a:be:j:x-")) != -1) {
 		switch (ch) {
+		case 'a':
+			array_max = strtol(optarg, &p, 10);
+			if (optarg[0] == '\0' || *p != '\0' || array_max < 0 ||
+			    array_max == LONG_MAX)
+				errx(1, "invalid array index: %s", optarg);
+			break;
+		case 'b':
+			batch_mode = true;
+			break;
 		case 'e':
 			p = buf;
 			if (asprintf(&buf, "%s %s", buf, optarg) == -1)
 				err(1, NULL);
 			free(p);
 			break;
+		case 'j':
+			threads = strtol(optarg, &p, 10);
+			if (optarg[0] == '\0' || *p != '\0' || threads < 1 ||
+			    threads > MAX_THREADS)
+				errx(1, "invalid number of threads: %s", optarg);
+			break;
 		case 'x':
 			extended_regs = true;
 			break;
@@ -72,6 +160,9 @@ dc_main(int argc, char *argv[])
 	argv += optind;
 
 	init_bmachine(extended_regs);
+	dc_threads(threads);
+	if (array_max >= 0)
+		dc_array_max(array_max);
 	(void)setvbuf(stdout, NULL, _IOLBF, 0);
 	(void)setvbuf(stderr, NULL, _IOLBF, 0);
 
@@ -82,9 +173,18 @@ dc_main(int argc, char *argv[])
 		reset_bmachine(&src);
 		eval();
 		free(buf);
-		if (argc == 0)
+		if (argc == 0 && !batch_mode)
 			return (0);
 	}
+	if (batch_mode) {
+		file = stdin;
+		if (argc == 1 && (file = fopen(argv[0], "r")) == NULL)
+			err(1, "cannot open file %s", argv[0]);
+		dc_batch_init(threads > 0 ? threads : 1);
+		batch_run(file);
+		dc_batch_end();
+		return (0);
+	}
 	if (argc == 1) {
 		file = fopen(argv[0], "r");
 		if (file == NULL)
@@ -111,3 +211,340 @@ dc_main(int argc, char *argv[])
 
 	return (0);
 }
+
+/*
+ * Interface for bc(1) running dc in its own process instead of in a
+ * child reading from a pipe: dc_init() once, then dc_eval() for each
+ * chunk of generated code.
+ */
+void
+dc_init(void)
+{
+	init_bmachine(true);
+	(void)setvbuf(stdout, NULL, _IOLBF, 0);
+	(void)setvbuf(stderr, NULL, _IOLBF, 0);
+}
+
+/* Worker machines for parallel loops; 0 for one per processor */
+void
+dc_threads(int threads)
+{
+	if (threads == 0 && (threads = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		threads = 1;
+	bmachine_threads(threads);
+}
+
+/* The largest array index, for -a */
+void
+dc_array_max(long max)
+{
+	bmachine_array_max(max);
+}
+
+void
+dc_eval(char *buf)
+{
+	struct source	src;
+
+	src_setstring(&src, buf);
+	reset_bmachine(&src);
+	eval();
+}
+
+/* Called from bc's SIGINT handler */
+void
+dc_interrupt(void)
+{
+	bmachine_interrupt();
+}
+
+/* Whether the functions of bc's math library are built in */
+bool
+dc_native_library(void)
+{
+	return true;
+}
+
+/*
+ * Batch mode.  dc_batch_init() takes the current state as the one every
+ * job starts from.  Each dc_batch_eval() then runs a job, which writes
+ * one line: "ok", or "ok" followed by a space and the output of the
+ * job, or "error" followed by a space and the messages the job caused.
+ * Newlines in these are written as \n and backslashes as \\; the line
+ * continuations of long numbers are left out.  With more than one
+ * thread, jobs are queued and run in parallel, and their lines written
+ * in order; dc_batch_end() waits for all of them.
+ */
+void
+dc_batch_init(int threads)
+{
+	size_t	i;
+
+	batch.base = bmachine_mark();
+	(void)fflush(stdout);
+	(void)fflush(stderr);
+	if (threads <= 1) {
+		worker_init(&batch.self);
+		return;
+	}
+
+	batch.parallel = true;
+	batch.nworkers = threads;
+	batch.window = batch.nworkers * JOBS_PER_THREAD;
+	batch.jobs = breallocarray(NULL, batch.window, sizeof(*batch.jobs));
+	memset(batch.jobs, 0, batch.window * sizeof(*batch.jobs));
+	if (pthread_mutex_init(&batch.lock, NULL) != 0 ||
+	    pthread_cond_init(&batch.work, NULL) != 0 ||
+	    pthread_cond_init(&batch.room, NULL) != 0)
+		errx(1, "cannot initialize threads");
+	batch.workers = breallocarray(NULL, batch.nworkers,
+	    sizeof(*batch.workers));
+	for (i = 0; i < batch.nworkers; i++) {
+		batch.workers[i].id = i;
+		batch.workers[i].dq.seq = breallocarray(NULL, batch.window,
+		    sizeof(size_t));
+		batch.workers[i].dq.head = batch.workers[i].dq.tail = 0;
+		if (pthread_mutex_init(&batch.workers[i].dq.lock, NULL) != 0)
+			errx(1, "cannot initialize threads");
+	}
+	for (i = 0; i < batch.nworkers; i++)
+		if (pthread_create(&batch.workers[i].thread, NULL,
+		    worker_main, &batch.workers[i]) != 0)
+			errx(1, "cannot create thread");
+}
+
+void
+dc_batch_eval(char *buf)
+{
+	struct job	*job;
+	struct deque	*dq;
+	size_t		len, n;
+
+	if (!batch.parallel) {
+		worker_run(&batch.self, buf, stdout);
+		return;
+	}
+
+	(void)pthread_mutex_lock(&batch.lock);
+	while (batch.next - batch.written >= batch.window)
+		(void)pthread_cond_wait(&batch.room, &batch.lock);
+	n = batch.next;
+	(void)pthread_mutex_unlock(&batch.lock);
+
+	/* The slot is free: its last job has been written */
+	job = &batch.jobs[n % batch.window];
+	len = strlen(buf) + 1;
+	if (job->codesz < len) {
+		job->code = breallocarray(job->code, len, 1);
+		job->codesz = len;
+	}
+	memcpy(job->code, buf, len);
+
+	dq = &batch.workers[n % batch.nworkers].dq;
+	(void)pthread_mutex_lock(&dq->lock);
+	dq->seq[dq->tail++ % batch.window] = n;
+	(void)pthread_mutex_unlock(&dq->lock);
+
+	(void)pthread_mutex_lock(&batch.lock);
+	batch.next++;
+	batch.queued++;
+	(void)pthread_cond_signal(&batch.work);
+	(void)pthread_mutex_unlock(&batch.lock);
+}
+
+void
+dc_batch_end(void)
+{
+	size_t	i;
+
+	if (batch.parallel) {
+		(void)pthread_mutex_lock(&batch.lock);
+		batch.eof = true;
+		(void)pthread_cond_broadcast(&batch.work);
+		(void)pthread_mutex_unlock(&batch.lock);
+		for (i = 0; i < batch.nworkers; i++)
+			(void)pthread_join(batch.workers[i].thread, NULL);
+	}
+	(void)fflush(stdout);
+}
+
+/* Every line of f is a job */
+static void
+batch_run(FILE *f)
+{
+	char	*line = NULL;
+	size_t	size = 0;
+
+	while (getline(&line, &size, f) != -1)
+		dc_batch_eval(line);
+	if (ferror(f))
+		err(1, "read");
+	free(line);
+}
+
+/* Have this thread's machine write into the worker's buffers */
+static void
+worker_init(struct worker *w)
+{
+	w->out = open_memstream(&w->outbuf, &w->outsz);
+	w->err = open_memstream(&w->errbuf, &w->errsz);
+	w->frame = open_memstream(&w->framebuf, &w->framesz);
+	if (w->out == NULL || w->err == NULL || w->frame == NULL)
+		err(1, NULL);
+	bmachine_setio(w->out, w->err);
+}
+
+static void
+worker_end(struct worker *w)
+{
+	(void)fclose(w->out);
+	(void)fclose(w->err);
+	(void)fclose(w->frame);
+	free(w->outbuf);
+	free(w->errbuf);
+	free(w->framebuf);
+}
+
+/* Run a job on this thread's machine, and write its line to f */
+static void
+worker_run(struct worker *w, char *code, FILE *f)
+{
+	off_t	len;
+
+	bmachine_restore();
+	dc_eval(code);
+	(void)fflush(w->out);
+	(void)fflush(w->err);
+	if ((len = ftello(w->err)) > 0)
+		batch_frame(f, "error", w->errbuf, len);
+	else
+		batch_frame(f, "ok", w->outbuf, ftello(w->out));
+	rewind(w->out);
+	rewind(w->err);
+}
+
+static void *
+worker_main(void *arg)
+{
+	struct worker	*w = arg;
+	struct job	*job;
+	sigset_t	set;
+	size_t		n;
+	off_t		len;
+
+	/* SIGINT is for the main machine */
+	(void)sigemptyset(&set);
+	(void)sigaddset(&set, SIGINT);
+	(void)pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	bmachine_start(batch.base);
+	worker_init(w);
+	while (worker_take(w, &n)) {
+		job = &batch.jobs[n % batch.window];
+		rewind(w->frame);
+		worker_run(w, job->code, w->frame);
+		(void)fflush(w->frame);
+		len = ftello(w->frame);
+		if (job->size < (size_t)len) {
+			job->result = breallocarray(job->result, len, 1);
+			job->size = len;
+		}
+		memcpy(job->result, w->framebuf, len);
+		job->len = len;
+		job_done(n);
+	}
+	worker_end(w);
+	bmachine_end();
+	return (NULL);
+}
+
+/* Take a job of our own, or steal one; false when there are no more */
+static bool
+worker_take(struct worker *w, size_t *n)
+{
+	size_t	i;
+	bool	found, end;
+
+	for (;;) {
+		found = deque_get(&w->dq, n, true);
+		for (i = 1; !found && i < batch.nworkers; i++)
+			found = deque_get(&batch.workers[(w->id + i) %
+			    batch.nworkers].dq, n, false);
+
+		(void)pthread_mutex_lock(&batch.lock);
+		if (found)
+			batch.queued--;
+		else
+			while (batch.queued == 0 && !batch.eof)
+				(void)pthread_cond_wait(&batch.work,
+				    &batch.lock);
+		end = batch.queued == 0 && batch.eof;
+		(void)pthread_mutex_unlock(&batch.lock);
+		if (found)
+			return (true);
+		if (end)
+			return (false);
+	}
+}
+
+static bool
+deque_get(struct deque *dq, size_t *n, bool own)
+{
+	bool	found;
+
+	(void)pthread_mutex_lock(&dq->lock);
+	found = dq->head != dq->tail;
+	if (found && own)
+		*n = dq->seq[dq->head++ % batch.window];
+	else if (found)
+		*n = dq->seq[--dq->tail % batch.window];
+	(void)pthread_mutex_unlock(&dq->lock);
+	return (found);
+}
+
+/* Write the lines of the jobs done so far that are next in order */
+static void
+job_done(size_t n)
+{
+	struct job	*job;
+
+	(void)pthread_mutex_lock(&batch.lock);
+	batch.jobs[n % batch.window].done = true;
+	for (;;) {
+		job = &batch.jobs[batch.written % batch.window];
+		if (!job->done)
+			break;
+		(void)fwrite(job->result, 1, job->len, stdout);
+		job->done = false;
+		batch.written++;
+		(void)pthread_cond_signal(&batch.room);
+	}
+	(void)pthread_mutex_unlock(&batch.lock);
+	if (ferror(stdout))
+		err(1, "write");
+}
+
+static void
+batch_frame(FILE *f, const char *status, const char *text, size_t len)
+{
+	size_t	i;
+
+	if (len > 0 && text[len - 1] == '\n')
+		len--;
+	(void)fputs(status, f);
+	if (len > 0)
+		(void)putc(' ', f);
+	for (i = 0; i < len; i++) {
+		if (text[i] == '\\' && i + 1 < len && text[i + 1] == '\n')
+			i++;
+		else if (text[i] == '\\')
+			(void)fputs("\\\\", f);
+		else if (text[i] == '\n')
+			(void)fputs("\\n", f);
+		else
+			(void)putc(text[i], f);
+	}
+	(void)putc('\n', f);
+	if (ferror(f))
+		err(1, "write");
+}
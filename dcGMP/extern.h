@@ -23,16 +23,32 @@
 /* inout.c */
 void		src_setstream(struct source *, FILE *);
 void		src_setstring(struct source *, char *);
+void		src_settext(struct source *, struct string *);
 struct number	*readnumber(struct source *, u_int);
 void		printnumber(FILE *, const struct number *, u_int);
 char		*read_string(struct source *);
 void		print_value(FILE *, const struct value *, const char *, u_int);
 void		print_ascii(FILE *, const struct number *);
 
+/* library.c */
+struct number	*bc_e(const struct number *, u_int);
+struct number	*bc_l(const struct number *, u_int);
+struct number	*bc_s(const struct number *, u_int);
+struct number	*bc_c(const struct number *, u_int);
+struct number	*bc_a(const struct number *, u_int);
+struct number	*bc_j(const struct number *, const struct number *, u_int);
+
 /* mem.c */
+void		init_number(struct number *);
+void		clear_number(struct number *);
 struct number	*new_number(void);
 void		free_number(struct number *);
 struct number	*dup_number(const struct number *);
+struct number	*box_number(const struct number *);
+void		unbox_number(struct number *, struct number *);
+void		free_number_pool(void);
+void		number_pool_count(void);
+void		number_pool_stats(void);
 void		*bmalloc(size_t);
 void		*breallocarray(void *, size_t, size_t);
 char		*bstrdup(const char *p);
@@ -45,18 +61,43 @@ void		stack_swap(struct stack *);
 size_t		stack_size(const struct stack *);
 void		stack_dup(struct stack *);
 void		stack_pushnumber(struct stack *, struct number *);
-void		stack_pushstring(struct stack *stack, char *);
+struct number	*stack_newnumber(struct stack *);
+void		stack_pushword(struct stack *, long);
+bool		stack_words(struct stack *, long **, long **);
+void		value_word(struct value *);
+void		value_unword(struct value *);
+void		stack_pushstring(struct stack *stack, struct string *);
 void		stack_push(struct stack *, struct value *);
 void		stack_set_tos(struct stack *, struct value *);
 struct value	*stack_tos(const struct stack *);
 struct value	*stack_pop(struct stack *);
 struct number	*stack_popnumber(struct stack *);
-char *		stack_popstring(struct stack *);
+bool		stack_binop(struct stack *, struct number **,
+		    struct number **);
+void		stack_dropnumber(struct stack *);
+struct string	*stack_popstring(struct stack *);
 void		stack_clear(struct stack *);
+void		stack_reset(struct stack *);
+void		stack_copy(struct stack *, const struct stack *);
+void		stack_copy_unshared(struct stack *, const struct stack *);
 void		stack_print(FILE *, const struct stack *, const char *,
 		    u_int base);
 void		frame_assign(struct stack *, size_t, const struct value *);
+struct string	*string_new(const char *, size_t);
+struct string	*string_ref(struct string *);
+void		string_unref(struct string *);
 struct value *	frame_retrieve(const struct stack *, size_t);
 /* void		frame_free(struct stack *); */
 
+#define MAX_THREADS	1024	/* most that -j takes */
+
 int		dc_main(int, char **);
+void		dc_init(void);
+void		dc_eval(char *);
+void		dc_threads(int);
+void		dc_array_max(long);
+void		dc_batch_init(int);
+void		dc_batch_eval(char *);
+void		dc_batch_end(void);
+void		dc_interrupt(void);
+bool		dc_native_library(void);
@@ -18,14 +18,13 @@
 
 #include <ctype.h>
 #include <err.h>
+#include <limits.h>
 #include <string.h>
 
 #include "extern.h"
 
 #define MAX_CHARS_PER_LINE 68
-
-static int	lastchar;
-static int	charcount;
+#define DIGIT_CHUNK	32	/* below this, convert digit by digit */
 
 static int	src_getcharstream(struct source *);
 static void	src_ungetcharstream(struct source *);
@@ -35,10 +34,13 @@ static int	src_getcharstring(struct source *);
 static void	src_ungetcharstring(struct source *);
 static char	*src_getlinestring(struct source *);
 static void	src_freestring(struct source *);
-static void	flushwrap(FILE *);
-static void	putcharwrap(FILE *, int);
-static void	printwrap(FILE *, const char *);
-static char	*get_digit(u_long, int, u_int);
+static int	base_powers(mpz_t *, u_int, size_t);
+static void	digits_set(mpz_t, const char *, size_t, u_int, mpz_t *);
+static void	set_digits(mpz_t, const char *, size_t, u_int);
+static void	digits_get(u_long *, const mpz_t, size_t, u_int, mpz_t *);
+static size_t	frac_digits(u_int, u_int);
+static char	*put_digits(char *, const mpz_t, size_t, u_int, int, bool);
+static void	printwrap(FILE *, const char *, size_t);
 
 static struct vtable stream_vtable = {
 	src_getcharstream,
@@ -66,6 +68,17 @@ src_setstring(struct source *src, char *p)
 {
 	src->u.string.buf = (u_char *)p;
 	src->u.string.pos = 0;
+	src->u.string.text = NULL;
+	src->vtable = &string_vtable;
+}
+
+/* Read the text of s, without copying it; takes the reference to s */
+void
+src_settext(struct source *src, struct string *s)
+{
+	src->u.string.buf = (u_char *)s->str;
+	src->u.string.pos = 0;
+	src->u.string.text = s;
 	src->vtable = &string_vtable;
 }
 
@@ -141,41 +154,226 @@ src_getlinestring(struct source *src)
 static void
 src_freestring(struct source *src)
 {
-	free(src->u.string.buf);
+	if (src->u.string.text != NULL)
+		string_unref(src->u.string.text);
+	else
+		free(src->u.string.buf);
 }
 
+/*
+ * Lines get MAX_CHARS_PER_LINE characters and a backslash, but the last
+ * character never starts a new line of its own.
+ */
 static void
-flushwrap(FILE *f)
+printwrap(FILE *f, const char *p, size_t len)
 {
-	if (lastchar != -1)
-		(void)putc(lastchar, f);
+	while (len > MAX_CHARS_PER_LINE + 1) {
+		(void)fwrite(p, 1, MAX_CHARS_PER_LINE, f);
+		(void)fputs("\\\n", f);
+		p += MAX_CHARS_PER_LINE;
+		len -= MAX_CHARS_PER_LINE;
+	}
+	(void)fwrite(p, 1, len, f);
 }
 
-static void
-putcharwrap(FILE *f, int ch)
+/* Set pow[k] = base^(DIGIT_CHUNK * 2^k) for all such exponents < len */
+static int
+base_powers(mpz_t *pow, u_int base, size_t len)
 {
-	if (charcount >= MAX_CHARS_PER_LINE) {
-		charcount = 0;
-		(void)fputs("\\\n", f);
+	size_t	lo;
+	int	n;
+
+	for (n = 0, lo = DIGIT_CHUNK; lo < len; n++, lo *= 2) {
+		mpz_init(pow[n]);
+		if (n == 0)
+			mpz_ui_pow_ui(pow[n], base, DIGIT_CHUNK);
+		else
+			mpz_mul(pow[n], pow[n - 1], pow[n - 1]);
 	}
-	if (lastchar != -1) {
-		charcount++;
-		(void)putc(lastchar, f);
+	return n;
+}
+
+/*
+ * Convert the digits at s, most significant first, with the low part
+ * always DIGIT_CHUNK * 2^k digits long so that pow[k] = base^that
+ * can be shared by the whole tree.
+ */
+static void
+digits_set(mpz_t r, const char *s, size_t len, u_int base, mpz_t *pow)
+{
+	size_t	lo;
+	int	k;
+	mpz_t	t;
+
+	if (len <= DIGIT_CHUNK) {
+		mpz_set_ui(r, 0);
+		while (len-- > 0) {
+			mpz_mul_ui(r, r, base);
+			mpz_add_ui(r, r, *s <= '9' ? *s - '0' : *s - 'A' + 10);
+			s++;
+		}
+		return;
 	}
-	lastchar = ch;
+	for (k = 0, lo = DIGIT_CHUNK; lo * 2 < len; k++)
+		lo *= 2;
+	mpz_init(t);
+	digits_set(r, s, len - lo, base, pow);
+	digits_set(t, s + len - lo, lo, base, pow);
+	mpz_mul(r, r, pow[k]);
+	mpz_add(r, r, t);
+	mpz_clear(t);
+}
+
+static void
+set_digits(mpz_t r, const char *s, size_t len, u_int base)
+{
+	mpz_t	pow[sizeof(size_t) * CHAR_BIT];
+	int	k, n;
+
+	n = base_powers(pow, base, len);
+	digits_set(r, s, len, base, pow);
+	for (k = 0; k < n; k++)
+		mpz_clear(pow[k]);
 }
 
+/* The inverse of digits_set(): the len lowest digits of n >= 0 */
 static void
-printwrap(FILE *f, const char *p)
+digits_get(u_long *d, const mpz_t n, size_t len, u_int base, mpz_t *pow)
+{
+	size_t	lo;
+	int	k;
+	mpz_t	q, r;
+
+	if (len <= DIGIT_CHUNK) {
+		mpz_init_set(q, n);
+		while (len-- > 0)
+			d[len] = mpz_tdiv_q_ui(q, q, base);
+		mpz_clear(q);
+		return;
+	}
+	for (k = 0, lo = DIGIT_CHUNK; lo * 2 < len; k++)
+		lo *= 2;
+	mpz_init(q);
+	mpz_init(r);
+	mpz_tdiv_qr(q, r, n, pow[k]);
+	digits_get(d, q, len - lo, base, pow);
+	digits_get(d + len - lo, r, lo, base, pow);
+	mpz_clear(q);
+	mpz_clear(r);
+}
+
+/* The number of base digits in a fraction of scale decimal digits */
+static size_t
+frac_digits(u_int base, u_int scale)
 {
-	char	buf[12];
-	char	*q = buf;
+	mpz_t	m, p;
+	size_t	k, lo, hi, mid;
+	int	bits;
+
+	if (base == 10)
+		return scale;
+
+	/* The smallest k with base^k > 10^scale - 1 */
+	mpz_init(m);
+	mpz_init(p);
+	mpz_sub_ui(m, power_of_ten(scale), 1);
+	if (base <= 62) {
+		/* mpz_sizeinbase() may be one too big */
+		k = mpz_sizeinbase(m, base);
+		mpz_ui_pow_ui(p, base, k - 1);
+		if (k > 1 && mpz_cmp(p, m) > 0)
+			k--;
+	} else {
+		/* 2^bits <= base < 2^(bits + 1) */
+		for (bits = 0; (base >> bits) > 1; bits++)
+			;
+		lo = (mpz_sizeinbase(m, 2) - 1) / (bits + 1);
+		hi = mpz_sizeinbase(m, 2) / bits + 1;
+		while (hi - lo > 1) {
+			mid = lo + (hi - lo) / 2;
+			mpz_ui_pow_ui(p, base, mid);
+			if (mpz_cmp(p, m) > 0)
+				hi = mid;
+			else
+				lo = mid;
+		}
+		k = hi;
+	}
+	mpz_clear(m);
+	mpz_clear(p);
+	return k;
+}
 
-	(void)strlcpy(buf, p, sizeof(buf));
-	while (*q)
-		putcharwrap(f, *q++);
+/*
+ * Append the digits of n >= 0 at p: exactly len of them, or as many as
+ * needed if len is 0.  Bases above 16 use a zero padded decimal number
+ * of the given width per digit, each preceded by a space unless it is
+ * the first one and lead is false.
+ */
+static char *
+put_digits(char *p, const mpz_t n, size_t len, u_int base, int width,
+    bool lead)
+{
+	char	*s;
+	u_long	*d, v;
+	size_t	nd, pad, i;
+	int	bits, j;
+	mpz_t	pow[sizeof(size_t) * CHAR_BIT];
+
+	if (base <= 62) {
+		/* Digits and upper case letters, then lower case above 36 */
+		s = bmalloc(mpz_sizeinbase(n, base) + 2);
+		(void)mpz_get_str(s, base <= 36 ? -(int)base : (int)base, n);
+		nd = strlen(s);
+		pad = len > nd ? len - nd : 0;
+		if (base <= 16) {
+			(void)memset(p, '0', pad);
+			(void)memcpy(p + pad, s, nd);
+			free(s);
+			return p + pad + nd;
+		}
+		d = breallocarray(NULL, pad + nd, sizeof(*d));
+		for (i = 0; i < pad; i++)
+			d[i] = 0;
+		for (i = 0; i < nd; i++) {
+			if (s[i] <= '9')
+				d[pad + i] = s[i] - '0';
+			else if (s[i] <= 'Z')
+				d[pad + i] = s[i] - 'A' + 10;
+			else
+				d[pad + i] = s[i] - 'a' + 36;
+		}
+		free(s);
+		nd += pad;
+	} else {
+		/* Each digit holds at least bits bits */
+		for (bits = 0; (base >> bits) > 1; bits++)
+			;
+		nd = len > 0 ? len : mpz_sizeinbase(n, 2) / bits + 1;
+		d = breallocarray(NULL, nd, sizeof(*d));
+		j = base_powers(pow, base, nd);
+		digits_get(d, n, nd, base, pow);
+		while (j-- > 0)
+			mpz_clear(pow[j]);
+		if (len == 0) {
+			for (i = 0; i < nd - 1 && d[i] == 0; i++)
+				;
+			nd -= i;
+			(void)memmove(d, d + i, nd * sizeof(*d));
+		}
+	}
+	for (i = 0; i < nd; i++) {
+		if (i > 0 || lead)
+			*p++ = ' ';
+		for (v = d[i], j = width; j-- > 0; v /= 10)
+			p[j] = '0' + v % 10;
+		p += width;
+	}
+	free(d);
+	return p;
 }
 
+
 struct number *
 readnumber(struct source *src, u_int base)
 {
@@ -183,11 +381,15 @@ readnumber(struct source *src, u_int base)
 	int		ch;
 	bool		sign = false;
 	bool		dot = false;
-	mp_limb_t	v;
-	u_int		i;
+	bool		in_base = true;
+	u_int		v;
+	char		sbuf[128], *buf = sbuf;
+	size_t		len = 0, sz = sizeof(sbuf);
+	mpz_t		p;
 
 	n = new_number();
 
+	/* Gather the digits, then convert them in one go */
 	while ((ch = (*src->vtable->readchar)(src)) != EOF) {
 
 		if ('0' <= ch && ch <= '9')
@@ -209,13 +411,33 @@ readnumber(struct source *src, u_int base)
 		if (dot)
 			n->scale++;
 
-		mpz_mul_ui(n->number, n->number, base);
-		mpz_add_ui(n->number, n->number, v);
+		if (v >= base)
+			in_base = false;
+		if (len + 1 == sz) {
+			sz *= 2;
+			if (buf == sbuf) {
+				buf = bmalloc(sz);
+				memcpy(buf, sbuf, len);
+			} else
+				buf = breallocarray(buf, 1, sz);
+		}
+		buf[len++] = ch;
 	}
-	if (base != 10) {
+	buf[len] = '\0';
+	/* mpz_set_str() is subquadratic, but rejects digits >= base */
+	if (len > 0 && in_base)
+		(void)mpz_set_str(n->number, buf, base);
+	else if (len > 0)
+		set_digits(n->number, buf, len, base);
+	if (buf != sbuf)
+		free(buf);
+	if (base != 10 && n->scale > 0) {
+		/* Truncating once by base^scale is the same as per digit */
 		scale_number(n->number, n->scale);
-		for (i = 0; i < n->scale; i++)
-			(void)mpz_tdiv_q_ui(n->number, n->number, base);
+		mpz_init(p);
+		mpz_ui_pow_ui(p, base, n->scale);
+		mpz_tdiv_q(n->number, n->number, p);
+		mpz_clear(p);
 	}
 	if (sign)
 		negate(n);
@@ -260,111 +482,66 @@ read_string(struct source *src)
 	return p;
 }
 
-static char *
-get_digit(u_long num, int digits, u_int base)
-{
-	char *p;
-
-	if (base <= 16) {
-		p = bmalloc(2);
-		p[0] = num >= 10 ? num + 'A' - 10 : num + '0';
-		p[1] = '\0';
-	} else {
-		if (asprintf(&p, "%0*lu", digits, num) == -1)
-			err(1, NULL);
-	}
-	return p;
-}
-
 void
 printnumber(FILE *f, const struct number *b, u_int base)
 {
-	struct number	*int_part, *fract_part;
-	int		digits;
-	char		buf[11];
-	size_t		sz;
-	int		i;
-	struct stack	stack;
-	char		*p;
-
-	charcount = 0;
-	lastchar = -1;
-	if (0 == mpz_sgn(b->number))
-		putcharwrap(f, '0');
-
-	int_part = new_number();
-	fract_part = new_number();
-	fract_part->scale = b->scale;
+	mpz_t		int_part, fract_part, t;
+	int		width, bits;
+	char		buf[11], *out, *p;
+	size_t		ni, nf, sz;
 
 	if (base <= 16)
-		digits = 1;
+		width = 1;
+	else
+		width = snprintf(buf, sizeof(buf), "%u", base-1);
+
+	mpz_init(int_part);
+	mpz_init(fract_part);
+	split_number(b, int_part, fract_part);
+	mpz_abs(int_part, int_part);
+	mpz_abs(fract_part, fract_part);
+
+	/* Bounds on the number of digits, then the size of the text */
+	if (base <= 62)
+		ni = mpz_sizeinbase(int_part, base);
 	else {
-		digits = snprintf(buf, sizeof(buf), "%u", base-1);
+		for (bits = 0; (base >> bits) > 1; bits++)
+			;
+		ni = mpz_sizeinbase(int_part, 2) / bits + 1;
 	}
-	split_number(b, int_part->number, fract_part->number);
+	nf = b->scale > 0 ? frac_digits(base, b->scale) : 0;
+	sz = 3 + (ni + nf) * (width + (base > 16 ? 1 : 0));
+	p = out = bmalloc(sz);
 
-	i = 0;
-	stack_init(&stack);
-	while (0 != mpz_sgn(int_part->number)) {
-		mp_limb_t rem = mpz_tdiv_q_ui(int_part->number, int_part->number, base);
-		stack_pushstring(&stack, get_digit(rem, digits, base));
-		i++;
-	}
-	sz = i;
+	if (0 == mpz_sgn(b->number))
+		*p++ = '0';
 	if (-1 == mpz_sgn(b->number))
-		putcharwrap(f, '-');
-	for (i = 0; i < sz; i++) {
-		p = stack_popstring(&stack);
-		if (base > 16)
-			putcharwrap(f, ' ');
-		printwrap(f, p);
-		free(p);
-	}
-	stack_clear(&stack);
+		*p++ = '-';
+	if (0 != mpz_sgn(int_part))
+		p = put_digits(p, int_part, 0, base, width, true);
 	if (b->scale > 0) {
-		struct number	*num_base;
-		mpz_t		mult, stop;
-
-		putcharwrap(f, '.');
-		num_base = new_number();
-		mpz_set_ui(num_base->number, base);
-		mpz_init_set_ui(mult, 1U);
-		mpz_init_set_ui(stop, 1U);
-		scale_number(stop, b->scale);
-
-		i = 0;
-		while (mpz_cmp(mult, stop) < 0) {
-			u_long	rem;
-
-			if (i && base > 16)
-				putcharwrap(f, ' ');
-			i = 1;
-
-			bmul_number(fract_part, fract_part, num_base,
-			    bmachine_scale());
-			split_number(fract_part, int_part->number, NULL);
-			rem = mpz_get_ui(int_part->number);
-			p = get_digit(rem, digits, base);
-			int_part->scale = 0;
-			normalize(int_part, fract_part->scale);
-			mpz_sub(fract_part->number, fract_part->number,
-			    int_part->number);
-			printwrap(f, p);
-			free(p);
-			mpz_mul_ui(mult, mult, base);
+		/* The first nf digits of fract_part / 10^scale in base */
+		*p++ = '.';
+		if (base != 10) {
+			mpz_init(t);
+			mpz_ui_pow_ui(t, base, nf);
+			mpz_mul(fract_part, fract_part, t);
+			scale_number(fract_part, -(int)b->scale);
+			mpz_clear(t);
 		}
-		free_number(num_base);
-		mpz_clear(mult);
-		mpz_clear(stop);
+		p = put_digits(p, fract_part, nf, base, width, false);
 	}
-	flushwrap(f);
-	free_number(int_part);
-	free_number(fract_part);
+	printwrap(f, out, p - out);
+	free(out);
+	mpz_clear(int_part);
+	mpz_clear(fract_part);
 }
 
 void
 print_value(FILE *f, const struct value *value, const char *prefix, u_int base)
 {
+	struct number	n;
+
 	(void)fputs(prefix, f);
 	switch (value->type) {
 	case BCODE_NONE:
@@ -372,10 +549,16 @@ print_value(FILE *f, const struct value *value, const char *prefix, u_int base)
 			(void)fputs("<array>", f);
 		break;
 	case BCODE_NUMBER:
-		printnumber(f, value->u.num, base);
+		if (value->in_word) {
+			init_number(&n);
+			mpz_set_si(n.number, value->u.word);
+			printnumber(f, &n, base);
+			clear_number(&n);
+		} else
+			printnumber(f, &value->u.num, base);
 		break;
 	case BCODE_STRING:
-		(void)fputs(value->u.string, f);
+		(void)fputs(value->u.string->str, f);
 		break;
 	}
 }
@@ -0,0 +1,847 @@
+/*
+ * Native versions of the functions of the bc math library, bc.library.
+ *
+ * Each function follows its bc.library counterpart step by step, with
+ * the same scales and the same truncations, so that it returns the
+ * same digits.  What is left out is work that cannot change the
+ * result: the series loops only compute the truncated partial sum for
+ * terms that are not certain to change it, and e() sums the leading
+ * terms for an integer argument by binary splitting.
+ */
+
+#include <err.h>
+#include <limits.h>
+#include <string.h>
+
+#include "extern.h"
+
+#define LOG2_10		3.32192809488736234787
+
+/* a(1) for scale < 52, as bc.library has it */
+#define ATAN_ONE	".7853981633974483096156608458198757210492923498437764"
+
+static struct number	*num_ui(u_long);
+static struct number	*num_str(const char *);
+static void		mul(struct number *, const struct number *,
+			    const struct number *, u_int);
+static void		divide(struct number *, const struct number *,
+			    const struct number *, u_int);
+static void		add(struct number *, const struct number *,
+			    const struct number *);
+static void		sub(struct number *, const struct number *,
+			    const struct number *);
+static int		cmp(const struct number *, const struct number *);
+static int		cmp_str(const struct number *, const char *);
+static u_int		set_scale(const struct number *, u_int);
+static u_long		integer_digits(const struct number *);
+static bool		is_integer(const struct number *);
+static bool		changes_sum(const mpz_t, u_int, const mpz_t, u_int,
+			    u_int);
+static u_long		exp_terms(u_long, u_int);
+static void		exp_split(mpz_t, mpz_t, u_long, u_long, u_long);
+
+static struct number *
+num_ui(u_long v)
+{
+	struct number *n;
+
+	n = new_number();
+	mpz_set_ui(n->number, v);
+	return n;
+}
+
+/* A decimal constant as bc.library writes it */
+static struct number *
+num_str(const char *str)
+{
+	struct number	*n;
+	char		buf[64];
+	const char	*p;
+	size_t		len;
+
+	n = new_number();
+	p = strchr(str, '.');
+	if (p == NULL) {
+		(void)mpz_set_str(n->number, str, 10);
+		return n;
+	}
+	len = p - str;
+	(void)memcpy(buf, str, len);
+	(void)strlcpy(buf + len, p + 1, sizeof(buf) - len);
+	if (buf[0] != '\0')
+		(void)mpz_set_str(n->number, buf, 10);
+	n->scale = strlen(p + 1);
+	return n;
+}
+
+/* r = a * b, truncated like dc's * at the given scale */
+static void
+mul(struct number *r, const struct number *a, const struct number *b,
+    u_int scale)
+{
+	u_int ascale = a->scale, bscale = b->scale;
+
+	mpz_mul(r->number, a->number, b->number);
+	r->scale = ascale + bscale;
+	if (r->scale > scale && r->scale > ascale && r->scale > bscale) {
+		if (scale < ascale)
+			scale = ascale;
+		if (scale < bscale)
+			scale = bscale;
+		normalize(r, scale);
+	}
+}
+
+/* r = a / b, truncated like dc's / at the given scale */
+static void
+divide(struct number *r, const struct number *a, const struct number *b,
+    u_int scale)
+{
+	mpz_t	n, d;
+
+	if (mpz_sgn(b->number) == 0) {
+		bwarnx("divide by zero");
+		mpz_set_ui(r->number, 0);
+		r->scale = scale;
+		return;
+	}
+	/* a * 10^(scale + b->scale) / (b * 10^a->scale) */
+	mpz_init_set(n, a->number);
+	mpz_init_set(d, b->number);
+	if (scale + b->scale >= a->scale)
+		scale_number(n, scale + b->scale - a->scale);
+	else
+		scale_number(d, a->scale - scale - b->scale);
+	mpz_tdiv_q(r->number, n, d);
+	r->scale = scale;
+	mpz_clear(n);
+	mpz_clear(d);
+}
+
+static void
+add(struct number *r, const struct number *a, const struct number *b)
+{
+	mpz_t	t;
+
+	mpz_init(t);
+	if (a->scale < b->scale) {
+		mpz_mul(t, a->number, power_of_ten(b->scale - a->scale));
+		mpz_add(r->number, t, b->number);
+		r->scale = b->scale;
+	} else {
+		mpz_mul(t, b->number, power_of_ten(a->scale - b->scale));
+		mpz_add(r->number, a->number, t);
+		r->scale = a->scale;
+	}
+	mpz_clear(t);
+}
+
+static void
+sub(struct number *r, const struct number *a, const struct number *b)
+{
+	mpz_t	t;
+
+	mpz_init(t);
+	if (a->scale < b->scale) {
+		mpz_mul(t, a->number, power_of_ten(b->scale - a->scale));
+		mpz_sub(r->number, t, b->number);
+		r->scale = b->scale;
+	} else {
+		mpz_mul(t, b->number, power_of_ten(a->scale - b->scale));
+		mpz_sub(r->number, a->number, t);
+		r->scale = a->scale;
+	}
+	mpz_clear(t);
+}
+
+static int
+cmp(const struct number *a, const struct number *b)
+{
+	mpz_t	t;
+	int	c;
+
+	if (a->scale == b->scale)
+		return mpz_cmp(a->number, b->number);
+	mpz_init(t);
+	if (a->scale < b->scale) {
+		mpz_mul(t, a->number, power_of_ten(b->scale - a->scale));
+		c = mpz_cmp(t, b->number);
+	} else {
+		mpz_mul(t, b->number, power_of_ten(a->scale - b->scale));
+		c = mpz_cmp(a->number, t);
+	}
+	mpz_clear(t);
+	return c;
+}
+
+static int
+cmp_str(const struct number *a, const char *str)
+{
+	struct number	*b;
+	int		c;
+
+	b = num_str(str);
+	c = cmp(a, b);
+	free_number(b);
+	return c;
+}
+
+/* The scale after "scale = n", including dc's complaints */
+static u_int
+set_scale(const struct number *n, u_int scale)
+{
+	mpz_t	i;
+	u_long	v;
+
+	if (mpz_sgn(n->number) < 0) {
+		bwarnx("scale must be a nonnegative number");
+		return scale;
+	}
+	mpz_init(i);
+	split_number(n, i, NULL);
+	v = mpz_get_ui(i);
+	mpz_clear(i);
+	if (v != GMP_NUMB_MASK && v <= UINT_MAX)
+		return (u_int)v;
+	bwarnx("scale too large");
+	return scale;
+}
+
+/* length(n) - scale(n) */
+static u_long
+integer_digits(const struct number *n)
+{
+	return count_digits(n) - n->scale;
+}
+
+static bool
+is_integer(const struct number *n)
+{
+	mpz_t	i, f;
+	bool	r;
+
+	mpz_init(i);
+	mpz_init(f);
+	split_number(n, i, f);
+	r = mpz_sgn(f) == 0;
+	mpz_clear(i);
+	mpz_clear(f);
+	return r;
+}
+
+/*
+ * Whether adding num / den (with the given scales) to a partial sum
+ * surely changes it when truncated to scale digits, going by sizes
+ * alone.  A step of two units in the last place does that, whatever
+ * the signs.  The logarithms are rounded, hence the margin.
+ */
+static bool
+changes_sum(const mpz_t num, u_int nscale, const mpz_t den, u_int dscale,
+    u_int scale)
+{
+	double	lhs, rhs;
+
+	if (mpz_sgn(num) == 0)
+		return false;
+	/* |num| * 10^(scale + dscale) >= 2 * |den| * 10^nscale */
+	lhs = (double)mpz_sizeinbase(num, 2) - 1 +
+	    ((double)scale + dscale) * LOG2_10;
+	rhs = (double)mpz_sizeinbase(den, 2) + 1 + (double)nscale * LOG2_10;
+	return lhs - rhs >= 2;
+}
+
+/*
+ * The number of leading terms x^k / k! of e(x), x = 1 or 2, that surely
+ * change the partial sum at scale digits.  The terms decrease, so it
+ * is enough to find the last of them, keeping log2(k! / x^k) as an
+ * exponent and a mantissa in [1, 2).
+ */
+static u_long
+exp_terms(u_long x, u_int scale)
+{
+	double	m, limit;
+	u_long	k, e;
+
+	/* 2 * 10^-scale, with a margin of more than a digit */
+	limit = (double)scale * LOG2_10 - 6;
+	m = 1;
+	e = 0;
+	for (k = 1; ; k++) {
+		m = m * k / x;
+		while (m >= 2) {
+			m /= 2;
+			e++;
+		}
+		/* log2(k! / x^k) < e + 1 */
+		if (e + 1 > limit)
+			return k - 1;
+	}
+}
+
+/*
+ * Binary splitting of the sum over a < j <= b of x^(j - a) * a! / j!,
+ * which is t / q with q = b! / a!.
+ */
+static void
+exp_split(mpz_t t, mpz_t q, u_long x, u_long a, u_long b)
+{
+	mpz_t	t2, q2;
+	u_long	m;
+
+	if (b - a == 1) {
+		mpz_set_ui(t, x);
+		mpz_set_ui(q, b);
+		return;
+	}
+	m = a + (b - a) / 2;
+	mpz_init(t2);
+	mpz_init(q2);
+	exp_split(t, q, x, a, m);
+	exp_split(t2, q2, x, m, b);
+	mpz_mul(t, t, q2);
+	if (x == 2)
+		mpz_mul_2exp(t2, t2, m - a);
+	mpz_add(t, t, t2);
+	mpz_mul(q, q, q2);
+	mpz_clear(t2);
+	mpz_clear(q2);
+}
+
+struct number *
+bc_e(const struct number *arg, u_int t)
+{
+	struct number	*x, *a, *b, *c, *d, *e, *g, *cp, *dp, *one, *two, *r;
+	u_int		scale;
+	u_long		y, k, n;
+	bool		w, have_e;
+
+	x = dup_number(arg);
+	one = num_ui(1);
+	two = num_ui(2);
+	r = new_number();
+
+	scale = 0;
+	if (mpz_sgn(x->number) > 0) {
+		a = num_str("0.435");
+		mul(r, a, x, scale);
+		divide(r, r, one, scale);
+		scale = set_scale(r, scale);
+		free_number(a);
+	}
+	mpz_set_ui(r->number, scale);
+	mpz_add_ui(r->number, r->number, t);
+	r->scale = 0;
+	mpz_add_ui(r->number, r->number, count_digits(r) + 1);
+	scale = set_scale(r, scale);
+
+	w = false;
+	if (mpz_sgn(x->number) < 0) {
+		negate(x);
+		w = true;
+	}
+	y = 0;
+	while (cmp(x, two) > 0) {
+		divide(x, x, two, scale);
+		y++;
+	}
+
+	b = num_ui(1);
+	c = num_ui(1);
+	d = num_ui(1);
+	e = num_ui(1);
+	g = new_number();
+	cp = new_number();
+	dp = new_number();
+	have_e = true;
+	k = 1;
+
+	/* An integer x leaves every term exact: sum the first ones at once */
+	if (mpz_sgn(x->number) > 0 && is_integer(x)) {
+		split_number(x, r->number, NULL);
+		n = exp_terms(mpz_get_ui(r->number), scale);
+		if (n > 1) {
+			exp_split(c->number, d->number, mpz_get_ui(r->number),
+			    0, n);
+			mpz_add(c->number, c->number, d->number);
+			mpz_pow_ui(b->number, r->number, n);
+			have_e = false;
+			k = n + 1;
+		}
+	}
+
+	for (;; k++) {
+		if (!have_e) {
+			mpz_set(cp->number, c->number);
+			cp->scale = c->scale;
+			mpz_set(dp->number, d->number);
+		}
+		mul(b, b, x, scale);
+		mpz_mul_ui(c->number, c->number, k);
+		add(c, c, b);
+		mpz_mul_ui(d->number, d->number, k);
+		/* The sum grows by b / d */
+		if (changes_sum(b->number, b->scale, d->number, 0, scale)) {
+			have_e = false;
+			continue;
+		}
+		divide(g, c, d, scale);
+		if (!have_e)
+			divide(e, cp, dp, scale);
+		if (cmp(g, e) == 0)
+			break;
+		mpz_swap(e->number, g->number);
+		e->scale = g->scale;
+		have_e = true;
+	}
+
+	divide(g, g, one, scale);
+	while (y-- > 0)
+		mul(g, g, g, scale);
+	if (w)
+		divide(r, one, g, t);
+	else
+		divide(r, g, one, t);
+
+	free_number(x);
+	free_number(b);
+	free_number(c);
+	free_number(d);
+	free_number(e);
+	free_number(g);
+	free_number(cp);
+	free_number(dp);
+	free_number(one);
+	free_number(two);
+	return r;
+}
+
+struct number *
+bc_l(const struct number *arg, u_int t)
+{
+	struct number	*x, *f, *u, *s, *b, *c, *d, *e, *g, *cp, *dp, *v, *r;
+	struct number	*one;
+	u_int		scale, len;
+	u_long		k;
+	bool		have_e;
+
+	r = new_number();
+	if (mpz_sgn(arg->number) <= 0) {
+		mpz_ui_pow_ui(r->number, 10, t);
+		mpz_ui_sub(r->number, 1, r->number);
+		return r;
+	}
+
+	x = dup_number(arg);
+	one = num_ui(1);
+	f = num_ui(1);
+	v = new_number();
+
+	/* The estimated length of the answer */
+	if (cmp(x, one) < 0)
+		mpz_set_ui(v->number, x->scale);
+	else
+		mpz_set_ui(v->number, integer_digits(x));
+	scale = 0;
+	u = num_str("2.31");
+	mul(r, u, v, scale);
+	divide(r, r, one, scale);
+	len = t + count_digits(r) + 2;
+
+	while (cmp_str(x, "2") > 0) {
+		mpz_set_ui(v->number, count_digits(x) + x->scale);
+		v->scale = 0;
+		mpz_tdiv_q_2exp(v->number, v->number, 1);
+		mpz_add_ui(v->number, v->number, 1);
+		scale = set_scale(v, 0);
+		if (scale < len)
+			scale = len;
+		sqrt_number(x, x, scale);
+		mpz_mul_2exp(f->number, f->number, 1);
+	}
+	while (cmp_str(x, ".5") < 0) {
+		scale = x->scale / 2 + 1;
+		if (scale < len)
+			scale = len;
+		sqrt_number(x, x, scale);
+		mpz_mul_2exp(f->number, f->number, 1);
+	}
+
+	/* t + length(f) + length((1.05*(t+length(f))/1)) + 1 */
+	len = count_digits(f);
+	mpz_set_ui(v->number, t + len);
+	v->scale = 0;
+	free_number(u);
+	u = num_str("1.05");
+	mul(r, u, v, 0);
+	divide(r, r, one, 0);
+	scale = t + len + count_digits(r) + 1;
+
+	sub(r, x, one);
+	add(v, x, one);
+	divide(u, r, v, scale);
+	s = new_number();
+	mul(s, u, u, scale);
+	scale = t + 2;
+
+	b = dup_number(f);
+	mpz_mul_2exp(b->number, b->number, 1);
+	c = dup_number(b);
+	d = num_ui(1);
+	e = num_ui(1);
+	g = new_number();
+	cp = new_number();
+	dp = new_number();
+	have_e = true;
+	for (k = 3;; k += 2) {
+		if (!have_e) {
+			mpz_set(cp->number, c->number);
+			cp->scale = c->scale;
+			mpz_set(dp->number, d->number);
+		}
+		mul(b, b, s, scale);
+		mpz_mul_ui(c->number, c->number, k);
+		mpz_mul(v->number, d->number, b->number);
+		v->scale = b->scale;
+		add(c, c, v);
+		mpz_mul_ui(d->number, d->number, k);
+		/* The sum grows by b / k */
+		mpz_set_ui(v->number, k);
+		if (changes_sum(b->number, b->scale, v->number, 0, scale)) {
+			have_e = false;
+			continue;
+		}
+		divide(g, c, d, scale);
+		if (!have_e)
+			divide(e, cp, dp, scale);
+		if (cmp(g, e) == 0)
+			break;
+		mpz_swap(e->number, g->number);
+		e->scale = g->scale;
+		have_e = true;
+	}
+	mul(v, u, c, t);
+	divide(r, v, d, t);
+
+	free_number(x);
+	free_number(f);
+	free_number(u);
+	free_number(s);
+	free_number(b);
+	free_number(c);
+	free_number(d);
+	free_number(e);
+	free_number(g);
+	free_number(cp);
+	free_number(dp);
+	free_number(v);
+	free_number(one);
+	return r;
+}
+
+struct number *
+bc_s(const struct number *arg, u_int t)
+{
+	struct number	*x, *y, *p, *n, *a, *b, *c, *s, *v, *r;
+	u_int		scale;
+	u_long		i;
+
+	x = dup_number(arg);
+	v = new_number();
+	r = new_number();
+
+	y = num_str(".7853");
+	divide(v, x, y, t);
+	scale = t + count_digits(v) - v->scale;
+	if (scale < t)
+		scale = t;
+	p = num_ui(1);
+	a = bc_a(p, scale);
+	free_number(p);
+	p = a;
+
+	/* n = (x/(2*p) +- 1)/2, at scale 0 */
+	n = num_ui(2);
+	mul(v, n, p, 0);
+	divide(v, x, v, 0);
+	mpz_set_ui(n->number, 1);
+	if (mpz_sgn(x->number) >= 0)
+		add(v, v, n);
+	else
+		sub(v, v, n);
+	mpz_set_ui(n->number, 2);
+	divide(n, v, n, 0);
+	mpz_mul_ui(v->number, n->number, 4);
+	v->scale = n->scale;
+	mul(v, v, p, 0);
+	sub(x, x, v);
+	if (mpz_odd_p(n->number))
+		negate(x);
+
+	/* t + length(1.2*t) - scale(1.2*t) */
+	mpz_set_ui(v->number, t);
+	v->scale = 0;
+	b = num_str("1.2");
+	mul(r, b, v, 0);
+	scale = t + count_digits(r) - r->scale;
+
+	mpz_neg(v->number, x->number);
+	v->scale = x->scale;
+	mul(y, v, x, scale);
+	a = dup_number(x);
+	mpz_set_ui(b->number, 1);
+	b->scale = 0;
+	c = new_number();
+	s = dup_number(x);
+	for (i = 3;; i += 2) {
+		mul(a, a, y, scale);
+		mpz_mul_ui(b->number, b->number, i);
+		mpz_mul_ui(b->number, b->number, i - 1);
+		divide(c, a, b, scale);
+		if (mpz_sgn(c->number) == 0)
+			break;
+		add(s, s, c);
+	}
+	mpz_set_ui(v->number, 1);
+	v->scale = 0;
+	divide(r, s, v, t);
+
+	free_number(x);
+	free_number(y);
+	free_number(p);
+	free_number(n);
+	free_number(a);
+	free_number(b);
+	free_number(c);
+	free_number(s);
+	free_number(v);
+	return r;
+}
+
+struct number *
+bc_c(const struct number *arg, u_int t)
+{
+	struct number	*p, *v, *r;
+
+	v = num_ui(1);
+	p = bc_a(v, t + 1);
+	mpz_set_ui(v->number, 2);
+	mul(v, v, p, t + 1);
+	add(v, arg, v);
+	free_number(p);
+	p = bc_s(v, t + 1);
+	mpz_set_ui(v->number, 1);
+	v->scale = 0;
+	r = new_number();
+	divide(r, p, v, t);
+	free_number(p);
+	free_number(v);
+	return r;
+}
+
+struct number *
+bc_a(const struct number *arg, u_int t)
+{
+	struct number	*x, *f, *s, *b, *c, *d, *e, *g, *cp, *dp, *v, *one;
+	struct number	*r;
+	u_int		scale;
+	u_long		k;
+	bool		have_e;
+
+	r = new_number();
+	if (mpz_sgn(arg->number) == 0)
+		return r;
+	one = num_ui(1);
+	if (cmp(arg, one) == 0 && t < 52) {
+		v = num_str(ATAN_ONE);
+		divide(r, v, one, t);
+		free_number(v);
+		free_number(one);
+		return r;
+	}
+
+	x = dup_number(arg);
+	f = num_ui(1);
+	v = new_number();
+	scale = t;
+	while (cmp_str(x, ".5") > 0 || cmp_str(x, "-.5") < 0) {
+		/* x = -(1 - sqrt(1. + x*x))/x */
+		scale++;
+		mul(v, x, x, scale);
+		add(v, one, v);
+		sqrt_number(v, v, scale);
+		sub(v, one, v);
+		negate(v);
+		divide(x, v, x, scale);
+		mpz_mul_2exp(f->number, f->number, 1);
+	}
+
+	mpz_neg(v->number, x->number);
+	v->scale = x->scale;
+	s = new_number();
+	mul(s, v, x, scale);
+	b = dup_number(f);
+	c = dup_number(f);
+	d = num_ui(1);
+	e = num_ui(1);
+	g = new_number();
+	cp = new_number();
+	dp = new_number();
+	have_e = true;
+	for (k = 3;; k += 2) {
+		if (!have_e) {
+			mpz_set(cp->number, c->number);
+			cp->scale = c->scale;
+			mpz_set(dp->number, d->number);
+		}
+		mul(b, b, s, scale);
+		mpz_mul_ui(c->number, c->number, k);
+		mpz_mul(v->number, d->number, b->number);
+		v->scale = b->scale;
+		add(c, c, v);
+		mpz_mul_ui(d->number, d->number, k);
+		/* The sum changes by b / k */
+		mpz_set_ui(v->number, k);
+		if (changes_sum(b->number, b->scale, v->number, 0, scale)) {
+			have_e = false;
+			continue;
+		}
+		divide(g, c, d, scale);
+		if (!have_e)
+			divide(e, cp, dp, scale);
+		if (cmp(g, e) == 0)
+			break;
+		mpz_swap(e->number, g->number);
+		e->scale = g->scale;
+		have_e = true;
+	}
+	mul(v, x, c, t);
+	divide(r, v, d, t);
+
+	free_number(x);
+	free_number(f);
+	free_number(s);
+	free_number(b);
+	free_number(c);
+	free_number(d);
+	free_number(e);
+	free_number(g);
+	free_number(cp);
+	free_number(dp);
+	free_number(v);
+	free_number(one);
+	return r;
+}
+
+struct number *
+bc_j(const struct number *narg, const struct number *xarg, u_int t)
+{
+	struct number	*n, *x, *k, *s, *a, *b, *c, *e, *g, *bp, *cp, *v, *w;
+	struct number	*r;
+	u_int		scale;
+	u_long		i;
+	long		kk;
+	bool		exact, have_e;
+
+	n = dup_number(narg);
+	x = dup_number(xarg);
+	v = new_number();
+	w = new_number();
+	r = new_number();
+
+	/* k = length(1.36*x + 1.16*t - n) - scale(...) */
+	k = num_str("1.36");
+	mul(v, k, x, t);
+	free_number(k);
+	k = num_str("1.16");
+	mpz_set_ui(w->number, t);
+	mul(w, k, w, t);
+	add(v, v, w);
+	sub(v, v, n);
+	kk = (long)count_digits(v) - (long)v->scale;
+	scale = t;
+	if (kk > 0)
+		scale += kk;
+
+	/* s = -x*x/4 */
+	mpz_neg(v->number, x->number);
+	v->scale = x->scale;
+	s = new_number();
+	mul(s, v, x, scale);
+	mpz_set_ui(w->number, 4);
+	w->scale = 0;
+	divide(s, s, w, scale);
+	if (mpz_sgn(n->number) < 0) {
+		negate(n);
+		negate(x);
+	}
+
+	a = num_ui(1);
+	c = num_ui(1);
+	for (i = 1;; i++) {
+		mpz_set_ui(w->number, i);
+		w->scale = 0;
+		if (cmp(w, n) > 0)
+			break;
+		mul(a, a, x, scale);
+		mpz_mul_ui(c->number, c->number, 2);
+		mpz_mul_ui(c->number, c->number, i);
+	}
+
+	/* With an integer n the sum changes exactly by a / c */
+	exact = is_integer(n);
+	b = dup_number(a);
+	e = num_ui(1);
+	g = new_number();
+	bp = new_number();
+	cp = new_number();
+	have_e = true;
+	for (i = 1;; i++) {
+		if (!have_e) {
+			mpz_set(bp->number, b->number);
+			bp->scale = b->scale;
+			mpz_set(cp->number, c->number);
+			cp->scale = c->scale;
+		}
+		mul(a, a, s, scale);
+		/* b = b*i*(n + i) + a; c = c*i*(n + i) */
+		mpz_set_ui(w->number, i);
+		w->scale = 0;
+		add(v, n, w);
+		mul(b, b, w, scale);
+		mul(b, b, v, scale);
+		add(b, b, a);
+		mul(c, c, w, scale);
+		mul(c, c, v, scale);
+		if (exact && changes_sum(a->number, a->scale, c->number,
+		    c->scale, scale)) {
+			have_e = false;
+			continue;
+		}
+		divide(g, b, c, scale);
+		if (!have_e)
+			divide(e, bp, cp, scale);
+		if (cmp(g, e) == 0)
+			break;
+		mpz_swap(e->number, g->number);
+		e->scale = g->scale;
+		have_e = true;
+	}
+	mpz_set_ui(w->number, 1);
+	w->scale = 0;
+	divide(r, g, w, t);
+
+	free_number(n);
+	free_number(x);
+	free_number(k);
+	free_number(s);
+	free_number(a);
+	free_number(b);
+	free_number(c);
+	free_number(e);
+	free_number(g);
+	free_number(bp);
+	free_number(cp);
+	free_number(v);
+	free_number(w);
+	return r;
+}
@@ -17,27 +17,133 @@
  */
 
 #include <err.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "extern.h"
 
+#define NUMBER_POOL_SIZE	1024
+#define NUMBER_POOL_LIMBS	1024	/* bigger numbers are not kept */
+#define SHELL_POOL_SIZE		64
+
+/*
+ * Numbers live inline in stack values; freed ones leave their mpz_t
+ * here, still initialized, so that the limbs they own are reused by
+ * the next init_number().  The struct number allocations handed out by
+ * new_number() are recycled separately.  Each thread has its own pools.
+ * How many init_number() calls the pool served (hits) or not (misses)
+ * is counted, and added to the totals when the thread is done with it,
+ * or by the workers of parallel loops after each loop.
+ */
+static __thread struct {
+	mpz_t		free[NUMBER_POOL_SIZE];
+	size_t		count;
+	struct number	*shells[SHELL_POOL_SIZE];
+	size_t		nshells;
+	u_long		hits;
+	u_long		misses;
+} pool;
+
+static struct {
+	pthread_mutex_t	lock;
+	u_long		hits;
+	u_long		misses;
+} pool_totals = { PTHREAD_MUTEX_INITIALIZER, 0, 0 };
+
+/* Add this thread's hits and misses to the totals */
+void
+number_pool_count(void)
+{
+	(void)pthread_mutex_lock(&pool_totals.lock);
+	pool_totals.hits += pool.hits;
+	pool_totals.misses += pool.misses;
+	(void)pthread_mutex_unlock(&pool_totals.lock);
+	pool.hits = pool.misses = 0;
+}
+
+static void
+pool_report(void)
+{
+	u_long	total;
+
+	number_pool_count();
+	total = pool_totals.hits + pool_totals.misses;
+	(void)fprintf(stderr, "number pool: %lu hits, %lu misses (%.1f%%)\n",
+	    pool_totals.hits, pool_totals.misses,
+	    total == 0 ? 0.0 : 100.0 * pool_totals.hits / total);
+}
+
+/*
+ * With DC_POOL_STATS in the environment, the hits and misses of all
+ * threads are written to stderr at exit.  Called once, by the thread
+ * that will exit.
+ */
+void
+number_pool_stats(void)
+{
+	if (getenv("DC_POOL_STATS") != NULL)
+		(void)atexit(pool_report);
+}
+
+static __inline struct number *
+shell_get(void)
+{
+	if (pool.nshells > 0)
+		return pool.shells[--pool.nshells];
+	return bmalloc(sizeof(struct number));
+}
+
+static __inline void
+shell_put(struct number *n)
+{
+	if (pool.nshells < SHELL_POOL_SIZE)
+		pool.shells[pool.nshells++] = n;
+	else
+		free(n);
+}
+
+void
+init_number(struct number *n)
+{
+	n->scale = 0;
+	if (pool.count > 0) {
+		pool.hits++;
+		*n->number = *pool.free[--pool.count];
+		mpz_set_ui(n->number, 0);
+		return;
+	}
+	pool.misses++;
+	mpz_init(n->number);
+}
+
+void
+clear_number(struct number *n)
+{
+	if (pool.count < NUMBER_POOL_SIZE &&
+	    n->number->_mp_alloc <= NUMBER_POOL_LIMBS) {
+		*pool.free[pool.count++] = *n->number;
+		return;
+	}
+	mpz_clear(n->number);
+}
+
 struct number *
 new_number(void)
 {
 	struct number *n;
 
-	n = bmalloc(sizeof(*n));
-	n->scale = 0;
-	mpz_init(n->number);
+	n = shell_get();
+	init_number(n);
 	return n;
 }
 
 void
 free_number(struct number *n)
 {
-	mpz_clear(n->number);
-	free(n);
+	clear_number(n);
+	shell_put(n);
 }
 
 struct number *
@@ -45,12 +151,42 @@ dup_number(const struct number *a)
 {
 	struct number *n;
 
-	n = bmalloc(sizeof(*n));
+	n = new_number();
 	n->scale = a->scale;
-	mpz_init_set(n->number, a->number);
+	mpz_set(n->number, a->number);
 	return n;
 }
 
+/* Move an inline number into an allocated one */
+struct number *
+box_number(const struct number *a)
+{
+	struct number *n;
+
+	n = shell_get();
+	*n = *a;
+	return n;
+}
+
+/* Move an allocated number into inline storage, freeing the former */
+void
+unbox_number(struct number *r, struct number *n)
+{
+	*r = *n;
+	shell_put(n);
+}
+
+/* Free what this thread's pools keep, before it exits */
+void
+free_number_pool(void)
+{
+	number_pool_count();
+	while (pool.count > 0)
+		mpz_clear(pool.free[--pool.count]);
+	while (pool.nshells > 0)
+		free(pool.shells[--pool.nshells]);
+}
+
 void *
 bmalloc(size_t sz)
 {
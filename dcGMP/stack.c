@@ -22,12 +22,19 @@
 
 #include "extern.h"
 
+#define ARRAY_DENSE_MIN		64	/* smallest size of the dense part */
+#define ARRAY_SPARSE_MIN	16
+
 static __inline bool	stack_empty(const struct stack *);
 static void		stack_grow(struct stack *);
 static struct array	*array_new(void);
-static __inline void	array_free(struct array *);
-static struct array *	array_dup(const struct array *);
-static __inline void	array_grow(struct array *, size_t);
+static __inline struct array *array_ref(struct array *);
+static __inline void	array_unref(struct array *);
+static struct array *	array_dup(const struct array *, bool);
+static struct value	*value_copy(const struct value *, struct value *, bool);
+static void		array_grow(struct array *, size_t);
+static struct array_entry *array_slot(const struct array *, size_t);
+static void		array_sparse_grow(struct array *);
 static __inline void	array_assign(struct array *, size_t, const struct value *);
 static __inline struct value	*array_retrieve(const struct array *, size_t);
 
@@ -44,7 +51,7 @@ stack_empty(const struct stack *stack)
 {
 	bool empty = stack->sp == -1;
 	if (empty)
-		warnx("stack empty");
+		bwarnx("stack empty");
 	return empty;
 }
 
@@ -56,19 +63,30 @@ stack_free_value(struct value *v)
 	case BCODE_NONE:
 		break;
 	case BCODE_NUMBER:
-		free_number(v->u.num);
+		if (!v->in_word)
+			clear_number(&v->u.num);
 		break;
 	case BCODE_STRING:
-		free(v->u.string);
+		string_unref(v->u.string);
 		break;
 	}
-	array_free(v->array);
+	array_unref(v->array);
 	v->array = NULL;
 }
 
 /* Copy number or string content into already allocated target */
 struct value *
 stack_dup_value(const struct value *a, struct value *copy)
+{
+	return value_copy(a, copy, true);
+}
+
+/*
+ * With share false, the copy has strings and arrays of its own, so that
+ * it can be used by a machine on another thread.
+ */
+static struct value *
+value_copy(const struct value *a, struct value *copy, bool share)
 {
 	copy->type = a->type;
 
@@ -76,14 +94,28 @@ stack_dup_value(const struct value *a, struct value *copy)
 	case BCODE_NONE:
 		break;
 	case BCODE_NUMBER:
-		copy->u.num = dup_number(a->u.num);
+		copy->in_word = a->in_word;
+		if (a->in_word) {
+			copy->u.word = a->u.word;
+			break;
+		}
+		init_number(&copy->u.num);
+		copy->u.num.scale = a->u.num.scale;
+		mpz_set(copy->u.num.number, a->u.num.number);
 		break;
 	case BCODE_STRING:
-		copy->u.string = bstrdup(a->u.string);
+		if (share)
+			copy->u.string = string_ref(a->u.string);
+		else
+			copy->u.string = string_new(a->u.string->str,
+			    strlen(a->u.string->str));
 		break;
 	}
 
-	copy->array = a->array == NULL ? NULL : array_dup(a->array);
+	if (share)
+		copy->array = array_ref(a->array);
+	else
+		copy->array = array_dup(a->array, false);
 
 	return copy;
 }
@@ -102,7 +134,7 @@ stack_dup(struct stack *stack)
 
 	value = stack_tos(stack);
 	if (value == NULL) {
-		warnx("stack empty");
+		bwarnx("stack empty");
 		return;
 	}
 	stack_push(stack, stack_dup_value(value, &copy));
@@ -114,7 +146,7 @@ stack_swap(struct stack *stack)
 	struct value	copy;
 
 	if (stack->sp < 1) {
-		warnx("stack empty");
+		bwarnx("stack empty");
 		return;
 	}
 	copy = stack->stack[stack->sp];
@@ -140,12 +172,71 @@ stack_pushnumber(struct stack *stack, struct number *b)
 {
 	stack_grow(stack);
 	stack->stack[stack->sp].type = BCODE_NUMBER;
-	stack->stack[stack->sp].u.num = b;
+	stack->stack[stack->sp].in_word = false;
+	unbox_number(&stack->stack[stack->sp].u.num, b);
 	stack->stack[stack->sp].array = NULL;
 }
 
+/* Push a zero and return it, for the caller to set in place */
+struct number *
+stack_newnumber(struct stack *stack)
+{
+	struct value *v;
+
+	stack_grow(stack);
+	v = &stack->stack[stack->sp];
+	v->type = BCODE_NUMBER;
+	v->in_word = false;
+	init_number(&v->u.num);
+	v->array = NULL;
+	return &v->u.num;
+}
+
+void
+stack_pushword(struct stack *stack, long w)
+{
+	struct value *v;
+
+	stack_grow(stack);
+	v = &stack->stack[stack->sp];
+	v->type = BCODE_NUMBER;
+	v->in_word = true;
+	v->u.word = w;
+	v->array = NULL;
+}
+
+/* Hold a number in a word, if it has scale 0 and fits one */
+void
+value_word(struct value *v)
+{
+	long w;
+
+	if (v->type != BCODE_NUMBER || v->in_word || v->u.num.scale != 0 ||
+	    !mpz_fits_slong_p(v->u.num.number))
+		return;
+	w = mpz_get_si(v->u.num.number);
+	clear_number(&v->u.num);
+	v->u.word = w;
+	v->in_word = true;
+}
+
+/* Give a number held in a word its mpz_t */
+void
+value_unword(struct value *v)
+{
+	long w;
+
+	if (v->type != BCODE_NUMBER || !v->in_word)
+		return;
+	w = v->u.word;
+	init_number(&v->u.num);
+	mpz_set_si(v->u.num.number, w);
+	v->in_word = false;
+}
+
+/* Takes the reference to string */
 void
-stack_pushstring(struct stack *stack, char *string)
+stack_pushstring(struct stack *stack, struct string *string)
 {
 	stack_grow(stack);
 	stack->stack[stack->sp].type = BCODE_STRING;
@@ -153,23 +244,12 @@ stack_pushstring(struct stack *stack, char *string)
 	stack->stack[stack->sp].array = NULL;
 }
 
+/* Moves v, with what it refers to, onto the stack */
 void
 stack_push(struct stack *stack, struct value *v)
 {
-	switch (v->type) {
-	case BCODE_NONE:
-		stack_grow(stack);
-		stack->stack[stack->sp].type = BCODE_NONE;
-		break;
-	case BCODE_NUMBER:
-		stack_pushnumber(stack, v->u.num);
-		break;
-	case BCODE_STRING:
-		stack_pushstring(stack, v->u.string);
-		break;
-	}
-	stack->stack[stack->sp].array = v->array == NULL ?
-	    NULL : array_dup(v->array);
+	stack_grow(stack);
+	stack->stack[stack->sp] = *v;
 }
 
 struct value *
@@ -188,8 +268,6 @@ stack_set_tos(struct stack *stack, struct value *v)
 	else {
 		stack_free_value(&stack->stack[stack->sp]);
 		stack->stack[stack->sp] = *v;
-		stack->stack[stack->sp].array = v->array == NULL ?
-		    NULL : array_dup(v->array);
 	}
 }
 
@@ -206,24 +284,92 @@ stack_popnumber(struct stack *stack)
 {
 	if (stack_empty(stack))
 		return NULL;
-	array_free(stack->stack[stack->sp].array);
+	array_unref(stack->stack[stack->sp].array);
 	stack->stack[stack->sp].array = NULL;
 	if (stack->stack[stack->sp].type != BCODE_NUMBER) {
-		warnx("not a number"); /* XXX remove */
+		bwarnx("not a number"); /* XXX remove */
 		return NULL;
 	}
-	return stack->stack[stack->sp--].u.num;
+	value_unword(&stack->stack[stack->sp]);
+	return box_number(&stack->stack[stack->sp--].u.num);
+}
+
+/*
+ * Find the operands of a binary operator: a is TOS, b the number below
+ * it.  The operator leaves its result in b and then drops a with
+ * stack_dropnumber(), so no number is moved or allocated.  Fails, with
+ * the same warnings as popping both, if either is not a number.
+ */
+bool
+stack_binop(struct stack *stack, struct number **a, struct number **b)
+{
+	struct value *v;
+
+	if (stack_empty(stack))
+		return false;
+	v = &stack->stack[stack->sp];
+	array_unref(v->array);
+	v->array = NULL;
+	if (v->type != BCODE_NUMBER) {
+		bwarnx("not a number"); /* XXX remove */
+		return false;
+	}
+	if (stack->sp == 0) {
+		bwarnx("stack empty");
+		return false;
+	}
+	array_unref(v[-1].array);
+	v[-1].array = NULL;
+	if (v[-1].type != BCODE_NUMBER) {
+		bwarnx("not a number"); /* XXX remove */
+		return false;
+	}
+	value_unword(v);
+	value_unword(&v[-1]);
+	*a = &v->u.num;
+	*b = &v[-1].u.num;
+	return true;
+}
+
+/*
+ * Like stack_binop(), but only succeeds, without a warning, if both are
+ * numbers held in words and without arrays.
+ */
+bool
+stack_words(struct stack *stack, long **a, long **b)
+{
+	struct value *v;
+
+	if (stack->sp < 1)
+		return false;
+	v = &stack->stack[stack->sp];
+	if (v->type != BCODE_NUMBER || !v->in_word || v->array != NULL ||
+	    v[-1].type != BCODE_NUMBER || !v[-1].in_word ||
+	    v[-1].array != NULL)
+		return false;
+	*a = &v->u.word;
+	*b = &v[-1].u.word;
+	return true;
+}
+
+void
+stack_dropnumber(struct stack *stack)
+{
+	struct value *v = &stack->stack[stack->sp--];
+
+	if (!v->in_word)
+		clear_number(&v->u.num);
 }
 
-char *
+struct string *
 stack_popstring(struct stack *stack)
 {
 	if (stack_empty(stack))
 		return NULL;
-	array_free(stack->stack[stack->sp].array);
+	array_unref(stack->stack[stack->sp].array);
 	stack->stack[stack->sp].array = NULL;
 	if (stack->stack[stack->sp].type != BCODE_STRING) {
-		warnx("not a string"); /* XXX remove */
+		bwarnx("not a string"); /* XXX remove */
 		return NULL;
 	}
 	return stack->stack[stack->sp--].u.string;
@@ -238,6 +384,40 @@ stack_clear(struct stack *stack)
 	stack_init(stack);
 }
 
+/* Like stack_clear(), but keep the storage for reuse */
+void
+stack_reset(struct stack *stack)
+{
+	while (stack->sp >= 0)
+		stack_free_value(&stack->stack[stack->sp--]);
+}
+
+/* Make to a copy of from, reusing the storage of to */
+void
+stack_copy(struct stack *to, const struct stack *from)
+{
+	ssize_t i;
+
+	stack_reset(to);
+	for (i = 0; i <= from->sp; i++) {
+		stack_grow(to);
+		(void)stack_dup_value(&from->stack[i], &to->stack[to->sp]);
+	}
+}
+
+/* Like stack_copy(), for a machine on another thread than from's */
+void
+stack_copy_unshared(struct stack *to, const struct stack *from)
+{
+	ssize_t i;
+
+	stack_reset(to);
+	for (i = 0; i <= from->sp; i++) {
+		stack_grow(to);
+		(void)value_copy(&from->stack[i], &to->stack[to->sp], false);
+	}
+}
+
 void
 stack_print(FILE *f, const struct stack *stack, const char *prefix, u_int base)
 {
@@ -256,26 +436,42 @@ array_new(void)
 	struct array *a;
 
 	a = bmalloc(sizeof(*a));
+	a->refcnt = 1;
 	a->data = NULL;
 	a->size = 0;
+	a->sparse = NULL;
+	a->sparse_sz = 0;
+	a->sparse_cnt = 0;
+	return a;
+}
+
+static __inline struct array *
+array_ref(struct array *a)
+{
+	if (a != NULL)
+		a->refcnt++;
 	return a;
 }
 
 static __inline void
-array_free(struct array *a)
+array_unref(struct array *a)
 {
 	size_t i;
 
-	if (a == NULL)
+	if (a == NULL || --a->refcnt > 0)
 		return;
 	for (i = 0; i < a->size; i++)
 		stack_free_value(&a->data[i]);
+	for (i = 0; i < a->sparse_sz; i++)
+		if (a->sparse[i].key != 0)
+			stack_free_value(&a->sparse[i].value);
 	free(a->data);
+	free(a->sparse);
 	free(a);
 }
 
 static struct array *
-array_dup(const struct array *a)
+array_dup(const struct array *a, bool share)
 {
 	struct array	*n;
 	size_t		i;
@@ -285,14 +481,66 @@ array_dup(const struct array *a)
 	n = array_new();
 	array_grow(n, a->size);
 	for (i = 0; i < a->size; i++)
-		(void)stack_dup_value(&a->data[i], &n->data[i]);
+		(void)value_copy(&a->data[i], &n->data[i], share);
+	if (a->sparse_cnt > 0) {
+		/* Same size, so every entry hashes to the same slot */
+		n->sparse = breallocarray(NULL, a->sparse_sz,
+		    sizeof(*n->sparse));
+		n->sparse_sz = a->sparse_sz;
+		n->sparse_cnt = a->sparse_cnt;
+		for (i = 0; i < a->sparse_sz; i++) {
+			n->sparse[i].key = a->sparse[i].key;
+			if (a->sparse[i].key != 0)
+				(void)value_copy(&a->sparse[i].value,
+				    &n->sparse[i].value, share);
+		}
+	}
 	return n;
 }
 
-static __inline void
+/* The slot of index in the hashed part, or the free slot it would take */
+static struct array_entry *
+array_slot(const struct array *array, size_t index)
+{
+	unsigned long long	h = index;
+	size_t			mask = array->sparse_sz - 1;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	for (h &= mask; array->sparse[h].key != 0; h = (h + 1) & mask)
+		if (array->sparse[h].key == index + 1)
+			break;
+	return &array->sparse[h];
+}
+
+/* Rehash the hashed part, into twice the slots if it is half full */
+static void
+array_sparse_grow(struct array *array)
+{
+	struct array_entry	*old = array->sparse;
+	size_t			i, oldsz = array->sparse_sz;
+
+	if (array->sparse_sz == 0)
+		array->sparse_sz = ARRAY_SPARSE_MIN;
+	else if (2 * array->sparse_cnt >= array->sparse_sz)
+		array->sparse_sz *= 2;
+	array->sparse = breallocarray(NULL, array->sparse_sz,
+	    sizeof(*array->sparse));
+	for (i = 0; i < array->sparse_sz; i++)
+		array->sparse[i].key = 0;
+	for (i = 0; i < oldsz; i++)
+		if (old[i].key != 0)
+			*array_slot(array, old[i].key - 1) = old[i];
+	free(old);
+}
+
+/* Make the dense part newsize long, moving in the hashed elements below */
+static void
 array_grow(struct array *array, size_t newsize)
 {
-	size_t i;
+	struct array_entry	*e;
+	size_t			i, moved;
 
 	array->data = breallocarray(array->data, newsize, sizeof(*array->data));
 	for (i = array->size; i < newsize; i++) {
@@ -300,23 +548,63 @@ array_grow(struct array *array, size_t newsize)
 		array->data[i].array = NULL;
 	}
 	array->size = newsize;
+
+	moved = 0;
+	for (i = 0; i < array->sparse_sz; i++) {
+		e = &array->sparse[i];
+		if (e->key != 0 && e->key <= newsize) {
+			array->data[e->key - 1] = e->value;
+			e->key = 0;
+			moved++;
+		}
+	}
+	if (moved > 0) {
+		array->sparse_cnt -= moved;
+		array_sparse_grow(array);
+	}
 }
 
 static __inline void
 array_assign(struct array *array, size_t index, const struct value *v)
 {
-	if (index >= array->size)
-		array_grow(array, index+1);
-	stack_free_value(&array->data[index]);
-	array->data[index] = *v;
+	struct array_entry	*e;
+	size_t			newsize;
+
+	if (index >= array->size) {
+		newsize = array->size < ARRAY_DENSE_MIN / 2 ?
+		    ARRAY_DENSE_MIN : 2 * array->size;
+		if (index < newsize)
+			array_grow(array, newsize);
+	}
+	if (index < array->size) {
+		stack_free_value(&array->data[index]);
+		array->data[index] = *v;
+		return;
+	}
+
+	if (2 * (array->sparse_cnt + 1) > array->sparse_sz)
+		array_sparse_grow(array);
+	e = array_slot(array, index);
+	if (e->key != 0)
+		stack_free_value(&e->value);
+	else {
+		e->key = index + 1;
+		array->sparse_cnt++;
+	}
+	e->value = *v;
 }
 
 static __inline struct value *
 array_retrieve(const struct array *array, size_t index)
 {
-	if (index >= array->size)
+	struct array_entry *e;
+
+	if (index < array->size)
+		return &array->data[index];
+	if (array->sparse_cnt == 0)
 		return NULL;
-	return &array->data[index];
+	e = array_slot(array, index);
+	return e->key != 0 ? &e->value : NULL;
 }
 
 void
@@ -334,6 +622,11 @@ frame_assign(struct stack *stack, size_t index, const struct value *v)
 	a = stack->stack[stack->sp].array;
 	if (a == NULL)
 		a = stack->stack[stack->sp].array = array_new();
+	else if (a->refcnt > 1) {
+		/* Copy on write */
+		a->refcnt--;
+		a = stack->stack[stack->sp].array = array_dup(a, true);
+	}
 	array_assign(a, index, v);
 }
 
@@ -349,3 +642,34 @@ frame_retrieve(const struct stack *stack, size_t index)
 		a = stack->stack[stack->sp].array = array_new();
 	return array_retrieve(a, index);
 }
+
+/* A string holding a copy of the len bytes at p */
+struct string *
+string_new(const char *p, size_t len)
+{
+	struct string *s;
+
+	s = bmalloc(sizeof(*s) + len + 1);
+	s->refcnt = 1;
+	s->prog = NULL;
+	memcpy(s->str, p, len);
+	s->str[len] = '\0';
+	return s;
+}
+
+struct string *
+string_ref(struct string *s)
+{
+	s->refcnt++;
+	return s;
+}
+
+void
+string_unref(struct string *s)
+{
+	if (--s->refcnt > 0)
+		return;
+	if (s->prog != NULL)
+		program_unref(s->prog);
+	free(s);
+}
@@ -0,0 +1,19 @@
+#!/bin/sh
+
+# Check that a batch job that fails, here on a J with no M to go to,
+# gets an error line and leaves the jobs after it to run as usual.
+# Other dcs may be given as arguments.
+[ $# -gt 0 ] || set -- ./dcOpenBSD.exe ./dcOpenBSD_GMP.exe
+status=0
+for dc in "$@"; do
+	for opts in "-b" "-b -j 4"; do
+		if $dc $opts Batch.dc 2>&1 | sed 's/^error [^:]*:/error:/' |
+		    cmp -s - Batch.out; then
+			echo "ok: $dc $opts"
+		else
+			echo "FAILED: $dc $opts"
+			status=1
+		fi
+	done
+done
+exit $status
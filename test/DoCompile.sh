@@ -0,0 +1,18 @@
+#!/bin/sh
+
+# Check that macros, which the GMP dc runs compiled, do what their text
+# says: here a blank keeps a following e from being read as an else.
+# The diagnostics are written first, then a --, then the output.
+# Other dcs may be given as arguments.
+[ $# -gt 0 ] || set -- ./dcOpenBSD.exe ./dcOpenBSD_GMP.exe
+status=0
+for dc in "$@"; do
+	if { $dc Compile.dc 2>&1 >/dev/null; echo --;
+	    $dc Compile.dc 2>/dev/null; } | cmp -s - Compile.out; then
+		echo "ok: $dc"
+	else
+		echo "FAILED: $dc"
+		status=1
+	fi
+done
+exit $status
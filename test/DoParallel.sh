@@ -0,0 +1,18 @@
+#!/bin/sh
+
+# Check that the parallel for of the OpenBSD bcs leaves the variables
+# written in its body alone, the same way whatever runs the chunks.
+# Other bcs may be given as arguments.
+[ $# -gt 0 ] || set -- ./bcOpenBSD.exe ./bcOpenBSD_GMP.exe
+status=0
+for bc in "$@"; do
+	for opts in "-j 1" "-j 4" "-p -j 1" "-p -j 4"; do
+		if $bc $opts Parallel.b < /dev/null | cmp -s - Parallel.out; then
+			echo "ok: $bc $opts"
+		else
+			echo "FAILED: $bc $opts"
+			status=1
+		fi
+	done
+done
+exit $status
@@ -1,19 +1,11 @@
-#!/bin/bash -x
+#!/bin/sh
 
-./RunRace.sh ./bcGNU.exe StartRace1.b
-./RunRace.sh ./bcGNU_GMP.exe StartRace1.b
-./RunRaceF.sh ./bcFreeBSD.exe StartRace1.b
-./RunRace.sh ./bcOpenBSD.exe StartRace1.b
-./RunRace.sh ./bcOpenBSD_GMP.exe StartRace1.b
-
-./RunRace.sh ./bcGNU.exe StartRace2.b
-./RunRace.sh ./bcGNU_GMP.exe StartRace2.b
-./RunRaceF.sh ./bcFreeBSD.exe StartRace2.b
-./RunRace.sh ./bcOpenBSD.exe StartRace2.b
-./RunRace.sh ./bcOpenBSD_GMP.exe StartRace2.b
-
-./RunRace.sh ./bcGNU.exe StartRace3.b
-./RunRace.sh ./bcGNU_GMP.exe StartRace3.b
-./RunRaceF.sh ./bcFreeBSD.exe StartRace3.b
-./RunRace.sh ./bcOpenBSD.exe StartRace3.b
-./RunRace.sh ./bcOpenBSD_GMP.exe StartRace3.b
+# Build the harness with: cc -O2 -o bench bench.c -lm
+# Extra arguments are passed on, e.g. -j for JSON or -k rand850.
+exec ./bench \
+    -b 'GNU::./bcGNU.exe' \
+    -b 'GNU_GMP::./bcGNU_GMP.exe' \
+    -b 'FreeBSD::./bcFreeBSD.exe -f' \
+    -b 'OpenBSD:./dcOpenBSD.exe:./bcOpenBSD.exe' \
+    -b 'OpenBSD_GMP:./dcOpenBSD_GMP.exe:./bcOpenBSD_GMP.exe' \
+    "$@"
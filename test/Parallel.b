@@ -0,0 +1,51 @@
+/*
+ * Writes in the body of a parallel for are not seen after it, and bc
+ * warns of them.  The index is left as a for loop leaves it.
+ */
+x = 7
+i = 3
+a[5] = 1
+s = 0
+parallel (+ s) for (i = 0; i < 100; i++) {
+	s += x
+	x = x + 1
+	a[i] = i
+	y = i
+}
+s
+x
+i
+a[5]
+y
+
+/* Nor in nested loops, which run on the calling machine */
+s = 0
+parallel (+ s) for (i = 0; i < 10; i++) {
+	t = 0
+	parallel (+ t) for (j = 0; j < 10; j++) {
+		t += x
+		x = x + 1
+	}
+	s += t
+	x = x + 1
+}
+s
+x
+j
+t
+
+/* A function keeps its own autos */
+define f(n) {
+	auto k, r
+	r = 0
+	parallel (max r) for (k = 0; k < n; k++) {
+		r = k * k
+		x = -1
+	}
+	return (r)
+}
+m = 0
+parallel (max m) for (i = 1; i <= 20; i++) m = f(i)
+m
+x
+quit
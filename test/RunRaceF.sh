@@ -1,16 +0,0 @@
-#!/bin/bash -x
-
-# Warm up
-$1 -f $2 > /dev/null
-
-# Time trial, ten laps.
-time $1 -f $2
-time $1 -f $2
-time $1 -f $2
-time $1 -f $2
-time $1 -f $2
-time $1 -f $2
-time $1 -f $2
-time $1 -f $2
-time $1 -f $2
-time $1 -f $2
@@ -0,0 +1,425 @@
+/*
+ * Benchmark harness for the dc and bc implementations.
+ *
+ * Every backend is given as name:dc:bc, where either program may be
+ * left empty and bc may carry options to put before the file name,
+ * e.g. "FreeBSD::./bcFreeBSD.exe -f".  Microbenchmarks are generated
+ * dc programs, one per operation and operand size, and are run on the
+ * backends that have a dc.  The rand850 races, StartRace[123].b, are
+ * run on the backends that have a bc.  The startup cases run an empty
+ * program, to time what each program does before reading its input.
+ *
+ * Each case is run once first to warm up and to check that all
+ * backends print the same, then timed for a number of laps.  Median,
+ * minimum and standard deviation of the wall and CPU (user + system)
+ * times are reported, along with the ratio of the median wall time to
+ * that of the first backend.
+ *
+ * Build with: cc -O2 -o bench bench.c -lm
+ */
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include <err.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_BACKENDS	16
+#define MAX_ARGS	16
+#define NSIZES		4
+
+struct backend {
+	char	*name;
+	char	*dc;
+	char	*bc[MAX_ARGS];
+	int	nbc;
+};
+
+struct stats {
+	double	median;
+	double	min;
+	double	stddev;
+};
+
+struct result {
+	struct stats	wall;
+	struct stats	cpu;
+	uint64_t	hash;
+	bool		ok;
+};
+
+/*
+ * The operand sizes in decimal digits and, per operation, the number
+ * of iterations at each size.  A loop body finds its operands in
+ * registers a and b (2n and n digits) and c (n / 10 digits), and
+ * leaves its result in t.
+ */
+static const int sizes[NSIZES] = { 10, 100, 1000, 10000 };
+
+static const struct micro {
+	const char	*name;
+	const char	*body;
+	long		iters[NSIZES];
+} micros[] = {
+	{ "add",	"la lb+st",	{ 200000, 200000, 100000, 20000 } },
+	{ "mul",	"lb lb*st",	{ 200000, 100000, 20000, 1000 } },
+	{ "div",	"la lb/st",	{ 200000, 100000, 10000, 500 } },
+	{ "sqrt",	"la vst",	{ 50000, 10000, 500, 10 } },
+	{ "exp",	"lc 10^st",	{ 100000, 50000, 10000, 500 } },
+	{ "print",	"lb n",		{ 100000, 20000, 2000, 100 } },
+	{ "parse",	NULL,		{ 100000, 20000, 2000, 200 } },
+};
+
+static struct backend	backends[MAX_BACKENDS];
+static int		nbackends;
+static int		laps = 10;
+static double		factor = 1.0;
+static bool		json;
+static const char	*only;
+static const char	*racedir = ".";
+static bool		first_result = true;
+static uint32_t		seed = 850;
+
+static void
+usage(void)
+{
+	(void)fprintf(stderr, "usage: bench [-j] [-k case] [-n laps] "
+	    "[-r racedir] [-s factor]\n"
+	    "             -b name:dc:bc ...\n");
+	exit(1);
+}
+
+static void
+add_backend(char *spec)
+{
+	struct backend	*b;
+	char		*p;
+
+	if (nbackends == MAX_BACKENDS)
+		errx(1, "too many backends");
+	b = &backends[nbackends++];
+	b->name = strsep(&spec, ":");
+	if (spec == NULL)
+		errx(1, "backend %s: expected name:dc:bc", b->name);
+	b->dc = strsep(&spec, ":");
+	if (*b->dc == '\0')
+		b->dc = NULL;
+	b->nbc = 0;
+	while (spec != NULL && (p = strsep(&spec, " ")) != NULL) {
+		if (*p == '\0')
+			continue;
+		if (b->nbc == MAX_ARGS - 2)
+			errx(1, "backend %s: too many arguments", b->name);
+		b->bc[b->nbc++] = p;
+	}
+}
+
+static void
+put_digits(FILE *f, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		seed = seed * 1103515245 + 12345;
+		(void)putc('0' + (i == 0 ? 1 + (seed >> 16) % 9 :
+		    (seed >> 16) % 10), f);
+	}
+}
+
+/* Write the program for a microbenchmark to a temporary file */
+static char *
+make_micro(const struct micro *m, int size, long iters)
+{
+	static char	path[] = "/tmp/bench.XXXXXXXXXX";
+	FILE		*f;
+	long		i;
+	int		fd;
+
+	(void)strcpy(path + sizeof(path) - 11, "XXXXXXXXXX");
+	if ((fd = mkstemp(path)) == -1 || (f = fdopen(fd, "w")) == NULL)
+		err(1, "%s", path);
+	if (m->body == NULL) {
+		for (i = 0; i < iters; i++) {
+			put_digits(f, size);
+			(void)fputs("st\n", f);
+		}
+	} else {
+		put_digits(f, 2 * size);
+		(void)fputs("sa ", f);
+		put_digits(f, size);
+		(void)fputs("sb ", f);
+		put_digits(f, size / 10 > 0 ? size / 10 : 1);
+		(void)fprintf(f, "sc\n[%s li1-dsi0<L]sL %ldsi lLx\n",
+		    m->body, iters);
+	}
+	(void)fputs("ltp\n", f);
+	if (fclose(f) == EOF)
+		err(1, "%s", path);
+	return path;
+}
+
+static double
+seconds(const struct timeval *tv)
+{
+	return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+/*
+ * Run argv with stdin from /dev/null.  If hash is not NULL, the output
+ * is read and hashed, otherwise it is discarded.
+ */
+static bool
+run(char *const argv[], double *wall, double *cpu, uint64_t *hash)
+{
+	struct timespec	t0, t1;
+	struct rusage	ru;
+	unsigned char	buf[8192];
+	ssize_t		n, i;
+	pid_t		pid;
+	int		fd[2], null, status;
+
+	if ((null = open("/dev/null", O_RDWR)) == -1)
+		err(1, "/dev/null");
+	if (hash != NULL && pipe(fd) == -1)
+		err(1, "pipe");
+	(void)clock_gettime(CLOCK_MONOTONIC, &t0);
+	switch (pid = fork()) {
+	case -1:
+		err(1, "fork");
+	case 0:
+		(void)dup2(null, STDIN_FILENO);
+		if (hash != NULL) {
+			(void)dup2(fd[1], STDOUT_FILENO);
+			(void)dup2(fd[1], STDERR_FILENO);
+			(void)close(fd[0]);
+			(void)close(fd[1]);
+		} else {
+			(void)dup2(null, STDOUT_FILENO);
+			(void)dup2(null, STDERR_FILENO);
+		}
+		(void)close(null);
+		execvp(argv[0], argv);
+		_exit(127);
+	}
+	(void)close(null);
+	if (hash != NULL) {
+		(void)close(fd[1]);
+		*hash = 14695981039346656037ULL;
+		while ((n = read(fd[0], buf, sizeof(buf))) > 0)
+			for (i = 0; i < n; i++)
+				*hash = (*hash ^ buf[i]) * 1099511628211ULL;
+		(void)close(fd[0]);
+	}
+	if (wait4(pid, &status, 0, &ru) == -1)
+		err(1, "wait4");
+	(void)clock_gettime(CLOCK_MONOTONIC, &t1);
+	*wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	*cpu = seconds(&ru.ru_utime) + seconds(&ru.ru_stime);
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void
+get_stats(double *v, int n, struct stats *s)
+{
+	double	mean, sum;
+	int	i;
+
+	qsort(v, n, sizeof(*v), cmp_double);
+	s->min = v[0];
+	s->median = n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+	for (mean = 0, i = 0; i < n; i++)
+		mean += v[i];
+	mean /= n;
+	for (sum = 0, i = 0; i < n; i++)
+		sum += (v[i] - mean) * (v[i] - mean);
+	s->stddev = n > 1 ? sqrt(sum / (n - 1)) : 0;
+}
+
+static bool
+measure(char *const argv[], struct result *r)
+{
+	double	*wall, *cpu, w, c;
+	int	i;
+
+	r->ok = run(argv, &w, &c, &r->hash);
+	if (!r->ok)
+		return false;
+	if ((wall = calloc(laps, sizeof(*wall))) == NULL ||
+	    (cpu = calloc(laps, sizeof(*cpu))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < laps && r->ok; i++)
+		r->ok = run(argv, &wall[i], &cpu[i], NULL);
+	if (r->ok) {
+		get_stats(wall, laps, &r->wall);
+		get_stats(cpu, laps, &r->cpu);
+	}
+	free(wall);
+	free(cpu);
+	return r->ok;
+}
+
+static void
+report(const char *name, const struct backend *b, const struct result *r,
+    const struct result *first)
+{
+	double	ratio;
+	bool	same;
+
+	ratio = first != NULL ? r->wall.median / first->wall.median : 1;
+	same = first == NULL || r->hash == first->hash;
+	if (json) {
+		(void)printf("%s\n    { \"case\": \"%s\", \"backend\": \"%s\", ",
+		    first_result ? "" : ",", name, b->name);
+		first_result = false;
+		if (!r->ok) {
+			(void)printf("\"failed\": true }");
+			return;
+		}
+		(void)printf("\"wall\": { \"median\": %.6f, \"min\": %.6f, "
+		    "\"stddev\": %.6f }, ",
+		    r->wall.median, r->wall.min, r->wall.stddev);
+		(void)printf("\"cpu\": { \"median\": %.6f, \"min\": %.6f, "
+		    "\"stddev\": %.6f }, ",
+		    r->cpu.median, r->cpu.min, r->cpu.stddev);
+		(void)printf("\"ratio\": %.3f, \"same_output\": %s }",
+		    ratio, same ? "true" : "false");
+		return;
+	}
+	(void)printf("%-12s %-14s", name, b->name);
+	if (!r->ok) {
+		(void)printf(" failed\n");
+		return;
+	}
+	(void)printf(" %9.4f %9.4f %8.4f %9.4f %9.4f %8.4f %6.2f%s\n",
+	    r->wall.median, r->wall.min, r->wall.stddev,
+	    r->cpu.median, r->cpu.min, r->cpu.stddev, ratio,
+	    same ? "" : "  output differs");
+	(void)fflush(stdout);
+}
+
+/* Run one case on every backend that has the program it needs */
+static void
+run_case(const char *name, const char *file, bool use_bc)
+{
+	const struct backend	*b;
+	struct result		r, first;
+	char			*argv[MAX_ARGS];
+	bool			have_first = false;
+	int			i, n;
+
+	if (only != NULL && strstr(name, only) == NULL)
+		return;
+	for (i = 0; i < nbackends; i++) {
+		b = &backends[i];
+		n = 0;
+		if (use_bc) {
+			if (b->nbc == 0)
+				continue;
+			for (; n < b->nbc; n++)
+				argv[n] = b->bc[n];
+		} else {
+			if (b->dc == NULL)
+				continue;
+			argv[n++] = b->dc;
+		}
+		argv[n++] = (char *)file;
+		argv[n] = NULL;
+		(void)measure(argv, &r);
+		report(name, b, &r, have_first ? &first : NULL);
+		if (!have_first && r.ok) {
+			first = r;
+			have_first = true;
+		}
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	const struct micro	*m;
+	char			name[64], path[1024], *file;
+	long			iters;
+	int			ch, i;
+
+	while ((ch = getopt(argc, argv, "b:jk:n:r:s:")) != -1) {
+		switch (ch) {
+		case 'b':
+			add_backend(optarg);
+			break;
+		case 'j':
+			json = true;
+			break;
+		case 'k':
+			only = optarg;
+			break;
+		case 'n':
+			laps = atoi(optarg);
+			if (laps < 1)
+				errx(1, "laps must be positive");
+			break;
+		case 'r':
+			racedir = optarg;
+			break;
+		case 's':
+			factor = atof(optarg);
+			if (factor <= 0)
+				errx(1, "factor must be positive");
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || nbackends == 0)
+		usage();
+
+	if (json)
+		(void)printf("{ \"laps\": %d, \"results\": [", laps);
+	else
+		(void)printf("%-12s %-14s %9s %9s %8s %9s %9s %8s %6s\n",
+		    "case", "backend", "wall med", "wall min", "wall sd",
+		    "cpu med", "cpu min", "cpu sd", "ratio");
+
+	for (m = micros; m < micros + sizeof(micros) / sizeof(micros[0]);
+	    m++) {
+		for (i = 0; i < NSIZES; i++) {
+			(void)snprintf(name, sizeof(name), "%s/%d",
+			    m->name, sizes[i]);
+			if (only != NULL && strstr(name, only) == NULL)
+				continue;
+			iters = m->iters[i] * factor;
+			file = make_micro(m, sizes[i], iters > 0 ? iters : 1);
+			run_case(name, file, false);
+			(void)unlink(file);
+		}
+	}
+	run_case("startup/dc", "/dev/null", false);
+	run_case("startup/bc", "/dev/null", true);
+	for (i = 1; i <= 3; i++) {
+		(void)snprintf(name, sizeof(name), "rand850/%d", i);
+		(void)snprintf(path, sizeof(path), "%s/StartRace%d.b",
+		    racedir, i);
+		run_case(name, path, true);
+	}
+
+	if (json)
+		(void)printf("\n] }\n");
+	return 0;
+}